@@ -0,0 +1,74 @@
+/*
+ *  This example demonstrates continuous passive scanning. Every
+ *  Aranet advertisement is decoded as soon as it is received,
+ *  scan never stops and no scan results are stored.
+ *
+ *  Name:       ContinuousScan.ino
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "Aranet4.h"
+#include "AranetScanner.h"
+
+#define QUEUE_SIZE 16
+
+typedef struct {
+    uint8_t addr[6];
+    AranetData data;
+} ScanItem;
+
+QueueHandle_t scanQueue;
+
+// Runs in NimBLE host task: only hand data over to loop()
+class ScanCallbacks : public AranetScannerCallbacks {
+    void onAranetData(NimBLEAdvertisedDevice* adv, AranetManufacturerData* mfdata) {
+        if (!mfdata->flags.bits.integrations) return;
+
+        ScanItem item;
+        memcpy(item.addr, adv->getAddress().getNative(), 6);
+        item.data = mfdata->data;
+        xQueueSend(scanQueue, &item, 0);
+    }
+};
+
+ScanCallbacks callbacks;
+AranetScanner scanner(&callbacks);
+
+void setup() {
+    Serial.begin(115200);
+    Serial.println("Init");
+
+    scanQueue = xQueueCreate(QUEUE_SIZE, sizeof(ScanItem));
+
+    Aranet4::init();
+    scanner.begin();
+}
+
+void loop() {
+    ScanItem item;
+    if (xQueueReceive(scanQueue, &item, portMAX_DELAY) != pdTRUE) return;
+
+    AranetData& data = item.data;
+    Serial.printf("%02x:%02x:%02x:%02x:%02x:%02x  ",
+        item.addr[5], item.addr[4], item.addr[3], item.addr[2], item.addr[1], item.addr[0]);
+
+    switch (data.type) {
+    case ARANET4:
+        Serial.printf("CO2 %i ppm, T %.2f C, RH %i %%\n", data.co2, data.temperature / 20.0, data.humidity);
+        break;
+    case ARANET2:
+        Serial.printf("T %.2f C, RH %.1f %%\n", data.temperature / 20.0, data.humidity / 10.0);
+        break;
+    case ARANET_RADIATION:
+        Serial.printf("Rate %.2f uSv/h\n", data.radiation_rate / 1000.0);
+        break;
+    case ARANET_RADON:
+        Serial.printf("Radon %i Bq/m3\n", data.radon_concentration);
+        break;
+    default:
+        Serial.println("unknown type");
+        break;
+    }
+}
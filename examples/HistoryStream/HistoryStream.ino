@@ -0,0 +1,98 @@
+/*
+ *  This example demonstrates how to download complete measurement
+ *  history without storing it. Records are printed as soon as all
+ *  parameters of them are received.
+ *
+ *  Name:       HistoryStream.ino
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "Aranet4.h"
+
+// Address can be string or byte array
+String addr = "00:01:02:03:04:05"; // Put your Aranet MAC address here
+
+// Create custom callback to allow PIN code input.
+// In this example, when PIN is requested, you must enter it in serial console.
+class MyAranet4Callbacks: public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        Serial.println("PIN Requested. Enter PIN in serial console.");
+        while(Serial.available() == 0)
+            vTaskDelay(500 / portTICK_PERIOD_MS);
+        return  Serial.readString().toInt();
+    }
+};
+
+// Receives records, oldest first
+class MyHistoryCallbacks: public AranetHistoryCallbacks {
+public:
+    AranetType type = UNKNOWN;
+
+    bool onHistoryRecords(uint16_t start, AranetDataCompact* records, uint16_t count) {
+        for (int i = 0; i < count; i++) {
+            AranetDataCompact& rec = records[i];
+            if (type == ARANET4) {
+                Serial.printf("#%i: \t%i ppm \t%.1f C \t%.1f hPa \t%i %%\n", start + i,
+                    rec.aranet4.co2,
+                    rec.aranet4.temperature / 20.0,
+                    rec.aranet4.pressure / 10.0,
+                    rec.aranet4.humidity);
+            } else if (type == ARANET2) {
+                Serial.printf("#%i: \t%.1f C \t%.1f %%\n", start + i,
+                    rec.aranet4.temperature / 20.0,
+                    rec.aranet4.humidity / 10.0);
+            } else if (type == ARANET_RADIATION) {
+                Serial.printf("#%i: \t%.2f uSv/h\t%.4f mSv\n", start + i,
+                    rec.aranetr.rad_dose_rate / 100.0,
+                    rec.aranetr.rad_dose_integral / 1000000.0);
+            } else if (type == ARANET_RADON) {
+                Serial.printf("#%i: \t%i Bq/m3 \t%.1f C \t%.1f %%\n", start + i,
+                    rec.aranetrn.radon_concentration,
+                    rec.aranetrn.temperature / 20.0,
+                    rec.aranetrn.humidity / 10.0);
+            }
+        }
+        return true; // return false to stop download
+    }
+};
+
+Aranet4 ar4(new MyAranet4Callbacks());
+MyHistoryCallbacks history;
+
+void setup() {
+    Serial.begin(115200);
+    Serial.println("Init");
+
+    // Set up bluettoth security and callbacks
+    Aranet4::init();
+
+    Serial.println("Connecting...");
+    if (ar4.connect(addr) == AR4_OK) {
+        history.type = ar4.getType();
+        uint16_t count = ar4.getTotalReadings();
+        uint16_t params = AR4_PARAM_FLAGS;
+
+        if (history.type == ARANET2) {
+            params = AR2_PARAM_FLAGS;
+        } else if (history.type == ARANET_RADIATION) {
+            params = ARR_PARAM_FLAGS;
+        } else if (history.type == ARANET_RADON) {
+            params = ARRN_PARAM_FLAGS;
+        }
+
+        Serial.printf("Total logs: %i\n", count);
+
+        // Whole log, oldest record has index 1
+        int recvd = ar4.getHistoryRecords(1, count, &history, params);
+        Serial.printf("Received %i records\n", recvd);
+    } else {
+        Serial.println("Failed to conenct.");
+    }
+    ar4.disconnect();
+}
+
+void loop() {
+
+}
@@ -0,0 +1,98 @@
+/*
+ *  This example demonstrates incremental history sync. Only records
+ *  measured since previous sync are downloaded. Sync state (cursor) is
+ *  kept in flash, so it survives reboot.
+ *
+ *  syncHistory() needs current time. Set system clock before first sync,
+ *  eg. with configTime() and WiFi, or from RTC.
+ *
+ *  Name:       HistorySync.ino
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "Aranet4.h"
+#include <Preferences.h>
+#include <time.h>
+
+// Address can be string or byte array
+String addr = "00:01:02:03:04:05"; // Put your Aranet MAC address here
+
+// Sync every 10 minutes
+#define SYNC_INTERVAL_MS (10 * 60 * 1000)
+
+// Create custom callback to allow PIN code input.
+// In this example, when PIN is requested, you must enter it in serial console.
+class MyAranet4Callbacks: public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        Serial.println("PIN Requested. Enter PIN in serial console.");
+        while(Serial.available() == 0)
+            vTaskDelay(500 / portTICK_PERIOD_MS);
+        return  Serial.readString().toInt();
+    }
+};
+
+// Receives new records, oldest first
+class MyHistoryCallbacks: public AranetHistoryCallbacks {
+    bool onHistoryRecords(uint16_t start, AranetDataCompact* records, uint16_t count) {
+        for (int i = 0; i < count; i++) {
+            AranetDataCompact& rec = records[i];
+            Serial.printf("#%i: \t%i ppm \t%.1f C \t%.1f hPa \t%i %%\n", start + i,
+                rec.aranet4.co2,
+                rec.aranet4.temperature / 20.0,
+                rec.aranet4.pressure / 10.0,
+                rec.aranet4.humidity);
+        }
+        return true;
+    }
+};
+
+Aranet4 ar4(new MyAranet4Callbacks());
+MyHistoryCallbacks history;
+Preferences prefs;
+AranetHistoryCursor cursor;
+
+void sync() {
+    time_t now = time(nullptr);
+    if (now < 1600000000) {
+        Serial.println("System time is not set.");
+        return;
+    }
+
+    Serial.println("Connecting...");
+    if (ar4.connect(addr) != AR4_OK) {
+        Serial.println("Failed to conenct.");
+        return;
+    }
+
+    int recvd = ar4.syncHistory(&cursor, now, &history);
+    ar4.disconnect();
+
+    if (recvd < 0) {
+        Serial.printf("Sync failed: %i\n", ar4.getStatus());
+    } else {
+        Serial.printf("Synced %i new records\n", recvd);
+    }
+
+    // Cursor is advanced also if sync was interrupted
+    prefs.putBytes("cursor", &cursor, sizeof(cursor));
+}
+
+void setup() {
+    Serial.begin(115200);
+    Serial.println("Init");
+
+    prefs.begin("aranet", false);
+    if (prefs.getBytes("cursor", &cursor, sizeof(cursor)) != sizeof(cursor)) {
+        memset(&cursor, 0, sizeof(cursor)); // first sync downloads whole log
+    }
+
+    // Set up bluettoth security and callbacks
+    Aranet4::init();
+}
+
+void loop() {
+    sync();
+    delay(SYNC_INTERVAL_MS);
+}
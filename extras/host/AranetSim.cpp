@@ -0,0 +1,442 @@
+/*
+ *  Name:       AranetSim.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "AranetSim.h"
+
+#define ATT_ERR_INVALID_HANDLE      0x01
+#define ATT_ERR_WRITE_NOT_PERMITTED 0x03
+#define ATT_ERR_INVALID_PDU         0x04
+
+#define PROP_R    BLE_GATT_CHR_PROP_READ
+#define PROP_W    BLE_GATT_CHR_PROP_WRITE
+#define PROP_WNR  BLE_GATT_CHR_PROP_WRITE_NO_RSP
+#define PROP_N    BLE_GATT_CHR_PROP_NOTIFY
+
+AranetSim::AranetSim(const NimBLEAddress& address, const AranetSimConfig& config)
+        : NimBLESimPeripheral(address), config(config) {
+    written = config.totalReadings;
+
+    const uint8_t* mac = address.getNative();
+    const char* prefix = "Aranet4";
+    switch (config.type) {
+    case ARANET2:          prefix = "Aranet2"; break;
+    case ARANET_RADIATION: prefix = "Aranet\xE2\x98\xA2"; break;
+    case ARANET_RADON:     prefix = "AranetRn+"; break;
+    default: break;
+    }
+    snprintf(nameBuf, sizeof(nameBuf), "%s %02X%02X%X", prefix, mac[2], mac[1], mac[0] >> 4);
+
+    bool open = config.integrations;
+    uint8_t cmdProps = PROP_W | (config.cmdNoResponse ? PROP_WNR : 0);
+
+    services.push_back({UUID_Generic, {
+        {UUID_Generic_DeviceName, H_DEVICE_NAME, PROP_R, false},
+    }});
+
+    services.push_back({UUID_Common, {
+        {UUID_Common_Manufacturer, H_MANUFACTURER, PROP_R, false},
+        {UUID_Common_Model,        H_MODEL,        PROP_R, false},
+        {UUID_Common_Serial,       H_SERIAL,       PROP_R, false},
+        {UUID_Common_HwRev,        H_HW_REV,       PROP_R, false},
+        {UUID_Common_FwRev,        H_FW_REV,       PROP_R, false},
+        {UUID_Common_SwRev,        H_SW_REV,       PROP_R, false},
+        {UUID_Common_Battery,      H_BATTERY,      PROP_R, false},
+    }});
+
+    Service aranet = {config.legacyService ? UUID_Aranet4_Old : UUID_Aranet4, {}};
+    if (config.type == ARANET4) {
+        aranet.characteristics.push_back({UUID_Aranet4_CurrentReadings,    H_CURRENT,     PROP_R, !open});
+        aranet.characteristics.push_back({UUID_Aranet4_CurrentReadingsDet, H_CURRENT_DET, PROP_R, !open});
+    } else {
+        aranet.characteristics.push_back({UUID_Aranet2_CurrentReadings,    H_CURRENT_A2,  PROP_R, !open});
+    }
+    aranet.characteristics.push_back({UUID_Aranet4_Interval,           H_INTERVAL,       PROP_R,   true});
+    aranet.characteristics.push_back({UUID_Aranet4_SecondsSinceUpdate, H_SINCE_UPDATE,   PROP_R,   true});
+    aranet.characteristics.push_back({UUID_Aranet4_TotalReadings,      H_TOTAL,          PROP_R,   true});
+    aranet.characteristics.push_back({UUID_Aranet4_Cmd,                H_CMD,            cmdProps, true});
+    aranet.characteristics.push_back({UUID_Aranet4_Notify_History,     H_NOTIFY_HISTORY, PROP_N,   true});
+    if (config.historyV2) {
+        aranet.characteristics.push_back({UUID_Aranet4_History,        H_HISTORY,        PROP_R,   true});
+    }
+    services.push_back(aranet);
+}
+
+AranetSim::~AranetSim() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    v1Stream++;
+}
+
+uint64_t AranetSim::value(uint8_t param, uint32_t record) {
+    switch (param) {
+    case AR4_PARAM_TEMPERATURE:             return 400 + (record * 3) % 200;
+    case AR4_PARAM_HUMIDITY:                return 30 + record % 50;
+    case AR4_PARAM_PRESSURE:                return 9900 + (record * 7) % 300;
+    case AR4_PARAM_CO2:                     return 400 + (record * 37) % 1800;
+    case AR4_PARAM_HUMIDITY2:               return 300 + (record * 11) % 400;
+    case AR4_PARAM_RADIATION_PULSES:        return (record * 5) % 1000;
+    case AR4_PARAM_RADIATION_DOSE:          return (record * 131) % 0x1000000;
+    case AR4_PARAM_RADIATION_DOSE_RATE:     return (record * 97) % 0x1000000;
+    case AR4_PARAM_RADIATION_DOSE_INTEGRAL: return (uint64_t) record * 100003ULL;
+    case AR4_PARAM_RADON_CONCENTRATION:     return 20 + (record * 113) % 70000;
+    }
+    return 0;
+}
+
+uint8_t AranetSim::width(uint8_t param) {
+    switch (param) {
+    case AR4_PARAM_HUMIDITY:                return 1;
+    case AR4_PARAM_RADIATION_DOSE:
+    case AR4_PARAM_RADIATION_DOSE_RATE:     return 3;
+    case AR4_PARAM_RADON_CONCENTRATION:     return 4;
+    case AR4_PARAM_RADIATION_DOSE_INTEGRAL: return 8;
+    }
+    return 2;
+}
+
+uint16_t AranetSim::params(AranetType type) {
+    switch (type) {
+    case ARANET4:          return AR4_PARAM_FLAGS;
+    case ARANET2:          return AR2_PARAM_FLAGS;
+    case ARANET_RADIATION: return AR4_PARAM_RADIATION_PULSES_FLAG | AR4_PARAM_RADIATION_DOSE_FLAG | ARR_PARAM_FLAGS;
+    case ARANET_RADON:     return ARRN_PARAM_FLAGS;
+    default:               return 0;
+    }
+}
+
+uint64_t AranetSim::history(uint8_t param, uint16_t index) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return value(param, written - config.totalReadings + index);
+}
+
+AranetData AranetSim::current() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    AranetData data;
+    data.type = config.type;
+    data.battery = 87;
+    data.status = 1;
+    data.interval = config.interval;
+    data.ago = config.ago;
+    data.counter = config.counter;
+
+    switch (config.type) {
+    case ARANET4:
+        data.co2 = value(AR4_PARAM_CO2, written);
+        data.temperature = value(AR4_PARAM_TEMPERATURE, written);
+        data.pressure = value(AR4_PARAM_PRESSURE, written);
+        data.humidity = value(AR4_PARAM_HUMIDITY, written);
+        break;
+    case ARANET2:
+        data.temperature = value(AR4_PARAM_TEMPERATURE, written);
+        data.humidity = value(AR4_PARAM_HUMIDITY2, written);
+        break;
+    case ARANET_RADIATION:
+        data.radiation_rate = value(AR4_PARAM_RADIATION_DOSE_RATE, written);
+        data.radiation_total = value(AR4_PARAM_RADIATION_DOSE_INTEGRAL, written);
+        data.radiation_duration = (uint64_t) written * config.interval;
+        break;
+    case ARANET_RADON:
+        data.radon_concentration = value(AR4_PARAM_RADON_CONCENTRATION, written);
+        data.temperature = value(AR4_PARAM_TEMPERATURE, written);
+        data.pressure = value(AR4_PARAM_PRESSURE, written);
+        data.humidity = value(AR4_PARAM_HUMIDITY2, written);
+        break;
+    default:
+        break;
+    }
+    return data;
+}
+
+void AranetSim::measure() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    written++;
+    config.totalReadings = written < config.capacity ? written : config.capacity;
+    config.ago = 0;
+    config.counter++;
+}
+
+const char* AranetSim::name() {
+    return nameBuf;
+}
+
+uint16_t AranetSim::fill16(uint8_t* buf, uint16_t pos, uint16_t val) {
+    buf[pos] = val & 0xff;
+    buf[pos + 1] = val >> 8;
+    return pos + 2;
+}
+
+static uint16_t fillString(uint8_t* value, const char* str) {
+    uint16_t len = strlen(str);
+    memcpy(value, str, len);
+    return len;
+}
+
+int AranetSim::onRead(uint16_t handle, uint8_t* value, uint16_t* len) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    char buf[16];
+
+    switch (handle) {
+    case H_DEVICE_NAME:  *len = fillString(value, nameBuf); return 0;
+    case H_MANUFACTURER: *len = fillString(value, "SAF Tehnika"); return 0;
+    case H_MODEL:        *len = fillString(value, nameBuf); return 0;
+    case H_SERIAL:       *len = fillString(value, "SIM0001"); return 0;
+    case H_HW_REV:       *len = fillString(value, "12"); return 0;
+    case H_SW_REV:       *len = fillString(value, "v1.4.4"); return 0;
+    case H_FW_REV:
+        snprintf(buf, sizeof(buf), "v%u.%u.%u", config.fwMajor, config.fwMinor, config.fwPatch);
+        *len = fillString(value, buf);
+        return 0;
+    case H_BATTERY:      value[0] = 87; *len = 1; return 0;
+    case H_INTERVAL:     *len = fill16(value, 0, config.interval); return 0;
+    case H_SINCE_UPDATE: *len = fill16(value, 0, config.ago); return 0;
+    case H_TOTAL:        *len = fill16(value, 0, config.totalReadings); return 0;
+    case H_CURRENT:
+    case H_CURRENT_DET:
+    case H_CURRENT_A2:
+        return readCurrent(handle, value, len);
+    case H_HISTORY:
+        return readHistory(value, len);
+    }
+
+    return ATT_ERR_INVALID_HANDLE;
+}
+
+int AranetSim::readCurrent(uint16_t handle, uint8_t* value, uint16_t* len) {
+    AranetData d = current();
+    memset(value, 0, 32);
+
+    switch (config.type) {
+    case ARANET4:
+        fill16(value, 0, d.co2);
+        fill16(value, 2, d.temperature);
+        fill16(value, 4, d.pressure);
+        value[6] = d.humidity;
+        value[7] = d.battery;
+        value[8] = d.status;
+        fill16(value, 9, d.interval);
+        fill16(value, 11, d.ago);
+        *len = handle == H_CURRENT_DET ? 13 : 9;
+        return 0;
+    case ARANET2:
+        fill16(value, 2, d.interval);
+        fill16(value, 4, d.ago);
+        value[6] = d.battery;
+        fill16(value, 7, d.temperature);
+        fill16(value, 9, d.humidity);
+        value[11] = d.status;
+        *len = 12;
+        return 0;
+    case ARANET_RADIATION:
+        fill16(value, 2, d.interval);
+        fill16(value, 4, d.ago);
+        value[6] = d.battery;
+        memcpy(value + 7, &d.radiation_rate, 4);
+        memcpy(value + 11, &d.radiation_total, 8);
+        memcpy(value + 19, &d.radiation_duration, 8);
+        value[27] = d.status;
+        *len = 28;
+        return 0;
+    case ARANET_RADON:
+        fill16(value, 2, d.interval);
+        fill16(value, 4, d.ago);
+        value[6] = d.battery;
+        fill16(value, 7, d.temperature);
+        fill16(value, 9, d.pressure);
+        fill16(value, 11, d.humidity);
+        memcpy(value + 13, &d.radon_concentration, 4);
+        value[17] = d.status;
+        *len = 18;
+        return 0;
+    default:
+        break;
+    }
+    return ATT_ERR_INVALID_HANDLE;
+}
+
+int AranetSim::readHistory(uint8_t* value, uint16_t* len) {
+    uint8_t w = width(v2Param);
+    uint16_t total = config.totalReadings;
+    uint16_t count = 0;
+
+    if ((params(config.type) & (1 << (v2Param - 1))) && v2Start >= 1 && v2Start <= total) {
+        // Device sizes history value to fit in single ATT read response
+        uint16_t fit = (getMTU() - 1 - sizeof(AranetHistoryHeader)) / w;
+        count = total - v2Start + 1;
+        if (count > fit) count = fit;
+        if (count > 255) count = 255;
+    }
+
+    value[0] = v2Param;
+    fill16(value, 1, config.interval);
+    fill16(value, 3, total);
+    fill16(value, 5, config.ago);
+    fill16(value, 7, v2Start);
+    value[9] = count;
+
+    uint8_t* ptr = value + sizeof(AranetHistoryHeader);
+    for (uint16_t i = 0; i < count; i++) {
+        uint64_t val = history(v2Param, v2Start + i);
+        memcpy(ptr, &val, w);
+        ptr += w;
+    }
+
+    *len = ptr - value;
+    return 0;
+}
+
+int AranetSim::onWrite(uint16_t handle, const uint8_t* value, uint16_t len) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    if (handle != H_CMD) return ATT_ERR_WRITE_NOT_PERMITTED;
+    if (len < 1) return ATT_ERR_INVALID_PDU;
+
+    switch (value[0]) {
+    case 0x61: // V2 history: param, start
+        if (len < 4) return ATT_ERR_INVALID_PDU;
+        v2Param = value[1];
+        v2Start = value[2] | (value[3] << 8);
+        return 0;
+    case 0x82: // V1 history: param, 0, 0, start, end
+        if (len < 8) return ATT_ERR_INVALID_PDU;
+        v1Param = value[1];
+        v1Start = value[4] | (value[5] << 8);
+        v1End = value[6] | (value[7] << 8);
+        if (v1End > config.totalReadings) v1End = config.totalReadings;
+        return 0;
+    }
+    return 0;
+}
+
+void AranetSim::onSubscribe(uint16_t handle, bool enabled) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    if (handle != H_NOTIFY_HISTORY) return;
+
+    uint32_t stream = ++v1Stream;
+    if (!enabled || v1Param == 0 || v1Start < 1 || v1Start > v1End) return;
+
+    uint16_t start = v1Start;
+    post(getConnInterval(), [this, stream, start] { streamHistoryV1(stream, start); });
+}
+
+void AranetSim::streamHistoryV1(uint32_t stream, uint16_t idx) {
+    uint8_t packet[SIM_MAX_ATTR_LEN];
+    uint16_t count;
+    uint8_t w;
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        if (stream != v1Stream) return;
+
+        w = v1Param == AR4_PARAM_HUMIDITY ? 1 : 2;
+        uint16_t fit = (getMTU() - 3 - 4) / w;
+        if (fit > 255) fit = 255; // count field is one byte
+        uint16_t left = v1End - idx + 1;
+        count = left < fit ? left : fit;
+
+        packet[0] = v1Param;
+        fill16(packet, 1, idx);
+        packet[3] = count;
+        for (uint16_t i = 0; i < count; i++) {
+            uint64_t val = history(v1Param, idx + i);
+            memcpy(packet + 4 + i * w, &val, w);
+        }
+    }
+
+    notify(H_NOTIFY_HISTORY, packet, 4 + count * w);
+
+    idx += count;
+    if (idx > v1End) {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        if (stream == v1Stream) v1Param = 0;
+        return;
+    }
+
+    post(getConnInterval() / link.notifyPerEvent, [this, stream, idx] { streamHistoryV1(stream, idx); });
+}
+
+void AranetSim::onDisconnect() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    v1Stream++;
+    v1Param = 0;
+}
+
+bool AranetSim::getAdvertisement(NimBLEAdvertisedDevice* adv) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    AranetData d = current();
+    uint8_t payload[62];
+    uint8_t mfr[26];
+    uint8_t idx = config.type == ARANET4 ? 0 : 1;
+    uint8_t len;
+
+    memset(mfr, 0, sizeof(mfr));
+    mfr[0] = config.type;
+    mfr[idx + 0] = config.integrations ? 0x20 : 0x00;
+    mfr[idx + 1] = config.fwPatch;
+    mfr[idx + 2] = config.fwMinor;
+    mfr[idx + 3] = config.fwMajor & 0xff;
+    mfr[idx + 4] = config.fwMajor >> 8;
+    mfr[idx + 5] = 12;
+    mfr[idx + 7] = 1;
+
+    if (!config.integrations) {
+        len = 7;
+    } else if (config.type == ARANET4) {
+        fill16(mfr, 8, d.co2);
+        fill16(mfr, 10, d.temperature);
+        fill16(mfr, 12, d.pressure);
+        mfr[14] = d.humidity;
+        mfr[15] = d.battery;
+        mfr[16] = d.status;
+        fill16(mfr, 17, d.interval);
+        fill16(mfr, 19, d.ago);
+        mfr[21] = d.counter;
+        len = 22;
+    } else {
+        switch (config.type) {
+        case ARANET2:
+            fill16(mfr, 10, d.temperature);
+            fill16(mfr, 14, d.humidity);
+            break;
+        case ARANET_RADIATION:
+            memcpy(mfr + 6, &d.radiation_total, 4);
+            memcpy(mfr + 10, &d.radiation_duration, 4);
+            memcpy(mfr + 14, &d.radiation_rate, 2);
+            break;
+        case ARANET_RADON:
+            fill16(mfr, 8, d.radon_concentration);
+            fill16(mfr, 10, d.temperature);
+            fill16(mfr, 12, d.pressure);
+            fill16(mfr, 14, d.humidity);
+            break;
+        default:
+            break;
+        }
+        mfr[17] = d.battery;
+        mfr[18] = d.status;
+        fill16(mfr, 19, d.interval);
+        fill16(mfr, 21, d.ago);
+        mfr[23] = d.counter;
+        len = 24;
+    }
+
+    // Flags, manufacturer data, then name from scan response
+    uint8_t pos = 0;
+    payload[pos++] = 2;
+    payload[pos++] = 0x01;
+    payload[pos++] = 0x06;
+    payload[pos++] = len + 3;
+    payload[pos++] = 0xff;
+    pos = fill16(payload, pos, ARANET4_MANUFACTURER_ID);
+    memcpy(payload + pos, mfr, len);
+    pos += len;
+
+    uint8_t nameLen = strlen(nameBuf);
+    payload[pos++] = nameLen + 1;
+    payload[pos++] = 0x09;
+    memcpy(payload + pos, nameBuf, nameLen);
+    pos += nameLen;
+
+    adv->setAdvertisement(getAddress(), payload, pos);
+    return true;
+}
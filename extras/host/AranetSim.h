@@ -0,0 +1,90 @@
+/*
+ *  Name:       AranetSim.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Simulated Aranet4 / Aranet2 / Aranet Radiation / Aranet Radon device.
+ *  Serves the GATT characteristics from Aranet4.h, V1 (notification) and
+ *  V2 (read) history protocols and manufacturer data advertisements.
+ *  History values are generated from record index, see AranetSim::value().
+ */
+
+#ifndef __ARANETSIM_H
+#define __ARANETSIM_H
+
+#include "Aranet4.h"
+#include "NimBLESim.h"
+
+struct AranetSimConfig {
+    AranetType type          = ARANET4;
+    uint16_t   totalReadings = 2016;   // records stored in device log
+    uint16_t   capacity      = 2016;   // log size, oldest records are dropped after that
+    uint16_t   interval      = 300;    // measurement interval, seconds
+    uint16_t   ago           = 42;     // seconds since last measurement
+    uint8_t    counter       = 0;      // advertisement measurement counter
+    bool       historyV2     = true;   // has UUID_Aranet4_History characteristic
+    bool       legacyService = false;  // use UUID_Aranet4_Old instead of UUID_Aranet4
+    bool       integrations  = true;   // Smart Home Integrations enabled
+    bool       cmdNoResponse = true;   // command characteristic accepts write without response
+    uint16_t   fwMajor       = 1;
+    uint8_t    fwMinor       = 4;
+    uint8_t    fwPatch       = 19;
+};
+
+class AranetSim : public NimBLESimPeripheral {
+public:
+    AranetSim(const NimBLEAddress& address, const AranetSimConfig& config = AranetSimConfig());
+    ~AranetSim();
+
+    AranetSimConfig config;
+
+    // Value of param in n-th measurement since device was reset (1 = first)
+    static uint64_t value(uint8_t param, uint32_t record);
+    // Wire width of param in V2 history
+    static uint8_t  width(uint8_t param);
+    // History params stored by device type
+    static uint16_t params(AranetType type);
+
+    // Expected history value for param at log index (1 = oldest stored)
+    uint64_t   history(uint8_t param, uint16_t index);
+    // Current readings, derived from newest history record
+    AranetData current();
+    // Store new measurement: advances log and advertisement counter
+    void       measure();
+    // Device name as seen in Generic Access service
+    const char* name();
+
+    int  onRead(uint16_t handle, uint8_t* value, uint16_t* len) override;
+    int  onWrite(uint16_t handle, const uint8_t* value, uint16_t len) override;
+    void onSubscribe(uint16_t handle, bool enabled) override;
+    void onDisconnect() override;
+    bool getAdvertisement(NimBLEAdvertisedDevice* adv) override;
+private:
+    enum {
+        H_DEVICE_NAME = 3,
+        H_MANUFACTURER = 10, H_MODEL, H_SERIAL, H_HW_REV, H_FW_REV, H_SW_REV, H_BATTERY,
+        H_CURRENT = 30, H_CURRENT_DET, H_CURRENT_A2, H_INTERVAL, H_SINCE_UPDATE,
+        H_TOTAL, H_CMD, H_NOTIFY_HISTORY, H_HISTORY
+    };
+
+    char     nameBuf[24];
+    uint32_t written;   // measurements made since reset
+
+    // V2 history request (0x61)
+    uint8_t  v2Param = 0;
+    uint16_t v2Start = 1;
+
+    // V1 history request (0x82) and notification stream state
+    uint8_t  v1Param = 0;
+    uint16_t v1Start = 0;
+    uint16_t v1End = 0;
+    uint32_t v1Stream = 0;
+
+    uint16_t fill16(uint8_t* buf, uint16_t pos, uint16_t val);
+    int      readCurrent(uint16_t handle, uint8_t* value, uint16_t* len);
+    int      readHistory(uint8_t* value, uint16_t* len);
+    void     streamHistoryV1(uint32_t stream, uint16_t idx);
+};
+
+#endif
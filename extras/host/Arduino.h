@@ -0,0 +1,67 @@
+/*
+ *  Name:       Arduino.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Minimal host (Linux) stand-in for the parts of Arduino-ESP32 core used by
+ *  this library. Only intended for simulator builds in extras/host.
+ */
+
+#ifndef __HOST_ARDUINO_H
+#define __HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+class String {
+public:
+    String() {}
+    String(const char* cstr) : str(cstr ? cstr : "") {}
+    String(const std::string& s) : str(s) {}
+    String(int value) : str(std::to_string(value)) {}
+
+    const char* c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.length(); }
+    char charAt(unsigned int index) const { return index < str.length() ? str[index] : 0; }
+    long toInt() const { return strtol(str.c_str(), nullptr, 10); }
+
+    bool operator==(const String& rhs) const { return str == rhs.str; }
+    bool operator!=(const String& rhs) const { return str != rhs.str; }
+    String& operator+=(const String& rhs) { str += rhs.str; return *this; }
+    String operator+(const String& rhs) const { return String(str + rhs.str); }
+private:
+    std::string str;
+};
+
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    int  available() { return 0; }
+    String readString() { return String(); }
+    size_t print(const char* s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t println(const char* s = "") { size_t n = print(s); fputc('\n', stdout); return n + 1; }
+    size_t println(const String& s) { return println(s.c_str()); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vprintf(fmt, args);
+        va_end(args);
+        return n < 0 ? 0 : n;
+    }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ *  Name:       HostAlloc.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "HostAlloc.h"
+
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void  __libc_free(void* ptr);
+}
+
+static thread_local size_t allocations = 0;
+static thread_local int    paused = 0;
+
+size_t hostAllocations() {
+    return allocations;
+}
+
+HostAllocPause::HostAllocPause() {
+    paused++;
+}
+
+HostAllocPause::~HostAllocPause() {
+    paused--;
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    if (!paused) allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (!paused) allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!paused) allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+}
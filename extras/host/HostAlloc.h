@@ -0,0 +1,29 @@
+/*
+ *  Name:       HostAlloc.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Heap allocation counter of host build. malloc, calloc and realloc are
+ *  replaced with counting wrappers of glibc allocator, operator new and
+ *  std::string go through them too. Counts are per thread, so simulator
+ *  threads do not disturb measurement of calling thread.
+ */
+
+#ifndef __HOST_ALLOC_H
+#define __HOST_ALLOC_H
+
+#include <stddef.h>
+
+// Heap allocations made by calling thread since start
+size_t hostAllocations();
+
+// Allocations are not counted while object exists. Used by simulated host
+// stack, it stands for NimBLE that uses its own preallocated buffers.
+class HostAllocPause {
+public:
+    HostAllocPause();
+    ~HostAllocPause();
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ *  Name:       HostArduino.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Host implementation of the Arduino and FreeRTOS stand-ins.
+ */
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HostSerial Serial;
+
+static std::chrono::steady_clock::time_point bootTime() {
+    static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+    return boot;
+}
+
+unsigned long millis() {
+    auto d = std::chrono::steady_clock::now() - bootTime();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+unsigned long micros() {
+    auto d = std::chrono::steady_clock::now() - bootTime();
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Storage is allocated once, like FreeRTOS queue, so send and receive never allocate
+struct HostQueue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<uint8_t> storage;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+template<typename Pred>
+static bool waitFor(HostQueue* q, std::unique_lock<std::mutex>& lk, TickType_t ticks, Pred pred) {
+    if (ticks == portMAX_DELAY) {
+        q->changed.wait(lk, pred);
+        return true;
+    }
+    return q->changed.wait_for(lk, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue* q = new HostQueue();
+    q->length = length;
+    q->itemSize = itemSize;
+    q->storage.resize(length * itemSize);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lk(queue->lock);
+    if (!waitFor(queue, lk, ticksToWait, [queue] { return queue->count < queue->length; })) {
+        return pdFALSE;
+    }
+    UBaseType_t slot = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage.data() + slot * queue->itemSize, item, queue->itemSize);
+    queue->count++;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lk(queue->lock);
+    if (!waitFor(queue, lk, ticksToWait, [queue] { return queue->count > 0; })) {
+        return pdFALSE;
+    }
+    memcpy(buffer, queue->storage.data() + queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lk(queue->lock);
+    queue->head = 0;
+    queue->count = 0;
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lk(queue->lock);
+    return queue->count;
+}
+
+// Mutex is semaphore with count 1, not recursive
+struct HostSemaphore {
+    std::mutex lock;
+    std::condition_variable changed;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    HostSemaphore* sem = new HostSemaphore();
+    sem->count = 1;
+    sem->max = 1;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    HostSemaphore* sem = new HostSemaphore();
+    sem->count = initialCount;
+    sem->max = maxCount;
+    return sem;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lk(sem->lock);
+    auto available = [sem] { return sem->count > 0; };
+    if (ticksToWait == portMAX_DELAY) {
+        sem->changed.wait(lk, available);
+    } else if (!sem->changed.wait_for(lk, std::chrono::milliseconds(ticksToWait * portTICK_PERIOD_MS), available)) {
+        return pdFALSE;
+    }
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    std::lock_guard<std::mutex> lk(sem->lock);
+    if (sem->count >= sem->max) return pdFALSE;
+    sem->count++;
+    sem->changed.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                       void* param, UBaseType_t priority, TaskHandle_t* handle) {
+    std::thread(fn, param).detach();
+    if (handle != nullptr) *handle = nullptr;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // Thread ends when task function returns
+}
+
+TickType_t xTaskGetTickCount() {
+    return millis() / portTICK_PERIOD_MS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks * portTICK_PERIOD_MS);
+}
@@ -0,0 +1,1508 @@
+/*
+ *  Name:       NimBLEDevice.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Host implementation of the NimBLE stand-in and the simulated link.
+ */
+
+#include "NimBLEDevice.h"
+#include "NimBLESim.h"
+#include "HostAlloc.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <thread>
+
+/* ------------------------------------------------------------------------ */
+/* Simulated link                                                           */
+/* ------------------------------------------------------------------------ */
+
+namespace {
+
+struct HostTask {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::multimap<uint64_t, std::function<void()>> events;
+    std::thread thread;
+
+    HostTask() : thread([this] { run(); }) {
+        thread.detach();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lk(mtx);
+        for (;;) {
+            if (events.empty()) {
+                cv.wait(lk);
+                continue;
+            }
+            uint64_t due = events.begin()->first;
+            uint64_t now = NimBLESim::nowUs();
+            if (due > now) {
+                cv.wait_for(lk, std::chrono::microseconds(due - now));
+                continue;
+            }
+            std::function<void()> fn = std::move(events.begin()->second);
+            events.erase(events.begin());
+            lk.unlock();
+            fn();
+            lk.lock();
+        }
+    }
+};
+
+// Leaked on purpose: host task may still run while static destructors do
+HostTask& hostTask() {
+    static HostTask* task = new HostTask();
+    return *task;
+}
+
+std::vector<NimBLESimPeripheral*>& registry() {
+    static std::vector<NimBLESimPeripheral*>* list = new std::vector<NimBLESimPeripheral*>();
+    return *list;
+}
+
+uint32_t nextLinkId = 1;
+uint16_t nextConnId = 0;
+uint32_t pendingConnects = 0;   // connection attempts in progress, controller allows one
+
+} // namespace
+
+std::recursive_mutex& NimBLESim::lock() {
+    static std::recursive_mutex* mtx = new std::recursive_mutex();
+    return *mtx;
+}
+
+uint64_t NimBLESim::nowUs() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    auto d = std::chrono::steady_clock::now() - epoch;
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void NimBLESim::sleepUntil(uint64_t us) {
+    uint64_t now = nowUs();
+    if (us > now) std::this_thread::sleep_for(std::chrono::microseconds(us - now));
+}
+
+void NimBLESim::post(uint64_t atUs, std::function<void()> fn) {
+    HostTask& task = hostTask();
+    std::lock_guard<std::mutex> lk(task.mtx);
+    task.events.emplace(atUs, std::move(fn));
+    task.cv.notify_all();
+}
+
+NimBLESimPeripheral* NimBLESim::find(const NimBLEAddress& address) {
+    std::lock_guard<std::recursive_mutex> lk(lock());
+    for (NimBLESimPeripheral* p : registry()) {
+        if (p->getAddress() == address) return p;
+    }
+    return nullptr;
+}
+
+std::vector<NimBLESimPeripheral*> NimBLESim::peripherals() {
+    std::lock_guard<std::recursive_mutex> lk(lock());
+    return registry();
+}
+
+NimBLESimPeripheral::NimBLESimPeripheral(const NimBLEAddress& address) : address(address) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    registry().push_back(this);
+}
+
+NimBLESimPeripheral::~NimBLESimPeripheral() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    if (client != nullptr) client->disconnect();
+    auto& list = registry();
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+}
+
+const NimBLESimPeripheral::Service* NimBLESimPeripheral::findService(const NimBLEUUID& uuid) const {
+    for (const Service& svc : services) {
+        if (svc.uuid == uuid) return &svc;
+    }
+    return nullptr;
+}
+
+const NimBLESimPeripheral::Characteristic* NimBLESimPeripheral::findCharacteristic(uint16_t handle) const {
+    for (const Service& svc : services) {
+        for (const Characteristic& chr : svc.characteristics) {
+            if (chr.handle == handle) return &chr;
+        }
+    }
+    return nullptr;
+}
+
+bool NimBLESimPeripheral::isConnected() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return client != nullptr;
+}
+
+uint16_t NimBLESimPeripheral::getMTU() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return client != nullptr ? client->m_mtu : BLE_ATT_MTU_DFLT;
+}
+
+uint32_t NimBLESimPeripheral::getConnInterval() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return client != nullptr ? intervalUs : link.connIntervalUs;
+}
+
+uint16_t NimBLESimPeripheral::getConnLatency() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return client != nullptr ? latency : 0;
+}
+
+bool NimBLESimPeripheral::writeNoRspArrives() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    stats.writesNoRsp++;
+    if (link.writeDropEvery && stats.writesNoRsp % link.writeDropEvery == 0) {
+        stats.writesLost++;
+        return false;
+    }
+    return true;
+}
+
+void NimBLESimPeripheral::startLink() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    intervalUs = link.connIntervalUs;
+    latency = 0;
+    eventsFromUs = NimBLESim::nowUs();
+    paramsPending = false;
+}
+
+// Idle peripheral wakes up every latency + 1 events. Events with ATT
+// traffic are added by reserveRoundTrip().
+void NimBLESimPeripheral::countEvents() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    uint64_t now = NimBLESim::nowUs();
+    if (now > eventsFromUs) stats.connEvents += (now - eventsFromUs) / ((uint64_t) intervalUs * (latency + 1));
+    eventsFromUs = now;
+}
+
+void NimBLESimPeripheral::setConnParams(uint32_t us, uint16_t lat) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    countEvents();
+    intervalUs = us;
+    latency = lat;
+    paramsPending = false;
+    stats.connParamUpdates++;
+}
+
+bool NimBLESimPeripheral::notify(uint16_t handle, const uint8_t* data, uint16_t len) {
+    NimBLERemoteCharacteristic* chr = nullptr;
+    NimBLERemoteCharacteristic::notify_callback cb;
+    uint8_t value[SIM_MAX_ATTR_LEN];
+
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        if (client == nullptr) return false;
+        if (len > client->m_mtu - 3) len = client->m_mtu - 3;
+
+        for (NimBLERemoteService* svc : client->m_servicesVector) {
+            for (NimBLERemoteCharacteristic* c : svc->m_characteristicVector) {
+                if (c->m_handle == handle && c->m_notifyCallback) {
+                    chr = c;
+                    cb = c->m_notifyCallback;
+                }
+            }
+        }
+
+        stats.notifications++;
+        stats.bytesNotified += len;
+        if (chr == nullptr) return false;
+
+        if (link.notifyDropEvery && stats.notifications % link.notifyDropEvery == 0) {
+            stats.notificationsLost++;
+            return true;
+        }
+    }
+
+    memcpy(value, data, len);
+    cb(chr, value, len, true);
+    return true;
+}
+
+void NimBLESimPeripheral::post(uint32_t delayUs, std::function<void()> fn) {
+    uint32_t id = linkId;
+    NimBLESimPeripheral* self = this;
+    NimBLESim::post(NimBLESim::nowUs() + delayUs, [self, id, fn] {
+        {
+            std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+            auto& list = registry();
+            if (std::find(list.begin(), list.end(), self) == list.end()) return;
+            if (self->client == nullptr || self->linkId != id) return;
+        }
+        fn();
+    });
+}
+
+bool NimBLESimPeripheral::roundTrip(uint32_t count) {
+    NimBLEClient* c;
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        c = client;
+    }
+
+    bool lost;
+    NimBLESim::sleepUntil(reserveRoundTrip(count, &lost));
+
+    if (lost) {
+        // Peer stopped answering, client noticed after supervision timeout
+        stats.linkLosses++;
+        c->disconnect();
+        return false;
+    }
+    return true;
+}
+
+void NimBLESimPeripheral::wait(uint32_t us) {
+    NimBLESim::sleepUntil(reserve(us));
+}
+
+uint64_t NimBLESimPeripheral::reserve(uint32_t us) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    uint64_t start = std::max(NimBLESim::nowUs(), busyUntilUs);
+    busyUntilUs = start + us;
+    return busyUntilUs;
+}
+
+uint64_t NimBLESimPeripheral::reserveRoundTrip(uint32_t count, bool* lost) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    roundTrips++;
+    *lost = client != nullptr && link.linkLossEvery && roundTrips % link.linkLossEvery == 0;
+    if (*lost) return reserve(link.supervisionUs);
+
+    uint32_t us = client != nullptr ? intervalUs : link.connIntervalUs;
+    uint16_t lat = client != nullptr ? latency : 0;
+    // Sleeping peripheral hears request on average after half its latency
+    if (lat > 0) stats.connEvents += count * link.eventsPerRtt;
+    return reserve((uint64_t) count * (link.eventsPerRtt * 2 + lat) * us / 2);
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLEUUID                                                               */
+/* ------------------------------------------------------------------------ */
+
+NimBLEUUID::NimBLEUUID(const std::string& uuid) : m_value(uuid) {
+    std::transform(m_value.begin(), m_value.end(), m_value.begin(), ::tolower);
+    m_native.u.type = bitSize();
+    snprintf(m_native.u.str, sizeof(m_native.u.str), "%s", m_value.c_str());
+}
+
+NimBLEUUID::NimBLEUUID(const char* uuid) : NimBLEUUID(std::string(uuid)) {}
+
+NimBLEUUID::NimBLEUUID(uint16_t uuid) {
+    char buf[5];
+    snprintf(buf, sizeof(buf), "%04x", uuid);
+    *this = NimBLEUUID(std::string(buf));
+}
+
+bool NimBLEUUID::equals(const NimBLEUUID& uuid) const {
+    return m_value == uuid.m_value;
+}
+
+std::string NimBLEUUID::toString() const {
+    return m_value;
+}
+
+uint8_t NimBLEUUID::bitSize() const {
+    return m_value.length() <= 4 ? 16 : 128;
+}
+
+const ble_uuid_any_t* NimBLEUUID::getNative() const {
+    return &m_native;
+}
+
+int ble_uuid_cmp(const ble_uuid_t* uuid1, const ble_uuid_t* uuid2) {
+    return strcmp(uuid1->str, uuid2->str);
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLEAddress                                                            */
+/* ------------------------------------------------------------------------ */
+
+NimBLEAddress::NimBLEAddress() : m_addrType(BLE_ADDR_PUBLIC) {
+    memset(m_address, 0, sizeof(m_address));
+}
+
+NimBLEAddress::NimBLEAddress(const uint8_t address[6], uint8_t type) : m_addrType(type) {
+    std::reverse_copy(address, address + sizeof(m_address), m_address);
+}
+
+NimBLEAddress::NimBLEAddress(const std::string& stringAddress, uint8_t type) : m_addrType(type) {
+    memset(m_address, 0, sizeof(m_address));
+    if (stringAddress.length() != 17) return;
+
+    unsigned int b[6];
+    if (sscanf(stringAddress.c_str(), "%02x:%02x:%02x:%02x:%02x:%02x",
+               &b[5], &b[4], &b[3], &b[2], &b[1], &b[0]) != 6) return;
+    for (int i = 0; i < 6; i++) m_address[i] = b[i];
+}
+
+NimBLEAddress::NimBLEAddress(const uint64_t& address, uint8_t type) : m_addrType(type) {
+    memcpy(m_address, &address, sizeof(m_address));
+}
+
+bool NimBLEAddress::equals(const NimBLEAddress& otherAddress) const {
+    return memcmp(m_address, otherAddress.m_address, sizeof(m_address)) == 0;
+}
+
+const uint8_t* NimBLEAddress::getNative() const {
+    return m_address;
+}
+
+std::string NimBLEAddress::toString() const {
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+             m_address[5], m_address[4], m_address[3], m_address[2], m_address[1], m_address[0]);
+    return buf;
+}
+
+uint8_t NimBLEAddress::getType() const {
+    return m_addrType;
+}
+
+NimBLEAddress::operator uint64_t() const {
+    uint64_t address = 0;
+    memcpy(&address, m_address, sizeof(m_address));
+    return address;
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLEAdvertisedDevice / NimBLEScan                                      */
+/* ------------------------------------------------------------------------ */
+
+NimBLEAdvertisedDevice::NimBLEAdvertisedDevice() : m_rssi(-127) {}
+
+NimBLEAddress NimBLEAdvertisedDevice::getAddress() { return m_address; }
+uint8_t       NimBLEAdvertisedDevice::getAddressType() { return m_address.getType(); }
+int           NimBLEAdvertisedDevice::getRSSI() { return m_rssi; }
+uint8_t*      NimBLEAdvertisedDevice::getPayload() { return m_payload.data(); }
+size_t        NimBLEAdvertisedDevice::getPayloadLength() { return m_payload.size(); }
+bool          NimBLEAdvertisedDevice::haveName() { return findAdvField(0x09) > 0; }
+bool          NimBLEAdvertisedDevice::haveManufacturerData() { return findAdvField(0xff) > 0; }
+
+void NimBLEAdvertisedDevice::setAdvertisement(const NimBLEAddress& address, const uint8_t* payload, size_t len, int rssi) {
+    m_address = address;
+    m_payload.assign(payload, payload + len);
+    m_rssi = rssi;
+}
+
+size_t NimBLEAdvertisedDevice::findAdvField(uint8_t type, uint8_t index, size_t* data_loc) {
+    size_t length = m_payload.size();
+    size_t pos = 0;
+
+    while (pos + 1 < length) {
+        uint8_t len = m_payload[pos];
+        if (len == 0 || pos + 1 + len > length) break;
+        if (m_payload[pos + 1] == type) {
+            if (index == 0) {
+                if (data_loc != nullptr) *data_loc = pos;
+                return len;
+            }
+            index--;
+        }
+        pos += len + 1;
+    }
+    return 0;
+}
+
+std::string NimBLEAdvertisedDevice::getName() {
+    size_t loc = 0;
+    size_t len = findAdvField(0x09, 0, &loc);
+    if (len < 1) return "";
+    return std::string((char*) m_payload.data() + loc + 2, len - 1);
+}
+
+std::string NimBLEAdvertisedDevice::getManufacturerData(uint8_t index) {
+    size_t loc = 0;
+    size_t len = findAdvField(0xff, index, &loc);
+    if (len < 1) return "";
+    return std::string((char*) m_payload.data() + loc + 2, len - 1);
+}
+
+int NimBLEScanResults::getCount() {
+    return m_advertisedDevicesVector.size();
+}
+
+NimBLEAdvertisedDevice NimBLEScanResults::getDevice(uint32_t i) {
+    return *m_advertisedDevicesVector[i];
+}
+
+std::vector<NimBLEAdvertisedDevice*>::iterator NimBLEScanResults::begin() {
+    return m_advertisedDevicesVector.begin();
+}
+
+std::vector<NimBLEAdvertisedDevice*>::iterator NimBLEScanResults::end() {
+    return m_advertisedDevicesVector.end();
+}
+
+NimBLEScan::NimBLEScan()
+    : m_scanning(false), m_maxResults(0xff), m_pAdvertisedDeviceCallbacks(nullptr),
+      m_wantDuplicates(false), m_scanCompleteCB(nullptr), m_scanId(0) {}
+
+NimBLEScan::~NimBLEScan() {
+    clearResults();
+}
+
+void NimBLEScan::setActiveScan(bool active) {}
+void NimBLEScan::setInterval(uint16_t intervalMSecs) {}
+void NimBLEScan::setWindow(uint16_t windowMSecs) {}
+void NimBLEScan::setDuplicateFilter(bool enabled) {}
+void NimBLEScan::setMaxResults(uint8_t maxResults) { m_maxResults = maxResults; }
+
+void NimBLEScan::setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks* pAdvertisedDeviceCallbacks,
+                                              bool wantDuplicates) {
+    m_pAdvertisedDeviceCallbacks = pAdvertisedDeviceCallbacks;
+    m_wantDuplicates = wantDuplicates;
+}
+
+bool NimBLEScan::isScanning() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return m_scanning;
+}
+
+bool NimBLEScan::stop() {
+    void (*cb)(NimBLEScanResults);
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        if (!m_scanning) return true;
+        m_scanning = false;
+        m_scanId++;
+        cb = m_scanCompleteCB;
+    }
+    if (cb != nullptr) cb(m_scanResults);
+    return true;
+}
+
+void NimBLEScan::clearResults() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    for (NimBLEAdvertisedDevice* adv : m_scanResults.m_advertisedDevicesVector) delete adv;
+    m_scanResults.m_advertisedDevicesVector.clear();
+}
+
+NimBLEScanResults NimBLEScan::getResults() {
+    return m_scanResults;
+}
+
+NimBLEScanResults NimBLEScan::start(uint32_t duration, bool is_continue) {
+    if (start(duration, nullptr, is_continue)) {
+        while (isScanning()) NimBLESim::sleepUntil(NimBLESim::nowUs() + 1000);
+    }
+    return m_scanResults;
+}
+
+bool NimBLEScan::start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResults), bool is_continue) {
+    static uint32_t seed = 1;
+    uint32_t id;
+
+    if (!is_continue) clearResults();
+
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        m_scanning = true;
+        m_scanCompleteCB = scanCompleteCB;
+        id = ++m_scanId;
+
+        // Peripherals advertise periodically, first advertisement at random offset
+        for (NimBLESimPeripheral* p : NimBLESim::peripherals()) {
+            seed = seed * 1103515245 + 12345;
+            uint64_t offset = (seed >> 8) % (p->link.advIntervalUs + 1);
+            NimBLEAddress address = p->getAddress();
+            NimBLESim::post(NimBLESim::nowUs() + offset, [this, id, address] { onAdvertisement(id, address); });
+        }
+    }
+
+    if (duration > 0) {
+        NimBLESim::post(NimBLESim::nowUs() + (uint64_t) duration * 1000000, [this, id] {
+            void (*cb)(NimBLEScanResults);
+            {
+                std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+                if (id != m_scanId || !m_scanning) return;
+                m_scanning = false;
+                cb = m_scanCompleteCB;
+            }
+            if (cb != nullptr) cb(m_scanResults);
+        });
+    }
+    return true;
+}
+
+void NimBLEScan::onAdvertisement(uint32_t id, const NimBLEAddress& address) {
+    NimBLEAdvertisedDevice adv;
+    NimBLEAdvertisedDevice* pDevice = &adv;
+    NimBLEAdvertisedDeviceCallbacks* callbacks;
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        if (id != m_scanId || !m_scanning) return;
+
+        NimBLESimPeripheral* p = NimBLESim::find(address);
+        if (p == nullptr) return;
+
+        NimBLESim::post(NimBLESim::nowUs() + p->link.advIntervalUs, [this, id, address] { onAdvertisement(id, address); });
+        if (p->isConnected() || !p->getAdvertisement(&adv)) return;
+
+        callbacks = m_pAdvertisedDeviceCallbacks;
+        bool known = false;
+        for (NimBLEAdvertisedDevice* stored : m_scanResults.m_advertisedDevicesVector) {
+            if (stored->getAddress() == address) {
+                *stored = adv;
+                known = true;
+            }
+        }
+
+        if (known && !m_wantDuplicates) return;
+        if (!known && m_scanResults.m_advertisedDevicesVector.size() < m_maxResults) {
+            pDevice = new NimBLEAdvertisedDevice(adv);
+            m_scanResults.m_advertisedDevicesVector.push_back(pDevice);
+        }
+    }
+
+    if (callbacks != nullptr) callbacks->onResult(pDevice);
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLERemoteCharacteristic                                               */
+/* ------------------------------------------------------------------------ */
+
+NimBLERemoteCharacteristic::NimBLERemoteCharacteristic(NimBLERemoteService* pRemoteService, const NimBLEUUID& uuid,
+                                                       uint16_t handle, uint8_t properties)
+    : m_pRemoteService(pRemoteService), m_uuid(uuid), m_handle(handle),
+      m_properties(properties), m_haveCccd(false) {}
+
+NimBLERemoteCharacteristic::~NimBLERemoteCharacteristic() {}
+
+bool NimBLERemoteCharacteristic::canRead() { return m_properties & BLE_GATT_CHR_PROP_READ; }
+bool NimBLERemoteCharacteristic::canWrite() { return m_properties & BLE_GATT_CHR_PROP_WRITE; }
+bool NimBLERemoteCharacteristic::canWriteNoResponse() { return m_properties & BLE_GATT_CHR_PROP_WRITE_NO_RSP; }
+bool NimBLERemoteCharacteristic::canNotify() { return m_properties & BLE_GATT_CHR_PROP_NOTIFY; }
+bool NimBLERemoteCharacteristic::canIndicate() { return m_properties & BLE_GATT_CHR_PROP_INDICATE; }
+uint16_t NimBLERemoteCharacteristic::getHandle() { return m_handle; }
+NimBLEUUID NimBLERemoteCharacteristic::getUUID() { return m_uuid; }
+NimBLERemoteService* NimBLERemoteCharacteristic::getRemoteService() { return m_pRemoteService; }
+
+std::string NimBLERemoteCharacteristic::getValue(time_t* timestamp) {
+    return m_value;
+}
+
+std::string NimBLERemoteCharacteristic::readValue(time_t* timestamp) {
+    NimBLEClient* pClient = m_pRemoteService->getClient();
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    uint8_t value[SIM_MAX_ATTR_LEN];
+    uint16_t len = sizeof(value);
+
+    if (!pClient->isConnected()) return "";
+
+    const NimBLESimPeripheral::Characteristic* chr = p->findCharacteristic(m_handle);
+    if (chr == nullptr) return "";
+
+    // NimBLE retries once after securing the link on insufficient authentication
+    if (chr->secure && !pClient->m_encrypted && !pClient->secureConnection()) return "";
+
+    int rc = p->onRead(m_handle, value, &len);
+    // Long read: first response carries MTU-1 bytes, each blob read the next MTU-1
+    if (!p->roundTrip(len / (pClient->m_mtu - 1) + 1)) return "";
+    p->stats.reads++;
+    p->stats.bytesRead += len;
+
+    if (p->link.readErrorEvery && p->stats.reads % p->link.readErrorEvery == 0) {
+        p->stats.readErrors++;
+        rc = 0x0e; // BLE_ATT_ERR_UNLIKELY
+    }
+
+    if (rc != 0) {
+        pClient->m_lastErr = rc;
+        return "";
+    }
+
+    m_value.assign((char*) value, len);
+    return m_value;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Low level GATT client                                                    */
+/* ------------------------------------------------------------------------ */
+
+int os_mbuf_copydata(const struct os_mbuf* om, int off, int len, void* dst) {
+    if (off < 0 || len < 0 || off + len > om->om_len) return -1;
+    memcpy(dst, om->om_data + off, len);
+    return 0;
+}
+
+static NimBLEClient* findClient(uint16_t connHandle);
+
+// Run fn in host task at given time with client of connection. Client is
+// nullptr if link went down meanwhile, or was lost during the procedure.
+static void completeAt(uint64_t atUs, uint16_t connHandle, bool lost, std::function<void(NimBLEClient*)> fn) {
+    NimBLESim::post(atUs, [connHandle, lost, fn] {
+        NimBLEClient* c = findClient(connHandle);
+        if (c != nullptr && lost) {
+            NimBLESimPeripheral* p = NimBLESim::find(c->getPeerAddress());
+            if (p != nullptr) p->stats.linkLosses++;
+            c->disconnect();
+            c = nullptr;
+        }
+        fn(c);
+    });
+}
+
+// Same procedure as readValue(), but value fragments are passed to callback
+// (read response, then blob responses) and no copy is kept. Unlike
+// readValue(), link is not secured automatically. Returns at once,
+// callback runs in host task when responses arrive.
+int ble_gattc_read_long(uint16_t conn_handle, uint16_t handle, uint16_t offset,
+                        ble_gatt_attr_fn* cb, void* cb_arg) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    const NimBLESimPeripheral::Characteristic* chr = p->findCharacteristic(handle);
+    std::shared_ptr<std::vector<uint8_t>> value = std::make_shared<std::vector<uint8_t>>(SIM_MAX_ATTR_LEN);
+    uint16_t len = SIM_MAX_ATTR_LEN;
+    uint16_t frag = pClient->m_mtu - 1;
+    int rc = 0;
+    bool lost;
+    uint64_t at;
+
+    if (chr == nullptr) {
+        rc = BLE_ATT_ERR_INVALID_HANDLE;
+    } else if (chr->secure && !pClient->m_encrypted) {
+        rc = BLE_ATT_ERR_INSUFFICIENT_AUTHEN;
+    } else {
+        rc = p->onRead(handle, value->data(), &len);
+    }
+
+    if (rc != 0) {
+        at = p->reserveRoundTrip(1, &lost);
+    } else {
+        if (offset > len) offset = len;
+        at = p->reserveRoundTrip((len - offset) / frag + 1, &lost);
+    }
+
+    completeAt(at, conn_handle, lost, [=](NimBLEClient* c) {
+        ble_gatt_error error = { 0, handle };
+        uint16_t pos = offset;
+
+        if (c == nullptr) {
+            error.status = BLE_HS_ENOTCONN;
+            cb(conn_handle, &error, nullptr, cb_arg);
+            return;
+        }
+
+        NimBLESimPeripheral* p = c->m_pPeripheral;
+        if (rc != 0) {
+            error.status = BLE_HS_ATT_ERR(rc);
+            c->m_lastErr = error.status;
+            cb(conn_handle, &error, nullptr, cb_arg);
+            return;
+        }
+
+        p->stats.reads++;
+        p->stats.bytesRead += len - pos;
+
+        if (p->link.readErrorEvery && p->stats.reads % p->link.readErrorEvery == 0) {
+            p->stats.readErrors++;
+            error.status = BLE_HS_ATT_ERR(BLE_ATT_ERR_UNLIKELY);
+            c->m_lastErr = error.status;
+            cb(conn_handle, &error, nullptr, cb_arg);
+            return;
+        }
+
+        // One callback per response, last response is shorter than MTU-1
+        do {
+            uint16_t n = std::min<uint16_t>(frag, len - pos);
+            os_mbuf om = { value->data() + pos, n };
+            ble_gatt_attr attr = { handle, pos, &om };
+            if (cb(conn_handle, &error, &attr, cb_arg) != 0) return;
+            pos += n;
+            if (n < frag) break;
+        } while (true);
+
+        error.status = BLE_HS_EDONE;
+        cb(conn_handle, &error, nullptr, cb_arg);
+    });
+    return 0;
+}
+
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle, const void* data,
+                         uint16_t data_len, ble_gatt_attr_fn* cb, void* cb_arg) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    const NimBLESimPeripheral::Characteristic* chr = p->findCharacteristic(attr_handle);
+    int rc;
+
+    if (chr == nullptr) {
+        rc = BLE_ATT_ERR_INVALID_HANDLE;
+    } else if (chr->secure && !pClient->m_encrypted) {
+        rc = BLE_ATT_ERR_INSUFFICIENT_AUTHEN;
+    } else {
+        rc = p->onWrite(attr_handle, (const uint8_t*) data, data_len);
+    }
+
+    bool lost;
+    uint64_t at = p->reserveRoundTrip(1, &lost);
+
+    completeAt(at, conn_handle, lost, [=](NimBLEClient* c) {
+        ble_gatt_error error = { 0, attr_handle };
+        ble_gatt_attr attr = { attr_handle, 0, nullptr };
+
+        if (c == nullptr) {
+            error.status = BLE_HS_ENOTCONN;
+        } else {
+            c->m_pPeripheral->stats.writes++;
+            error.status = BLE_HS_ATT_ERR(rc);
+            c->m_lastErr = error.status;
+        }
+        if (cb != nullptr) cb(conn_handle, &error, &attr, cb_arg);
+    });
+    return 0;
+}
+
+// Queued for next connection event, no response. Peer ignores write that
+// needs encryption on unencrypted link.
+int ble_gattc_write_no_rsp_flat(uint16_t conn_handle, uint16_t attr_handle, const void* data,
+                                uint16_t data_len) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+    if (data_len > pClient->m_mtu - 3) return BLE_HS_EMSGSIZE;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    const NimBLESimPeripheral::Characteristic* chr = p->findCharacteristic(attr_handle);
+    if (p->writeNoRspArrives() && chr != nullptr && (!chr->secure || pClient->m_encrypted)) {
+        p->onWrite(attr_handle, (const uint8_t*) data, data_len);
+    }
+    return 0;
+}
+
+int ble_gattc_exchange_mtu(uint16_t conn_handle, ble_gatt_mtu_fn* cb, void* cb_arg) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+
+    bool lost;
+    uint64_t at = pClient->m_pPeripheral->reserveRoundTrip(1, &lost);
+
+    completeAt(at, conn_handle, lost, [=](NimBLEClient* c) {
+        ble_gatt_error error = { 0, 0 };
+        uint16_t mtu = 0;
+
+        if (c == nullptr) {
+            error.status = BLE_HS_ENOTCONN;
+        } else {
+            c->m_mtu = std::min(NimBLEDevice::getMTU(), c->m_pPeripheral->link.mtu);
+            mtu = c->m_mtu;
+        }
+        if (cb != nullptr) cb(conn_handle, &error, mtu, cb_arg);
+    });
+    return 0;
+}
+
+// Read By Type responses carry as many declarations as fit in MTU
+int ble_gattc_disc_all_chrs(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle,
+                            ble_gatt_chr_fn* cb, void* cb_arg) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    std::vector<ble_gatt_chr> found;
+    for (const NimBLESimPeripheral::Service& svc : p->services) {
+        for (const NimBLESimPeripheral::Characteristic& c : svc.characteristics) {
+            if (c.handle < start_handle || c.handle > end_handle) continue;
+            ble_gatt_chr chr = {};
+            chr.def_handle = c.handle - 1;
+            chr.val_handle = c.handle;
+            chr.properties = c.properties;
+            chr.uuid = *c.uuid.getNative();
+            found.push_back(chr);
+        }
+    }
+
+    uint32_t perResponse = std::max(1, (pClient->m_mtu - 2) / 21);  // 128-bit declarations
+    uint32_t responses = found.size() / perResponse + 1;
+    bool lost;
+    uint64_t at = p->reserveRoundTrip(responses, &lost);
+
+    completeAt(at, conn_handle, lost, [=](NimBLEClient* c) {
+        ble_gatt_error error = { 0, 0 };
+
+        if (c == nullptr) {
+            error.status = BLE_HS_ENOTCONN;
+            cb(conn_handle, &error, nullptr, cb_arg);
+            return;
+        }
+
+        c->m_pPeripheral->stats.discoveries += responses;
+        for (const ble_gatt_chr& chr : found) {
+            if (cb(conn_handle, &error, &chr, cb_arg) != 0) return;
+        }
+
+        error.status = BLE_HS_EDONE;
+        cb(conn_handle, &error, nullptr, cb_arg);
+    });
+    return 0;
+}
+
+bool NimBLERemoteCharacteristic::writeValue(const uint8_t* data, size_t length, bool response) {
+    NimBLEClient* pClient = m_pRemoteService->getClient();
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+
+    if (!pClient->isConnected()) return false;
+
+    const NimBLESimPeripheral::Characteristic* chr = p->findCharacteristic(m_handle);
+    if (chr == nullptr) return false;
+    if (!response && length > (size_t) pClient->m_mtu - 3) return false;
+    if (chr->secure && !pClient->m_encrypted && !pClient->secureConnection()) return false;
+
+    int rc = 0;
+    if (response) {
+        rc = p->onWrite(m_handle, data, length);
+        if (!p->roundTrip()) return false;
+        p->stats.writes++;
+    } else if (p->writeNoRspArrives()) {
+        rc = p->onWrite(m_handle, data, length);
+    }
+
+    pClient->m_lastErr = rc;
+    return rc == 0;
+}
+
+bool NimBLERemoteCharacteristic::writeValue(const std::string& newValue, bool response) {
+    return writeValue((const uint8_t*) newValue.data(), newValue.length(), response);
+}
+
+bool NimBLERemoteCharacteristic::setNotify(uint16_t val, notify_callback notifyCallback, bool response) {
+    NimBLEClient* pClient = m_pRemoteService->getClient();
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+
+    if (!pClient->isConnected()) return false;
+
+    const NimBLESimPeripheral::Characteristic* chr = p->findCharacteristic(m_handle);
+    if (chr == nullptr) return false;
+
+    // Client Characteristic Configuration descriptor is discovered on first use
+    if (!m_haveCccd) {
+        if (!p->roundTrip()) return false;
+        p->stats.discoveries++;
+        m_haveCccd = true;
+    }
+
+    if (chr->secure && !pClient->m_encrypted && !pClient->secureConnection()) return false;
+
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        m_notifyCallback = val ? notifyCallback : nullptr;
+    }
+
+    if (response) {
+        if (!p->roundTrip()) return false;
+        p->stats.writes++;
+    } else {
+        p->stats.writesNoRsp++;
+    }
+
+    p->onSubscribe(m_handle, val != 0);
+    return true;
+}
+
+bool NimBLERemoteCharacteristic::subscribe(bool notifications, notify_callback notifyCallback, bool response) {
+    if (notifications) return setNotify(0x01, notifyCallback, response);
+    return setNotify(0x02, notifyCallback, response);
+}
+
+bool NimBLERemoteCharacteristic::unsubscribe(bool response) {
+    return setNotify(0x00, nullptr, response);
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLERemoteService                                                      */
+/* ------------------------------------------------------------------------ */
+
+NimBLERemoteService::NimBLERemoteService(NimBLEClient* pClient, const NimBLEUUID& uuid)
+    : m_pClient(pClient), m_uuid(uuid) {}
+
+NimBLERemoteService::~NimBLERemoteService() {
+    deleteCharacteristics();
+}
+
+void NimBLERemoteService::deleteCharacteristics() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    for (NimBLERemoteCharacteristic* chr : m_characteristicVector) delete chr;
+    m_characteristicVector.clear();
+}
+
+NimBLEClient* NimBLERemoteService::getClient() { return m_pClient; }
+NimBLEUUID NimBLERemoteService::getUUID() { return m_uuid; }
+
+NimBLERemoteCharacteristic* NimBLERemoteService::getCharacteristic(const NimBLEUUID& uuid) {
+    for (NimBLERemoteCharacteristic* chr : m_characteristicVector) {
+        if (chr->getUUID() == uuid) return chr;
+    }
+
+    if (!m_pClient->isConnected()) return nullptr;
+
+    // Not known yet: discover characteristics by UUID
+    NimBLESimPeripheral* p = m_pClient->m_pPeripheral;
+    if (!p->roundTrip()) return nullptr;
+    p->stats.discoveries++;
+
+    const NimBLESimPeripheral::Service* svc = p->findService(m_uuid);
+    if (svc == nullptr) return nullptr;
+
+    for (const NimBLESimPeripheral::Characteristic& c : svc->characteristics) {
+        if (c.uuid == uuid) {
+            std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+            NimBLERemoteCharacteristic* chr = new NimBLERemoteCharacteristic(this, c.uuid, c.handle, c.properties);
+            m_characteristicVector.push_back(chr);
+            return chr;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<NimBLERemoteCharacteristic*>* NimBLERemoteService::getCharacteristics(bool refresh) {
+    if (refresh && m_pClient->isConnected()) {
+        deleteCharacteristics();
+
+        NimBLESimPeripheral* p = m_pClient->m_pPeripheral;
+        const NimBLESimPeripheral::Service* svc = p->findService(m_uuid);
+
+        // Read By Type responses carry as many declarations as fit in MTU,
+        // last request finds nothing more
+        uint32_t perResponse = std::max(1, (m_pClient->m_mtu - 2) / 21);
+        uint32_t responses = (svc != nullptr ? svc->characteristics.size() : 0) / perResponse + 1;
+        if (!p->roundTrip(responses)) return &m_characteristicVector;
+        p->stats.discoveries += responses;
+
+        if (svc != nullptr) {
+            std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+            for (const NimBLESimPeripheral::Characteristic& c : svc->characteristics) {
+                m_characteristicVector.push_back(new NimBLERemoteCharacteristic(this, c.uuid, c.handle, c.properties));
+            }
+        }
+    }
+    return &m_characteristicVector;
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLEClient                                                             */
+/* ------------------------------------------------------------------------ */
+
+void releaseClient(NimBLEClient* pClient, uint16_t connHandle);
+
+// Links in use or being established
+static size_t connectionCount() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    size_t connected = pendingConnects;
+    for (NimBLESimPeripheral* p : NimBLESim::peripherals()) {
+        if (p->isConnected()) connected++;
+    }
+    return connected;
+}
+
+NimBLEClient::NimBLEClient(const NimBLEAddress& peerAddress)
+    : m_peerAddress(peerAddress), m_pPeripheral(nullptr), m_pClientCallbacks(nullptr),
+      m_deleteCallbacks(false), m_encrypted(false), m_connId(0xffff), m_mtu(BLE_ATT_MTU_DFLT),
+      m_connectTimeout(30), m_lastErr(0) {
+    m_pConnParams.itvl_min = 24;            // 30ms
+    m_pConnParams.itvl_max = 40;            // 50ms
+    m_pConnParams.latency = 0;
+    m_pConnParams.supervision_timeout = 400; // 4s
+    m_pConnParams.min_ce_len = 16;
+    m_pConnParams.max_ce_len = 768;
+}
+
+NimBLEClient::~NimBLEClient() {
+    disconnect();
+    deleteServices();
+    if (m_deleteCallbacks) delete m_pClientCallbacks;
+}
+
+bool NimBLEClient::connect(NimBLEAdvertisedDevice* device, bool deleteAttributes) {
+    return connect(device->getAddress(), deleteAttributes);
+}
+
+bool NimBLEClient::connect(bool deleteAttributes) {
+    return connect(m_peerAddress, deleteAttributes);
+}
+
+bool NimBLEClient::connect(const NimBLEAddress& address, bool deleteAttributes) {
+    if (isConnected()) return false;
+
+    if (deleteAttributes || !(address == m_peerAddress)) {
+        deleteServices();
+    }
+    m_peerAddress = address;
+
+    NimBLESimPeripheral* p = NimBLESim::find(address);
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        // Only one connection attempt at a time, as in ble_gap_connect()
+        if (pendingConnects > 0) {
+            m_lastErr = BLE_HS_EALREADY;
+            return false;
+        }
+        if (connectionCount() >= CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+            m_lastErr = BLE_HS_ENOMEM;
+            return false;
+        }
+        pendingConnects++;
+    }
+
+    if (p == nullptr || p->isConnected()) {
+        // Nothing answers: wait for connection timeout
+        NimBLESim::sleepUntil(NimBLESim::nowUs() + (uint64_t) m_connectTimeout * 1000000);
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        pendingConnects--;
+        m_lastErr = BLE_HS_ETIMEOUT;
+        return false;
+    }
+
+    p->wait(p->link.connectUs);
+
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        pendingConnects--;
+        p->client = this;
+        p->linkId = nextLinkId++;
+        p->stats.connects++;
+        p->startLink();
+        m_pPeripheral = p;
+        m_encrypted = false;
+        m_connId = nextConnId++;
+        m_mtu = BLE_ATT_MTU_DFLT;
+    }
+
+    // MTU exchange
+    if (!p->roundTrip()) return false;
+    m_mtu = std::min(NimBLEDevice::getMTU(), p->link.mtu);
+
+    p->onConnect();
+    if (m_pClientCallbacks != nullptr) m_pClientCallbacks->onConnect(this);
+    return true;
+}
+
+int NimBLEClient::disconnect(uint8_t reason) {
+    NimBLESimPeripheral* p;
+    uint16_t connId;
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        p = m_pPeripheral;
+        if (p == nullptr) return 0;
+        connId = m_connId;
+        p->countEvents();
+        p->client = nullptr;
+        p->linkId = 0;
+        m_pPeripheral = nullptr;
+        m_encrypted = false;
+        m_connId = 0xffff;
+
+        for (NimBLERemoteService* svc : m_servicesVector) {
+            for (NimBLERemoteCharacteristic* chr : svc->m_characteristicVector) {
+                chr->m_notifyCallback = nullptr;
+            }
+        }
+    }
+
+    p->onDisconnect();
+    if (m_pClientCallbacks != nullptr) m_pClientCallbacks->onDisconnect(this);
+    if (m_gapCb != nullptr) releaseClient(this, connId);
+    return 0;
+}
+
+void NimBLEClient::gapEvent(struct ble_gap_event* event) {
+    if (m_gapCb != nullptr) m_gapCb(event, m_gapArg);
+}
+
+NimBLEAddress NimBLEClient::getPeerAddress() { return m_peerAddress; }
+void NimBLEClient::setPeerAddress(const NimBLEAddress& address) { m_peerAddress = address; }
+int NimBLEClient::getRssi() { return isConnected() ? -60 : 0; }
+uint16_t NimBLEClient::getConnId() { return m_connId; }
+uint16_t NimBLEClient::getMTU() { return m_mtu; }
+int NimBLEClient::getLastError() { return m_lastErr; }
+void NimBLEClient::setConnectTimeout(uint8_t timeout) { m_connectTimeout = timeout; }
+
+bool NimBLEClient::isConnected() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return m_pPeripheral != nullptr;
+}
+
+void NimBLEClient::setClientCallbacks(NimBLEClientCallbacks* pClientCallbacks, bool deleteCallbacks) {
+    m_pClientCallbacks = pClientCallbacks;
+    m_deleteCallbacks = deleteCallbacks;
+}
+
+void NimBLEClient::deleteServices() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    for (NimBLERemoteService* svc : m_servicesVector) delete svc;
+    m_servicesVector.clear();
+}
+
+NimBLERemoteService* NimBLEClient::getService(const NimBLEUUID& uuid) {
+    for (NimBLERemoteService* svc : m_servicesVector) {
+        if (svc->getUUID() == uuid) return svc;
+    }
+
+    if (!isConnected()) return nullptr;
+
+    // Not known yet: discover service by UUID
+    NimBLESimPeripheral* p = m_pPeripheral;
+    if (!p->roundTrip()) return nullptr;
+    p->stats.discoveries++;
+
+    if (p->findService(uuid) == nullptr) return nullptr;
+
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    NimBLERemoteService* svc = new NimBLERemoteService(this, uuid);
+    m_servicesVector.push_back(svc);
+    return svc;
+}
+
+std::vector<NimBLERemoteService*>* NimBLEClient::getServices(bool refresh) {
+    if (refresh && isConnected()) {
+        deleteServices();
+
+        if (!m_pPeripheral->roundTrip()) return &m_servicesVector;
+        m_pPeripheral->stats.discoveries++;
+
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        for (const NimBLESimPeripheral::Service& s : m_pPeripheral->services) {
+            m_servicesVector.push_back(new NimBLERemoteService(this, s.uuid));
+        }
+    }
+    return &m_servicesVector;
+}
+
+bool NimBLEClient::discoverAttributes() {
+    for (NimBLERemoteService* svc : *getServices(true)) {
+        svc->getCharacteristics(true);
+    }
+    return isConnected();
+}
+
+bool NimBLEClient::secureConnection() {
+    NimBLESimPeripheral* p = m_pPeripheral;
+    if (p == nullptr) return false;
+    if (m_encrypted) return true;
+
+    bool bonded = NimBLEDevice::isBonded(m_peerAddress);
+    if (bonded) {
+        p->wait(p->link.encryptUs);
+        p->stats.encryptions++;
+    } else {
+        uint32_t pin = m_pClientCallbacks != nullptr ? m_pClientCallbacks->onPassKeyRequest() : 0;
+        p->wait(p->link.pairUs);
+        p->stats.pairings++;
+        if (pin != p->passkey) {
+            m_lastErr = 0x504; // BLE_HS_SM_US_ERR(BLE_SM_ERR_PASSKEY)
+            return false;
+        }
+        NimBLEDevice::addBond(m_peerAddress);
+    }
+
+    m_encrypted = true;
+
+    if (m_pClientCallbacks != nullptr) {
+        ble_gap_conn_desc desc = {};
+        desc.conn_handle = m_connId;
+        desc.conn_itvl = p->getConnInterval() / 1250;
+        desc.sec_state.encrypted = 1;
+        desc.sec_state.authenticated = 1;
+        desc.sec_state.bonded = 1;
+        desc.sec_state.key_size = 16;
+        m_pClientCallbacks->onAuthenticationComplete(&desc);
+    }
+    return true;
+}
+
+void NimBLEClient::setConnectionParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency,
+                                       uint16_t timeout, uint16_t scanInterval, uint16_t scanWindow) {
+    m_pConnParams.itvl_min = minInterval;
+    m_pConnParams.itvl_max = maxInterval;
+    m_pConnParams.latency = latency;
+    m_pConnParams.supervision_timeout = timeout;
+}
+
+// Like NimBLE-Arduino, result of ble_gap_update_params() is only logged
+void NimBLEClient::updateConnParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout) {
+    ble_gap_upd_params params = {};
+    params.itvl_min = minInterval;
+    params.itvl_max = maxInterval;
+    params.latency = latency;
+    params.supervision_timeout = timeout;
+    ble_gap_update_params(m_connId, &params);
+}
+
+/* ------------------------------------------------------------------------ */
+/* NimBLEDevice                                                             */
+/* ------------------------------------------------------------------------ */
+
+namespace {
+    bool                       initialized = false;
+    uint16_t                   preferredMtu = 255;
+    std::vector<NimBLEClient*> clients;
+    std::vector<NimBLEAddress> bonds;
+    NimBLEScan*                scan = nullptr;
+}
+
+void NimBLEDevice::init(const std::string& deviceName) { initialized = true; }
+void NimBLEDevice::deinit(bool clearAll) { initialized = false; }
+bool NimBLEDevice::getInitialized() { return initialized; }
+void NimBLEDevice::setPower(esp_power_level_t powerLevel, esp_ble_power_type_t powerType) {}
+void NimBLEDevice::setSecurityAuth(bool bonding, bool mitm, bool sc) {}
+void NimBLEDevice::setSecurityIOCap(uint8_t iocap) {}
+uint16_t NimBLEDevice::getMTU() { return preferredMtu; }
+size_t NimBLEDevice::getClientListSize() { return clients.size(); }
+
+static NimBLEClient* findClient(uint16_t connHandle) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    for (NimBLEClient* c : clients) {
+        if (c->isConnected() && c->getConnId() == connHandle) return c;
+    }
+    return nullptr;
+}
+
+int NimBLEDevice::setMTU(uint16_t mtu) {
+    if (mtu < BLE_ATT_MTU_DFLT || mtu > BLE_ATT_MTU_MAX) return 3; // BLE_HS_EINVAL
+    preferredMtu = mtu;
+    return 0;
+}
+
+NimBLEScan* NimBLEDevice::getScan() {
+    if (scan == nullptr) scan = new NimBLEScan();
+    return scan;
+}
+
+NimBLEClient* NimBLEDevice::createClient(NimBLEAddress peerAddress) {
+    NimBLEClient* pClient = new NimBLEClient(peerAddress);
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    clients.push_back(pClient);
+    return pClient;
+}
+
+bool NimBLEDevice::deleteClient(NimBLEClient* pClient) {
+    if (pClient == nullptr) return false;
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        clients.erase(std::remove(clients.begin(), clients.end(), pClient), clients.end());
+    }
+    delete pClient;
+    return true;
+}
+
+bool NimBLEDevice::isBonded(const NimBLEAddress& address) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return std::find(bonds.begin(), bonds.end(), address) != bonds.end();
+}
+
+bool NimBLEDevice::deleteBond(const NimBLEAddress& address) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    auto it = std::find(bonds.begin(), bonds.end(), address);
+    if (it == bonds.end()) return false;
+    bonds.erase(it);
+    return true;
+}
+
+int NimBLEDevice::getNumBonds() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    return bonds.size();
+}
+
+void NimBLEDevice::deleteAllBonds() {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    bonds.clear();
+}
+
+void NimBLEDevice::addBond(const NimBLEAddress& address) {
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    if (std::find(bonds.begin(), bonds.end(), address) == bonds.end()) bonds.push_back(address);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Low level GAP                                                            */
+/* ------------------------------------------------------------------------ */
+
+// ble_gap_connect() links are kept in hidden NimBLEClient objects, so
+// GATT procedures find them by connection handle like any other link.
+// After disconnect, event is sent from host task and object is freed.
+void releaseClient(NimBLEClient* pClient, uint16_t connHandle) {
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        clients.erase(std::remove(clients.begin(), clients.end(), pClient), clients.end());
+    }
+
+    NimBLESim::post(NimBLESim::nowUs(), [pClient, connHandle] {
+        ble_gap_event event = {};
+        event.type = BLE_GAP_EVENT_DISCONNECT;
+        event.disconnect.reason = BLE_ERR_REM_USER_CONN_TERM;
+        event.disconnect.conn.conn_handle = connHandle;
+        pClient->gapEvent(&event);
+        delete pClient;
+    });
+}
+
+int ble_gap_connect(uint8_t own_addr_type, const ble_addr_t* peer_addr, int32_t duration_ms,
+                    const struct ble_gap_conn_params* params, ble_gap_event_fn* cb, void* cb_arg) {
+    HostAllocPause pause;
+    uint64_t native = 0;
+    memcpy(&native, peer_addr->val, 6);
+    NimBLEAddress address(native, peer_addr->type);
+
+    {
+        std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+        if (pendingConnects > 0) return BLE_HS_EALREADY;
+        if (connectionCount() >= CONFIG_BT_NIMBLE_MAX_CONNECTIONS) return BLE_HS_ENOMEM;
+        pendingConnects++;
+    }
+
+    NimBLEClient* pClient = new NimBLEClient(address);
+    pClient->m_gapCb = cb;
+    pClient->m_gapArg = cb_arg;
+
+    NimBLESimPeripheral* p = NimBLESim::find(address);
+    uint64_t at;
+
+    // Nothing answers: connect event with timeout after duration
+    if (p == nullptr || p->isConnected()) at = NimBLESim::nowUs() + (uint64_t) duration_ms * 1000;
+    else at = p->reserve(p->link.connectUs);
+
+    NimBLESim::post(at, [pClient, address] {
+        ble_gap_event event = {};
+        event.type = BLE_GAP_EVENT_CONNECT;
+
+        NimBLESimPeripheral* p;
+        {
+            std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+            pendingConnects--;
+            p = NimBLESim::find(address);
+            if (p != nullptr && !p->isConnected()) {
+                p->client = pClient;
+                p->linkId = nextLinkId++;
+                p->stats.connects++;
+                p->startLink();
+                pClient->m_pPeripheral = p;
+                pClient->m_encrypted = false;
+                pClient->m_connId = nextConnId++;
+                pClient->m_mtu = BLE_ATT_MTU_DFLT;
+                clients.push_back(pClient);
+            } else {
+                p = nullptr;
+            }
+        }
+
+        if (p == nullptr) {
+            event.connect.status = BLE_HS_ETIMEOUT;
+            pClient->gapEvent(&event);
+            delete pClient;
+            return;
+        }
+
+        p->onConnect();
+        event.connect.status = 0;
+        event.connect.conn_handle = pClient->getConnId();
+        pClient->gapEvent(&event);
+    });
+    return 0;
+}
+
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+    pClient->disconnect(hci_reason);
+    return 0;
+}
+
+void encryptionDone(uint16_t connHandle, uint64_t atUs, bool pairing, uint32_t pin) {
+    NimBLESim::post(atUs, [connHandle, pairing, pin] {
+        NimBLEClient* c = findClient(connHandle);
+        if (c == nullptr) return;  // disconnect event was sent
+
+        NimBLESimPeripheral* p = NimBLESim::find(c->getPeerAddress());
+        ble_gap_event event = {};
+        event.type = BLE_GAP_EVENT_ENC_CHANGE;
+        event.enc_change.conn_handle = connHandle;
+
+        if (pairing) {
+            p->stats.pairings++;
+            if (pin != p->passkey) {
+                event.enc_change.status = BLE_HS_SM_US_ERR(BLE_SM_ERR_PASSKEY);
+                c->gapEvent(&event);
+                return;
+            }
+            NimBLEDevice::addBond(c->getPeerAddress());
+        } else {
+            p->stats.encryptions++;
+        }
+
+        c->m_encrypted = true;
+        c->gapEvent(&event);
+    });
+}
+
+int ble_gap_security_initiate(uint16_t conn_handle) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    if (NimBLEDevice::isBonded(pClient->getPeerAddress())) {
+        encryptionDone(conn_handle, p->reserve(p->link.encryptUs), false, 0);
+        return 0;
+    }
+
+    // Keyboard only: host asks for passkey, see ble_sm_inject_io()
+    NimBLESim::post(NimBLESim::nowUs(), [conn_handle] {
+        NimBLEClient* c = findClient(conn_handle);
+        if (c == nullptr) return;
+        ble_gap_event event = {};
+        event.type = BLE_GAP_EVENT_PASSKEY_ACTION;
+        event.passkey.conn_handle = conn_handle;
+        event.passkey.params.action = BLE_SM_IOACT_INPUT;
+        c->gapEvent(&event);
+    });
+    return 0;
+}
+
+// Central starts link layer update, it takes effect at instant 6 connection
+// events later. Only one update at a time, as in NimBLE. Interval below
+// peripheral minimum is raised to it, as peripheral would ask for with its
+// own update request.
+int ble_gap_update_params(uint16_t conn_handle, const ble_gap_upd_params* params) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+    if (params->itvl_min > params->itvl_max) return BLE_HS_EINVAL;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    std::lock_guard<std::recursive_mutex> lk(NimBLESim::lock());
+    if (p->paramsPending) return BLE_HS_EALREADY;
+    p->paramsPending = true;
+
+    uint32_t us = std::max<uint32_t>(params->itvl_min * 1250, p->link.minIntervalUs);
+    uint16_t latency = params->latency;
+    p->post(6 * p->getConnInterval(), [p, us, latency] { p->setConnParams(us, latency); });
+    return 0;
+}
+
+int ble_sm_inject_io(uint16_t conn_handle, struct ble_sm_io* pkey) {
+    HostAllocPause pause;
+    NimBLEClient* pClient = findClient(conn_handle);
+    if (pClient == nullptr) return BLE_HS_ENOTCONN;
+
+    NimBLESimPeripheral* p = pClient->m_pPeripheral;
+    encryptionDone(conn_handle, p->reserve(p->link.pairUs), true, pkey->passkey);
+    return 0;
+}
@@ -0,0 +1,520 @@
+/*
+ *  Name:       NimBLEDevice.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Host stand-in for the subset of NimBLE-Arduino 1.4 used by this library.
+ *  Instead of a radio, clients talk to NimBLESimPeripheral instances
+ *  (see NimBLESim.h), with link timing taken from the peripheral.
+ */
+
+#ifndef __HOST_NIMBLEDEVICE_H
+#define __HOST_NIMBLEDEVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "freertos/FreeRTOS.h"
+
+#ifndef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#define CONFIG_BT_NIMBLE_MAX_CONNECTIONS 3
+#endif
+
+#define BLE_ADDR_PUBLIC     0x00
+#define BLE_ADDR_RANDOM     0x01
+
+#define BLE_HS_IO_DISPLAY_ONLY      0x00
+#define BLE_HS_IO_DISPLAY_YESNO     0x01
+#define BLE_HS_IO_KEYBOARD_ONLY     0x02
+#define BLE_HS_IO_NO_INPUT_OUTPUT   0x03
+#define BLE_HS_IO_KEYBOARD_DISPLAY  0x04
+
+#define BLE_ERR_REM_USER_CONN_TERM  0x13
+
+#define BLE_GATT_CHR_PROP_READ          0x02
+#define BLE_GATT_CHR_PROP_WRITE_NO_RSP  0x04
+#define BLE_GATT_CHR_PROP_WRITE         0x08
+#define BLE_GATT_CHR_PROP_NOTIFY        0x10
+#define BLE_GATT_CHR_PROP_INDICATE      0x20
+
+#define BLE_ATT_MTU_DFLT    23
+#define BLE_ATT_MTU_MAX     527
+#define BLE_ATT_ATTR_MAX_LEN 512
+
+#define BLE_HS_ENOTCONN     7
+#define BLE_HS_EDONE        14
+#define BLE_HS_ERR_ATT_BASE 0x100
+#define BLE_HS_ATT_ERR(x)   ((x) ? BLE_HS_ERR_ATT_BASE + (x) : 0)
+
+#define BLE_ATT_ERR_INVALID_HANDLE      0x01
+#define BLE_ATT_ERR_INSUFFICIENT_AUTHEN 0x05
+#define BLE_ATT_ERR_UNLIKELY            0x0e
+#define BLE_ATT_ERR_INSUFFICIENT_ENC    0x0f
+
+typedef enum {
+    ESP_PWR_LVL_N12 = 0,
+    ESP_PWR_LVL_N9  = 1,
+    ESP_PWR_LVL_N6  = 2,
+    ESP_PWR_LVL_N3  = 3,
+    ESP_PWR_LVL_N0  = 4,
+    ESP_PWR_LVL_P3  = 5,
+    ESP_PWR_LVL_P6  = 6,
+    ESP_PWR_LVL_P9  = 7,
+} esp_power_level_t;
+
+typedef enum {
+    ESP_BLE_PWR_TYPE_DEFAULT = 9,
+} esp_ble_power_type_t;
+
+typedef struct {
+    uint16_t conn_handle;
+    uint16_t conn_itvl;
+    uint16_t conn_latency;
+    uint16_t supervision_timeout;
+    struct {
+        unsigned encrypted     : 1;
+        unsigned authenticated : 1;
+        unsigned bonded        : 1;
+        unsigned key_size      : 5;
+    } sec_state;
+} ble_gap_conn_desc;
+
+typedef struct {
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+    uint16_t min_ce_len;
+    uint16_t max_ce_len;
+} ble_gap_upd_params;
+
+/* Low level host API (host/ble_gatt.h, os/os_mbuf.h), reads land in caller buffer */
+struct os_mbuf {
+    uint8_t* om_data;
+    uint16_t om_len;
+};
+
+#define OS_MBUF_PKTLEN(om) ((om)->om_len)
+
+int os_mbuf_copydata(const struct os_mbuf* om, int off, int len, void* dst);
+
+struct ble_gatt_error {
+    uint16_t status;
+    uint16_t att_handle;
+};
+
+struct ble_gatt_attr {
+    uint16_t        handle;
+    uint16_t        offset;
+    struct os_mbuf* om;
+};
+
+typedef int ble_gatt_attr_fn(uint16_t conn_handle, const struct ble_gatt_error* error,
+                             struct ble_gatt_attr* attr, void* arg);
+
+int ble_gattc_read_long(uint16_t conn_handle, uint16_t handle, uint16_t offset,
+                        ble_gatt_attr_fn* cb, void* cb_arg);
+
+/* UUIDs are kept as text in the stand-in, only compared with ble_uuid_cmp() */
+typedef struct {
+    uint8_t type;
+    char    str[37];
+} ble_uuid_t;
+
+typedef union {
+    ble_uuid_t u;
+} ble_uuid_any_t;
+
+int ble_uuid_cmp(const ble_uuid_t* uuid1, const ble_uuid_t* uuid2);
+
+struct ble_gatt_chr {
+    uint16_t       def_handle;
+    uint16_t       val_handle;
+    uint8_t        properties;
+    ble_uuid_any_t uuid;
+};
+
+typedef int ble_gatt_chr_fn(uint16_t conn_handle, const struct ble_gatt_error* error,
+                            const struct ble_gatt_chr* chr, void* arg);
+typedef int ble_gatt_mtu_fn(uint16_t conn_handle, const struct ble_gatt_error* error,
+                            uint16_t mtu, void* arg);
+
+int ble_gattc_exchange_mtu(uint16_t conn_handle, ble_gatt_mtu_fn* cb, void* cb_arg);
+int ble_gattc_disc_all_chrs(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle,
+                            ble_gatt_chr_fn* cb, void* cb_arg);
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle, const void* data,
+                         uint16_t data_len, ble_gatt_attr_fn* cb, void* cb_arg);
+int ble_gattc_write_no_rsp_flat(uint16_t conn_handle, uint16_t attr_handle, const void* data,
+                                uint16_t data_len);
+
+/* Low level GAP (host/ble_gap.h, host/ble_sm.h). Events are delivered from host task. */
+#define BLE_OWN_ADDR_PUBLIC         0x00
+
+#define BLE_HS_EALREADY             2
+#define BLE_HS_EINVAL               3
+#define BLE_HS_EMSGSIZE             4
+#define BLE_HS_ENOMEM               6
+#define BLE_HS_ETIMEOUT             13
+#define BLE_HS_EBUSY                15
+#define BLE_HS_ERR_SM_US_BASE       0x500
+#define BLE_HS_SM_US_ERR(x)         ((x) ? BLE_HS_ERR_SM_US_BASE + (x) : 0)
+#define BLE_SM_ERR_PASSKEY          0x01
+
+#define BLE_GAP_EVENT_CONNECT        0
+#define BLE_GAP_EVENT_DISCONNECT     1
+#define BLE_GAP_EVENT_ENC_CHANGE     10
+#define BLE_GAP_EVENT_PASSKEY_ACTION 11
+#define BLE_GAP_EVENT_MTU            15
+
+#define BLE_SM_IOACT_INPUT          2
+
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} ble_addr_t;
+
+struct ble_gap_conn_params {
+    uint16_t scan_itvl;
+    uint16_t scan_window;
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+    uint16_t min_ce_len;
+    uint16_t max_ce_len;
+};
+
+struct ble_gap_passkey_params {
+    uint8_t  action;
+    uint32_t numcmp;
+};
+
+struct ble_gap_event {
+    uint8_t type;
+    union {
+        struct {
+            int      status;
+            uint16_t conn_handle;
+        } connect;
+        struct {
+            int               reason;
+            ble_gap_conn_desc conn;
+        } disconnect;
+        struct {
+            int      status;
+            uint16_t conn_handle;
+        } enc_change;
+        struct {
+            uint16_t                      conn_handle;
+            struct ble_gap_passkey_params params;
+        } passkey;
+        struct {
+            uint16_t conn_handle;
+            uint16_t channel_id;
+            uint16_t value;
+        } mtu;
+    };
+};
+
+typedef int ble_gap_event_fn(struct ble_gap_event* event, void* arg);
+
+struct ble_sm_io {
+    uint8_t action;
+    union {
+        uint32_t passkey;
+        uint8_t  numcmp_accept;
+    };
+};
+
+int ble_gap_connect(uint8_t own_addr_type, const ble_addr_t* peer_addr, int32_t duration_ms,
+                    const struct ble_gap_conn_params* params, ble_gap_event_fn* cb, void* cb_arg);
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason);
+int ble_gap_security_initiate(uint16_t conn_handle);
+int ble_gap_update_params(uint16_t conn_handle, const ble_gap_upd_params* params);
+int ble_sm_inject_io(uint16_t conn_handle, struct ble_sm_io* pkey);
+
+class NimBLEClient;
+class NimBLERemoteService;
+class NimBLERemoteCharacteristic;
+class NimBLESimPeripheral;
+
+class NimBLEUUID {
+public:
+    NimBLEUUID() {}
+    NimBLEUUID(const std::string& uuid);
+    NimBLEUUID(const char* uuid);
+    NimBLEUUID(uint16_t uuid);
+
+    bool        equals(const NimBLEUUID& uuid) const;
+    std::string toString() const;
+    uint8_t     bitSize() const;
+    const ble_uuid_any_t* getNative() const;
+
+    bool operator==(const NimBLEUUID& rhs) const { return equals(rhs); }
+    bool operator!=(const NimBLEUUID& rhs) const { return !equals(rhs); }
+private:
+    std::string    m_value;
+    ble_uuid_any_t m_native = {};
+};
+
+class NimBLEAddress {
+public:
+    NimBLEAddress();
+    NimBLEAddress(const uint8_t address[6], uint8_t type = BLE_ADDR_PUBLIC);
+    NimBLEAddress(const std::string& stringAddress, uint8_t type = BLE_ADDR_PUBLIC);
+    NimBLEAddress(const uint64_t& address, uint8_t type = BLE_ADDR_PUBLIC);
+
+    bool           equals(const NimBLEAddress& otherAddress) const;
+    const uint8_t* getNative() const;
+    std::string    toString() const;
+    uint8_t        getType() const;
+
+    bool operator==(const NimBLEAddress& rhs) const { return equals(rhs); }
+    bool operator!=(const NimBLEAddress& rhs) const { return !equals(rhs); }
+    operator std::string() const { return toString(); }
+    operator uint64_t() const;
+private:
+    uint8_t m_address[6];
+    uint8_t m_addrType;
+};
+
+class NimBLEAdvertisedDevice {
+public:
+    NimBLEAdvertisedDevice();
+
+    NimBLEAddress getAddress();
+    uint8_t       getAddressType();
+    std::string   getName();
+    int           getRSSI();
+    std::string   getManufacturerData(uint8_t index = 0);
+    bool          haveName();
+    bool          haveManufacturerData();
+    uint8_t*      getPayload();
+    size_t        getPayloadLength();
+
+    // Host only: fill advertisement as it would be received over the air
+    void          setAdvertisement(const NimBLEAddress& address, const uint8_t* payload, size_t len, int rssi = -60);
+private:
+    size_t        findAdvField(uint8_t type, uint8_t index = 0, size_t* data_loc = nullptr);
+
+    NimBLEAddress        m_address;
+    std::vector<uint8_t> m_payload;
+    int                  m_rssi;
+};
+
+class NimBLEScanResults {
+public:
+    int                    getCount();
+    NimBLEAdvertisedDevice getDevice(uint32_t i);
+    std::vector<NimBLEAdvertisedDevice*>::iterator begin();
+    std::vector<NimBLEAdvertisedDevice*>::iterator end();
+private:
+    friend class NimBLEScan;
+    std::vector<NimBLEAdvertisedDevice*> m_advertisedDevicesVector;
+};
+
+class NimBLEAdvertisedDeviceCallbacks {
+public:
+    virtual ~NimBLEAdvertisedDeviceCallbacks() {}
+    virtual void onResult(NimBLEAdvertisedDevice* advertisedDevice) = 0;
+};
+
+class NimBLEScan {
+public:
+    bool              start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResults), bool is_continue = false);
+    NimBLEScanResults start(uint32_t duration, bool is_continue = false);
+    bool              isScanning();
+    void              setActiveScan(bool active);
+    void              setInterval(uint16_t intervalMSecs);
+    void              setWindow(uint16_t windowMSecs);
+    void              setDuplicateFilter(bool enabled);
+    void              setMaxResults(uint8_t maxResults);
+    void              setAdvertisedDeviceCallbacks(NimBLEAdvertisedDeviceCallbacks* pAdvertisedDeviceCallbacks,
+                                                   bool wantDuplicates = false);
+    bool              stop();
+    void              clearResults();
+    NimBLEScanResults getResults();
+private:
+    friend class NimBLEDevice;
+    NimBLEScan();
+    ~NimBLEScan();
+    void              onAdvertisement(uint32_t id, const NimBLEAddress& address);
+
+    bool                             m_scanning;
+    uint8_t                          m_maxResults;
+    NimBLEScanResults                m_scanResults;
+    NimBLEAdvertisedDeviceCallbacks* m_pAdvertisedDeviceCallbacks;
+    bool                             m_wantDuplicates;
+    void                             (*m_scanCompleteCB)(NimBLEScanResults);
+    uint32_t                         m_scanId;
+};
+
+class NimBLEClientCallbacks {
+public:
+    virtual ~NimBLEClientCallbacks() {};
+    virtual void     onConnect(NimBLEClient* pClient) {};
+    virtual void     onDisconnect(NimBLEClient* pClient) {};
+    virtual bool     onConnParamsUpdateRequest(NimBLEClient* pClient, const ble_gap_upd_params* params) { return true; };
+    virtual uint32_t onPassKeyRequest() { return 123456; };
+    virtual void     onAuthenticationComplete(ble_gap_conn_desc* desc) {};
+    virtual bool     onConfirmPIN(uint32_t pin) { return true; };
+};
+
+class NimBLERemoteCharacteristic {
+public:
+    typedef std::function<void (NimBLERemoteCharacteristic* pBLERemoteCharacteristic,
+                                uint8_t* pData, size_t length, bool isNotify)> notify_callback;
+
+    ~NimBLERemoteCharacteristic();
+
+    bool                 canRead();
+    bool                 canWrite();
+    bool                 canWriteNoResponse();
+    bool                 canNotify();
+    bool                 canIndicate();
+    uint16_t             getHandle();
+    NimBLEUUID           getUUID();
+    NimBLERemoteService* getRemoteService();
+    std::string          readValue(time_t* timestamp = nullptr);
+    std::string          getValue(time_t* timestamp = nullptr);
+    bool                 writeValue(const uint8_t* data, size_t length, bool response = false);
+    bool                 writeValue(const std::string& newValue, bool response = false);
+    bool                 subscribe(bool notifications = true, notify_callback notifyCallback = nullptr, bool response = false);
+    bool                 unsubscribe(bool response = false);
+private:
+    friend class NimBLEClient;
+    friend class NimBLERemoteService;
+    friend class NimBLESimPeripheral;
+    NimBLERemoteCharacteristic(NimBLERemoteService* pRemoteService, const NimBLEUUID& uuid,
+                               uint16_t handle, uint8_t properties);
+    bool                 setNotify(uint16_t val, notify_callback notifyCallback, bool response);
+
+    NimBLERemoteService* m_pRemoteService;
+    NimBLEUUID           m_uuid;
+    uint16_t             m_handle;
+    uint8_t              m_properties;
+    bool                 m_haveCccd;
+    std::string          m_value;
+    notify_callback      m_notifyCallback;
+};
+
+class NimBLERemoteService {
+public:
+    ~NimBLERemoteService();
+
+    NimBLERemoteCharacteristic*                getCharacteristic(const NimBLEUUID& uuid);
+    std::vector<NimBLERemoteCharacteristic*>*  getCharacteristics(bool refresh = false);
+    NimBLEClient*                              getClient();
+    NimBLEUUID                                 getUUID();
+private:
+    friend class NimBLEClient;
+    friend class NimBLESimPeripheral;
+    NimBLERemoteService(NimBLEClient* pClient, const NimBLEUUID& uuid);
+    void                                       deleteCharacteristics();
+
+    NimBLEClient*                              m_pClient;
+    NimBLEUUID                                 m_uuid;
+    std::vector<NimBLERemoteCharacteristic*>   m_characteristicVector;
+};
+
+class NimBLEClient {
+public:
+    bool                                  connect(NimBLEAdvertisedDevice* device, bool deleteAttributes = true);
+    bool                                  connect(const NimBLEAddress& address, bool deleteAttributes = true);
+    bool                                  connect(bool deleteAttributes = true);
+    int                                   disconnect(uint8_t reason = BLE_ERR_REM_USER_CONN_TERM);
+    NimBLEAddress                         getPeerAddress();
+    void                                  setPeerAddress(const NimBLEAddress& address);
+    int                                   getRssi();
+    std::vector<NimBLERemoteService*>*    getServices(bool refresh = false);
+    NimBLERemoteService*                  getService(const NimBLEUUID& uuid);
+    void                                  deleteServices();
+    bool                                  discoverAttributes();
+    bool                                  isConnected();
+    void                                  setClientCallbacks(NimBLEClientCallbacks* pClientCallbacks, bool deleteCallbacks = true);
+    uint16_t                              getConnId();
+    uint16_t                              getMTU();
+    bool                                  secureConnection();
+    void                                  setConnectTimeout(uint8_t timeout);
+    void                                  setConnectionParams(uint16_t minInterval, uint16_t maxInterval,
+                                                              uint16_t latency, uint16_t timeout,
+                                                              uint16_t scanInterval = 16, uint16_t scanWindow = 16);
+    void                                  updateConnParams(uint16_t minInterval, uint16_t maxInterval,
+                                                           uint16_t latency, uint16_t timeout);
+    int                                   getLastError();
+private:
+    friend class NimBLEDevice;
+    friend class NimBLERemoteService;
+    friend class NimBLERemoteCharacteristic;
+    friend class NimBLESimPeripheral;
+    friend int ble_gattc_read_long(uint16_t, uint16_t, uint16_t, ble_gatt_attr_fn*, void*);
+    friend int ble_gattc_exchange_mtu(uint16_t, ble_gatt_mtu_fn*, void*);
+    friend int ble_gattc_disc_all_chrs(uint16_t, uint16_t, uint16_t, ble_gatt_chr_fn*, void*);
+    friend int ble_gattc_write_flat(uint16_t, uint16_t, const void*, uint16_t, ble_gatt_attr_fn*, void*);
+    friend int ble_gattc_write_no_rsp_flat(uint16_t, uint16_t, const void*, uint16_t);
+    friend int ble_gap_connect(uint8_t, const ble_addr_t*, int32_t, const struct ble_gap_conn_params*,
+                               ble_gap_event_fn*, void*);
+    friend int ble_gap_security_initiate(uint16_t);
+    friend int ble_gap_update_params(uint16_t, const ble_gap_upd_params*);
+    friend int ble_sm_inject_io(uint16_t, struct ble_sm_io*);
+    friend void releaseClient(NimBLEClient*, uint16_t);
+    friend void encryptionDone(uint16_t, uint64_t, bool, uint32_t);
+    NimBLEClient(const NimBLEAddress& peerAddress);
+    ~NimBLEClient();
+
+    NimBLEAddress                     m_peerAddress;
+    NimBLESimPeripheral*              m_pPeripheral;
+    NimBLEClientCallbacks*            m_pClientCallbacks;
+    bool                              m_deleteCallbacks;
+    bool                              m_encrypted;
+    uint16_t                          m_connId;
+    uint16_t                          m_mtu;
+    uint8_t                           m_connectTimeout;
+    int                               m_lastErr;
+    ble_gap_upd_params                m_pConnParams;
+    std::vector<NimBLERemoteService*> m_servicesVector;
+    ble_gap_event_fn*                 m_gapCb = nullptr;   // set for ble_gap_connect() links
+    void*                             m_gapArg = nullptr;
+
+    void                              gapEvent(struct ble_gap_event* event);
+};
+
+class NimBLEDevice {
+public:
+    static void          init(const std::string& deviceName);
+    static void          deinit(bool clearAll = false);
+    static bool          getInitialized();
+    static NimBLEScan*   getScan();
+    static NimBLEClient* createClient(NimBLEAddress peerAddress = NimBLEAddress(""));
+    static bool          deleteClient(NimBLEClient* pClient);
+    static size_t        getClientListSize();
+    static void          setPower(esp_power_level_t powerLevel, esp_ble_power_type_t powerType = ESP_BLE_PWR_TYPE_DEFAULT);
+    static void          setSecurityAuth(bool bonding, bool mitm, bool sc);
+    static void          setSecurityIOCap(uint8_t iocap);
+    static int           setMTU(uint16_t mtu);
+    static uint16_t      getMTU();
+    static bool          isBonded(const NimBLEAddress& address);
+    static bool          deleteBond(const NimBLEAddress& address);
+    static int           getNumBonds();
+    static void          deleteAllBonds();
+private:
+    friend class NimBLEClient;
+    friend void encryptionDone(uint16_t, uint64_t, bool, uint32_t);
+    static void          addBond(const NimBLEAddress& address);
+};
+
+#define BLEDevice                  NimBLEDevice
+#define BLEClient                  NimBLEClient
+#define BLERemoteService           NimBLERemoteService
+#define BLERemoteCharacteristic    NimBLERemoteCharacteristic
+#define BLEAdvertisedDevice        NimBLEAdvertisedDevice
+#define BLEAdvertisedDeviceCallbacks NimBLEAdvertisedDeviceCallbacks
+#define BLEScan                    NimBLEScan
+#define BLEUUID                    NimBLEUUID
+#define BLEAddress                 NimBLEAddress
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ *  Name:       NimBLESim.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Simulated BLE link used by the NimBLE stand-in. A peripheral registers
+ *  itself by address, owns a small attribute database and answers reads and
+ *  writes. Every ATT request/response costs link.eventsPerRtt connection
+ *  intervals of wall time, so measured durations follow the same round-trip
+ *  structure as a real radio link.
+ */
+
+#ifndef __HOST_NIMBLESIM_H
+#define __HOST_NIMBLESIM_H
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "NimBLEDevice.h"
+
+#define SIM_MAX_ATTR_LEN 512
+
+// Link timing of simulated peripheral
+struct NimBLESimLink {
+    uint32_t connIntervalUs = 30000;  // connection interval when link is established
+    uint32_t minIntervalUs  = 7500;   // shortest interval peripheral accepts in parameter update
+    uint8_t  eventsPerRtt   = 2;      // connection events per ATT request/response
+    uint16_t mtu            = 247;    // largest ATT MTU peripheral accepts
+    uint32_t connectUs      = 150000; // link establishment
+    uint32_t pairUs         = 900000; // pairing and bonding
+    uint32_t encryptUs      = 120000; // encryption with existing bond
+    uint8_t  notifyPerEvent = 1;      // notifications sent per connection event
+    uint32_t advIntervalUs  = 1000000; // advertising interval
+    uint16_t notifyDropEvery = 0;     // lose every Nth notification, 0 = none
+    uint16_t readErrorEvery = 0;      // fail every Nth read with ATT error, 0 = none
+    uint16_t writeDropEvery = 0;      // lose every Nth write without response, 0 = none
+    uint16_t linkLossEvery = 0;       // drop link on every Nth ATT round trip, 0 = never
+    uint32_t supervisionUs  = 2000000; // time until lost link is reported
+};
+
+// Counters of traffic seen by simulated peripheral
+struct NimBLESimStats {
+    uint32_t connects = 0;
+    uint32_t pairings = 0;
+    uint32_t encryptions = 0;
+    uint32_t discoveries = 0;
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+    uint32_t writesNoRsp = 0;
+    uint32_t writesLost = 0;
+    uint32_t notifications = 0;
+    uint32_t notificationsLost = 0;
+    uint32_t readErrors = 0;
+    uint32_t linkLosses = 0;
+    uint32_t bytesRead = 0;
+    uint32_t bytesNotified = 0;
+    uint32_t connParamUpdates = 0;
+    uint32_t connEvents = 0;          // connection events peripheral was awake for
+};
+
+class NimBLESimPeripheral {
+public:
+    struct Characteristic {
+        NimBLEUUID uuid;
+        uint16_t   handle;
+        uint8_t    properties;
+        bool       secure;      // requires encrypted link
+    };
+
+    struct Service {
+        NimBLEUUID uuid;
+        std::vector<Characteristic> characteristics;
+    };
+
+    NimBLESimPeripheral(const NimBLEAddress& address);
+    virtual ~NimBLESimPeripheral();
+
+    const NimBLEAddress& getAddress() const { return address; }
+
+    NimBLESimLink  link;
+    NimBLESimStats stats;
+    uint32_t       passkey = 123456;
+
+    const Service*        findService(const NimBLEUUID& uuid) const;
+    const Characteristic* findCharacteristic(uint16_t handle) const;
+
+    bool     isConnected();
+    uint16_t getMTU();
+    // Connection interval and peripheral latency of current link
+    uint32_t getConnInterval();
+    uint16_t getConnLatency();
+    // Add connection events up to now to stats, at current parameters
+    void     countEvents();
+    // Count write without response, false if it is lost on the way
+    bool     writeNoRspArrives();
+
+    // Deliver notification to connected client. Call from host task (see post)
+    bool     notify(uint16_t handle, const uint8_t* data, uint16_t len);
+    // Run fn in host task context after delay. Dropped if link goes down.
+    void     post(uint32_t delayUs, std::function<void()> fn);
+
+    // GATT server callbacks. Return 0 on success, ATT error code otherwise.
+    virtual int  onRead(uint16_t handle, uint8_t* value, uint16_t* len) = 0;
+    virtual int  onWrite(uint16_t handle, const uint8_t* value, uint16_t len) = 0;
+    virtual void onSubscribe(uint16_t handle, bool enabled) {}
+    virtual void onConnect() {}
+    virtual void onDisconnect() {}
+    // Fill advertisement. Return false if peripheral is not advertising.
+    virtual bool getAdvertisement(NimBLEAdvertisedDevice* adv) { return false; }
+
+protected:
+    std::vector<Service> services;
+
+private:
+    friend class NimBLEClient;
+    friend class NimBLERemoteService;
+    friend class NimBLERemoteCharacteristic;
+    friend int ble_gattc_read_long(uint16_t, uint16_t, uint16_t, ble_gatt_attr_fn*, void*);
+    friend int ble_gattc_exchange_mtu(uint16_t, ble_gatt_mtu_fn*, void*);
+    friend int ble_gattc_disc_all_chrs(uint16_t, uint16_t, uint16_t, ble_gatt_chr_fn*, void*);
+    friend int ble_gattc_write_flat(uint16_t, uint16_t, const void*, uint16_t, ble_gatt_attr_fn*, void*);
+    friend int ble_gap_connect(uint8_t, const ble_addr_t*, int32_t, const struct ble_gap_conn_params*,
+                               ble_gap_event_fn*, void*);
+    friend int ble_gap_security_initiate(uint16_t);
+    friend int ble_gap_update_params(uint16_t, const ble_gap_upd_params*);
+    friend int ble_sm_inject_io(uint16_t, struct ble_sm_io*);
+
+    NimBLEAddress address;
+    NimBLEClient* client = nullptr;
+    uint32_t      linkId = 0;
+    uint64_t      busyUntilUs = 0;
+    uint32_t      roundTrips = 0;
+    uint32_t      intervalUs = 0;      // parameters of current link
+    uint16_t      latency = 0;
+    uint64_t      eventsFromUs = 0;    // connection events counted up to
+    bool          paramsPending = false; // parameter update started, not in effect yet
+
+    // Link is up with initial parameters
+    void     startLink();
+    // Connection parameter update took effect
+    void     setConnParams(uint32_t intervalUs, uint16_t latency);
+
+    // Block caller for given number of ATT round trips on this link.
+    // Returns false if link was lost meanwhile. Low level ble_gattc_*
+    // and ble_gap_* functions do not block, they use reserve*() and
+    // complete in host task.
+    bool     roundTrip(uint32_t count = 1);
+    // Block caller for fixed procedure time on this link
+    void     wait(uint32_t us);
+    // Book fixed procedure time on this link without blocking, returns end time
+    uint64_t reserve(uint32_t us);
+    // Book ATT round trips without blocking, returns end time. lost is set if
+    // link drops meanwhile; it is then reported at returned time.
+    uint64_t reserveRoundTrip(uint32_t count, bool* lost);
+};
+
+namespace NimBLESim {
+    std::recursive_mutex& lock();
+    uint64_t              nowUs();
+    void                  sleepUntil(uint64_t us);
+    void                  post(uint64_t atUs, std::function<void()> fn);
+    NimBLESimPeripheral*  find(const NimBLEAddress& address);
+    std::vector<NimBLESimPeripheral*> peripherals();
+}
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *  Compares advertisement decoding through getManufacturerData() copy
+ *  (previous AranetManufacturerData::fromAdvertisement) with in-place
+ *  payload parser. Reports time and heap allocations per advertisement.
+ *  Then compares per-type measurement decoders: previous runtime switch,
+ *  AranetData::parseFromAdvertisement and AranetDevice<Type> layouts.
+ *
+ *  Name:       AdvertisementBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: AdvertisementBench [-n iterations] [-a aranet_percent]
+ */
+
+#include "Aranet4.h"
+#include "AranetSim.h"
+
+#include "HostAlloc.h"
+
+#include <chrono>
+#include <unistd.h>
+
+// Decoding path before zero-copy parser was added
+static bool legacyFromAdvertisement(AranetManufacturerData& md, NimBLEAdvertisedDevice* adv) {
+    std::string strManufacturerData = adv->getManufacturerData();
+    int cLength = strManufacturerData.length();
+
+    if (cLength < 8) return false; // not enough data
+    if (cLength > 100) cLength = 50; // trim
+
+    uint8_t cManufacturerData[50];
+    strManufacturerData.copy((char *) &md.manufacturer_id, 2, 0);
+    strManufacturerData.copy((char *) cManufacturerData, cLength, 2);
+
+    if (md.manufacturer_id != ARANET4_MANUFACTURER_ID) return false;
+
+    int idx = 1;
+    if (cLength == 9 || cLength == 24) {
+        idx = 0;
+        md.data.type = AranetType::ARANET4;
+    } else if (cManufacturerData[0] == 1) {
+        md.data.type = AranetType::ARANET2;
+    } else if (cManufacturerData[0] == 2) {
+        md.data.type = AranetType::ARANET_RADIATION;
+    } else if (cManufacturerData[0] == 3) {
+        md.data.type = AranetType::ARANET_RADON;
+    } else {
+        md.data.type = AranetType::UNKNOWN;
+        return false;
+    }
+
+    md.flags.all = cManufacturerData[idx + 0];
+    md.version.patch = cManufacturerData[idx + 1];
+    md.version.minor = cManufacturerData[idx + 2];
+    md.version.major = cManufacturerData[idx + 3] | (cManufacturerData[idx + 4] << 8);
+    md.hw_rev = cManufacturerData[idx + 4];
+    md.__unknown3 = cManufacturerData[idx + 6];
+    md.packing = cManufacturerData[idx + 7];
+
+    if (md.flags.bits.integrations) {
+        md.data.parseFromAdvertisement(cManufacturerData, cLength, md.data.type);
+    }
+    return true;
+}
+
+// Measurement decoder before AranetLayout tables were added
+static bool legacyParseFromAdvertisement(AranetData& d, const uint8_t* data, int len, AranetType type) {
+    d.type = type;
+    switch (type) {
+    case ARANET4:
+        if (len < 22) return false;
+        memcpy(&d.co2,         (uint8_t*) data + 8, 2);
+        memcpy(&d.temperature, (uint8_t*) data + 10, 2);
+        memcpy(&d.pressure,    (uint8_t*) data + 12, 2);
+        memcpy(&d.interval,    (uint8_t*) data + 17, 2);
+        memcpy(&d.ago,         (uint8_t*) data + 19, 2);
+        d.humidity = data[14];
+        d.battery = data[15];
+        d.status = data[16];
+        d.counter = data[21];
+        return true;
+    case ARANET2:
+        if (len < 24) return false;
+        memcpy(&d.temperature, (uint8_t*) data + 10, 2);
+        memcpy(&d.humidity,    (uint8_t*) data + 14, 2);
+        memcpy(&d.interval,    (uint8_t*) data + 19, 2);
+        memcpy(&d.ago,         (uint8_t*) data + 21, 2);
+        d.battery = data[17];
+        d.status = data[18];
+        d.counter = data[23];
+        return true;
+    case ARANET_RADIATION:
+        if (len < 24) return false;
+        d.radiation_rate = 0;
+        d.radiation_total = 0;
+        d.radiation_duration = 0;
+        memcpy(&d.radiation_total,    (uint8_t*) data + 6, 4);
+        memcpy(&d.radiation_duration, (uint8_t*) data + 10, 4);
+        memcpy(&d.radiation_rate,     (uint8_t*) data + 14, 2);
+        d.battery = data[17];
+        memcpy(&d.interval,    (uint8_t*) data + 19, 2);
+        memcpy(&d.ago,         (uint8_t*) data + 21, 2);
+        d.counter = data[23];
+        return true;
+    case ARANET_RADON:
+        if (len < 24) return false;
+        d.radiation_rate = 0;
+        memcpy(&d.radon_concentration, (uint8_t*) data + 8, 2);
+        memcpy(&d.temperature, (uint8_t*) data + 10, 2);
+        memcpy(&d.pressure,    (uint8_t*) data + 12, 2);
+        memcpy(&d.humidity,    (uint8_t*) data + 14, 2);
+        memcpy(&d.interval,    (uint8_t*) data + 19, 2);
+        memcpy(&d.ago,         (uint8_t*) data + 21, 2);
+        d.battery = data[17];
+        d.status = data[18];
+        d.counter = data[23];
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct Result {
+    double nsPerAdv;
+    double allocsPerAdv;
+    uint32_t accepted;
+};
+
+template<typename F>
+static Result run(NimBLEAdvertisedDevice* advs, size_t n, uint32_t iterations, F decode) {
+    Result r = {0, 0, 0};
+    size_t alloc0 = hostAllocations();
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < n; i++) {
+            AranetManufacturerData md;
+            if (decode(md, &advs[i])) r.accepted++;
+        }
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    double total = (double) iterations * n;
+    r.nsPerAdv = std::chrono::duration<double, std::nano>(t1 - t0).count() / total;
+    r.allocsPerAdv = (hostAllocations() - alloc0) / total;
+    return r;
+}
+
+// Time measurement decoder on one payload, ns per decode
+template<typename F>
+static double runDecode(const uint8_t* data, int len, uint32_t iterations, F decode) {
+    AranetData d;
+    uint32_t accepted = 0;
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        if (decode(d, data, len)) accepted++;
+        // keep decoded value alive, so loop is not optimized away
+        asm volatile("" : : "r"(accepted), "m"(d) : "memory");
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+}
+
+// Decoder with type known at compile time
+template<AranetType Type>
+struct DirectDecode {
+    bool operator()(AranetData& d, const uint8_t* data, int len) const {
+        return aranetDecodeAdvertisement<Type>(d, data, len);
+    }
+};
+
+int main(int argc, char** argv) {
+    uint32_t iterations = 200000;
+    uint32_t aranetPercent = 20;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:a:")) != -1) {
+        switch (opt) {
+        case 'n': iterations = atoi(optarg); break;
+        case 'a': aranetPercent = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [-a aranet_percent]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // One advertisement per Aranet type
+    const AranetType types[] = { ARANET4, ARANET2, ARANET_RADIATION, ARANET_RADON };
+    NimBLEAdvertisedDevice aranet[4];
+    for (int i = 0; i < 4; i++) {
+        AranetSimConfig cfg;
+        cfg.type = types[i];
+        uint8_t mac[6] = { 0x00, 0x01, 0x02, 0x03, 0x04, (uint8_t) i };
+        AranetSim sim(NimBLEAddress(mac), cfg);
+        sim.getAdvertisement(&aranet[i]);
+    }
+
+    // Other vendors: iBeacon-like and generic manufacturer data
+    const uint8_t beacon[] = {
+        0x02, 0x01, 0x06,
+        0x1a, 0xff, 0x4c, 0x00, 0x02, 0x15,
+        0xe2, 0xc5, 0x6d, 0xb5, 0xdf, 0xfb, 0x48, 0xd2, 0xb0, 0x60, 0xd0, 0xf5, 0xa7, 0x10, 0x96, 0xe0,
+        0x00, 0x01, 0x00, 0x02, 0xc5
+    };
+    const uint8_t other[] = {
+        0x02, 0x01, 0x06,
+        0x03, 0x03, 0x9f, 0xfe,
+        0x0e, 0xff, 0x75, 0x00, 0x42, 0x04, 0x01, 0x80, 0xaa, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60,
+        0x05, 0x09, 'S', 'c', 'a', 'l'
+    };
+
+    // Mix that resembles dense office: mostly foreign advertisements
+    const size_t n = 100;
+    NimBLEAdvertisedDevice advs[n];
+    for (size_t i = 0; i < n; i++) {
+        if (i % 100 < aranetPercent) {
+            advs[i] = aranet[i % 4];
+        } else if (i % 2) {
+            advs[i].setAdvertisement(NimBLEAddress((uint64_t) i), beacon, sizeof(beacon));
+        } else {
+            advs[i].setAdvertisement(NimBLEAddress((uint64_t) i), other, sizeof(other));
+        }
+    }
+
+    // Both paths must decode identically
+    int errors = 0;
+    for (size_t i = 0; i < n; i++) {
+        AranetManufacturerData a, b;
+        memset((void*) &a, 0, sizeof(a));
+        memset((void*) &b, 0, sizeof(b));
+        bool ra = legacyFromAdvertisement(a, &advs[i]);
+        bool rb = b.fromAdvertisement(&advs[i]);
+        if (ra != rb || (ra && memcmp((void*) &a, (void*) &b, sizeof(a)) != 0)) {
+            printf("mismatch at advertisement %zu\n", i);
+            errors++;
+        }
+    }
+
+    Result legacy = run(advs, n, iterations, legacyFromAdvertisement);
+    Result inplace = run(advs, n, iterations, [](AranetManufacturerData& md, NimBLEAdvertisedDevice* adv) {
+        return md.fromAdvertisement(adv);
+    });
+
+    printf("advertisements: %u x %zu, %u%% Aranet\n", iterations, n, aranetPercent);
+    printf("%-24s %10s %12s %10s\n", "path", "ns/adv", "allocs/adv", "accepted");
+    printf("%-24s %10.1f %12.2f %10u\n", "getManufacturerData", legacy.nsPerAdv, legacy.allocsPerAdv, legacy.accepted);
+    printf("%-24s %10.1f %12.2f %10u\n", "in-place payload", inplace.nsPerAdv, inplace.allocsPerAdv, inplace.accepted);
+    printf("speedup:        %.1fx\n", legacy.nsPerAdv / inplace.nsPerAdv);
+
+    // Measurement decoders, on manufacturer data after manufacturer id
+    const char* names[4] = { "Aranet4", "Aranet2", "Radiation", "Radon" };
+    uint32_t decodeIterations = iterations * 100;
+
+    printf("\n%-24s %10s %10s %10s\n", "decode ns/adv", "switch", "runtime", "template");
+    for (int i = 0; i < 4; i++) {
+        uint8_t mlen = 0;
+        const uint8_t* mdata = AranetManufacturerData::findManufacturerData(
+            aranet[i].getPayload(), aranet[i].getPayloadLength(), &mlen);
+        if (mdata == nullptr || mlen < 2) {
+            printf("%s: no manufacturer data\n", names[i]);
+            errors++;
+            continue;
+        }
+        const uint8_t* data = mdata + 2;
+        int len = mlen - 2;
+        AranetType type = types[i];
+
+        // Both decoders must produce same data. Runtime decoder dispatches to AranetDevice layouts.
+        AranetData a, b;
+        memset((void*) &a, 0, sizeof(a));
+        memset((void*) &b, 0, sizeof(b));
+        bool ra = legacyParseFromAdvertisement(a, data, len, type);
+        bool rb = b.parseFromAdvertisement(data, len, type);
+        if (!ra || ra != rb || memcmp((void*) &a, (void*) &b, sizeof(a)) != 0) {
+            printf("%s: decoder mismatch\n", names[i]);
+            errors++;
+        }
+
+        // Too short payload must be rejected
+        if (b.parseFromAdvertisement(data, len - 1, type)) {
+            printf("%s: short payload accepted\n", names[i]);
+            errors++;
+        }
+
+        double tSwitch = runDecode(data, len, decodeIterations, [type](AranetData& d, const uint8_t* p, int l) {
+            return legacyParseFromAdvertisement(d, p, l, type);
+        });
+        double tRuntime = runDecode(data, len, decodeIterations, [type](AranetData& d, const uint8_t* p, int l) {
+            return d.parseFromAdvertisement(p, l, type);
+        });
+        double tTemplate;
+        switch (type) {
+        case ARANET4:          tTemplate = runDecode(data, len, decodeIterations, DirectDecode<ARANET4>()); break;
+        case ARANET2:          tTemplate = runDecode(data, len, decodeIterations, DirectDecode<ARANET2>()); break;
+        case ARANET_RADIATION: tTemplate = runDecode(data, len, decodeIterations, DirectDecode<ARANET_RADIATION>()); break;
+        default:               tTemplate = runDecode(data, len, decodeIterations, DirectDecode<ARANET_RADON>()); break;
+        }
+
+        printf("%-24s %10.2f %10.2f %10.2f\n", names[i], tSwitch, tRuntime, tTemplate);
+    }
+
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
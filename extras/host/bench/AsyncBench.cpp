@@ -0,0 +1,268 @@
+/*
+ *  Poll cycle of device fleet from one task with AranetAsync: connect, read
+ *  current readings, download history and disconnect, while keeping as
+ *  many connections busy as controller allows. Compared with blocking
+ *  Aranet4 calls and with AranetAsync::wait(), both one device after
+ *  another. Checks readings, device type and every history value.
+ *
+ *  Name:       AsyncBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: AsyncBench [-d devices] [-c connections] [-n records] [-i interval_ms]
+ *    -d  devices, Aranet4, Aranet2, Aranet Radon and Aranet Radiation in turn (default 9)
+ *    -c  concurrent connections (default CONFIG_BT_NIMBLE_MAX_CONNECTIONS)
+ *    -n  records stored in each device (default 200)
+ *    -i  connection interval in milliseconds (default 30)
+ */
+
+#include "Aranet4.h"
+#include "AranetAsync.h"
+#include "AranetFleet.h"
+#include "AranetSim.h"
+
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+// Compares every value with simulated device log
+class BenchHistory : public AranetHistoryCallbacks {
+public:
+    AranetSim* sim = nullptr;
+    int        values = 0;
+    int        errors = 0;
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        uint64_t mask = chunk->width >= 8 ? ~0ULL : (1ULL << (chunk->width * 8)) - 1;
+        for (uint16_t i = 0; i < chunk->count; i++) {
+            if (chunk->get(i) != (sim->history(chunk->param, chunk->start + i) & mask)) errors++;
+        }
+        values += chunk->count;
+        return true;
+    }
+};
+
+struct BenchDevice {
+    AranetSim*   sim;
+    AranetData   data;
+    BenchHistory history;
+    uint16_t     params;
+    int          records = -1;
+    ar4_err_t    status = AR4_OK;
+    bool         done = false;
+};
+
+static const AranetType types[] = { ARANET4, ARANET2, ARANET_RADON, ARANET_RADIATION };
+
+static bool sameReadings(AranetSim* sim, const AranetData& d) {
+    AranetData c = sim->current();
+    return d.type == c.type && d.co2 == c.co2 && d.temperature == c.temperature
+        && d.pressure == c.pressure && d.humidity == c.humidity
+        && d.radon_concentration == c.radon_concentration && d.radiation_rate == c.radiation_rate;
+}
+
+// Every device runs connect, read, history, disconnect. Next step is started
+// when previous one is done, from process().
+class BenchScript : public AranetAsyncCallbacks {
+public:
+    uint16_t records = 0;
+    int      running = 0;
+
+    void start(AranetAsync* dev) {
+        BenchDevice* d = (BenchDevice*) dev->user;
+        d->done = false;
+        d->records = -1;
+        running++;
+        if (dev->connect(d->sim->getAddress()) == nullptr) stop(dev, AR4_FAIL);
+    }
+
+    void onOpDone(AranetAsync* dev, AranetOp* op) {
+        BenchDevice* d = (BenchDevice*) dev->user;
+
+        if (op->status != AR4_OK && op->type != ARANET_OP_DISCONNECT) {
+            d->status = op->status;
+            if (dev->isConnected()) dev->disconnect();
+            else stop(dev, op->status);
+            return;
+        }
+
+        switch (op->type) {
+        case ARANET_OP_CONNECT:
+            dev->readCurrent(&d->data);
+            break;
+        case ARANET_OP_READ_CURRENT:
+            dev->readHistory(1, records, &d->history, d->params);
+            break;
+        case ARANET_OP_HISTORY:
+            d->records = op->result;
+            dev->disconnect();
+            break;
+        default:
+            stop(dev, d->status);
+            break;
+        }
+    }
+
+private:
+    void stop(AranetAsync* dev, ar4_err_t status) {
+        BenchDevice* d = (BenchDevice*) dev->user;
+        d->status = status;
+        d->done = true;
+        running--;
+    }
+};
+
+static int check(std::vector<BenchDevice>& devices, std::vector<std::unique_ptr<AranetAsync>>* async, uint16_t records) {
+    int errors = 0;
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        BenchDevice& d = devices[i];
+        bool typeOk = async == nullptr || (*async)[i]->getType() == d.sim->config.type;
+        if (d.status != AR4_OK || !sameReadings(d.sim, d.data) || d.records != records || !typeOk) {
+            if (errors < 5) printf("%s: status %d, %d records, type %s\n", d.sim->name(), d.status,
+                d.records, typeOk ? "ok" : "wrong");
+            errors++;
+        }
+        errors += d.history.errors;
+    }
+    return errors;
+}
+
+static void reset(std::vector<BenchDevice>& devices) {
+    for (BenchDevice& d : devices) {
+        d.data = AranetData();
+        d.history.values = 0;
+        d.history.errors = 0;
+        d.records = -1;
+        d.status = AR4_OK;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = 9;
+    uint32_t connections = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+    uint16_t records = 200;
+    uint32_t intervalMs = 30;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:c:n:i:")) != -1) {
+        switch (opt) {
+        case 'd': count = atoi(optarg); break;
+        case 'c': connections = atoi(optarg); break;
+        case 'n': records = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d devices] [-c connections] [-n records] [-i interval_ms]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (connections < 1) connections = 1;
+    if (connections > CONFIG_BT_NIMBLE_MAX_CONNECTIONS) connections = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+
+    Aranet4::init();
+
+    std::vector<std::unique_ptr<AranetSim>> sims;
+    std::vector<BenchDevice> devices(count);
+    BenchScript script;
+    script.records = records;
+    std::vector<std::unique_ptr<AranetAsync>> async;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t mac[6] = { 0x10, 0x20, 0x30, 0x50, (uint8_t) (i >> 8), (uint8_t) i };
+        AranetSimConfig cfg;
+        cfg.type = types[i % 4];
+        cfg.totalReadings = records;
+        cfg.capacity = records;
+        sims.emplace_back(new AranetSim(NimBLEAddress(mac), cfg));
+        sims.back()->link.connIntervalUs = intervalMs * 1000;
+        // different values per device, so mixed up data is detected
+        for (uint32_t m = 0; m < i * 3; m++) sims.back()->measure();
+
+        devices[i].sim = sims.back().get();
+        devices[i].params = AranetSim::params(cfg.type);
+        devices[i].history.sim = devices[i].sim;
+
+        async.emplace_back(new AranetAsync(new BenchCallbacks(), &script));
+        async.back()->user = &devices[i];
+    }
+
+    int errors = 0;
+
+    // Bond with all devices first, gateway in use is already bonded
+    Aranet4 ar4(new BenchCallbacks());
+    for (BenchDevice& d : devices) {
+        if (ar4.connect(d.sim->getAddress()) != AR4_OK) errors++;
+        ar4.disconnect();
+    }
+
+    // Blocking Aranet4, one device after another
+    reset(devices);
+    unsigned long t0 = millis();
+    for (BenchDevice& d : devices) {
+        d.status = ar4.connect(d.sim->getAddress());
+        if (d.status != AR4_OK) continue;
+        d.data = ar4.getCurrentReadings();
+        d.records = ar4.getHistory(1, records, &d.history, d.params);
+        d.status = ar4.getStatus();
+        ar4.disconnect();
+    }
+    unsigned long blocking = millis() - t0;
+    errors += check(devices, nullptr, records);
+
+    // AranetAsync with wait(), one device after another. No callbacks.
+    reset(devices);
+    AranetAsync waiter(new BenchCallbacks());
+    t0 = millis();
+    for (BenchDevice& d : devices) {
+        d.status = waiter.wait(waiter.connect(d.sim->getAddress()));
+        if (d.status != AR4_OK) continue;
+        if (waiter.getType() != d.sim->config.type) errors++;
+        d.status = waiter.wait(waiter.readCurrent(&d.data));
+        AranetOp* op = waiter.readHistory(1, records, &d.history, d.params);
+        if (d.status == AR4_OK) d.status = waiter.wait(op);
+        d.records = op->result;
+        waiter.wait(waiter.disconnect());
+    }
+    unsigned long waited = millis() - t0;
+    errors += check(devices, nullptr, records);
+
+    // AranetAsync, single task, all connections busy
+    reset(devices);
+    uint32_t next = 0;
+    int maxRunning = 0;
+    t0 = millis();
+    while (next < count || script.running > 0) {
+        while (next < count && script.running < (int) connections) {
+            script.start(async[next++].get());
+        }
+        if (script.running > maxRunning) maxRunning = script.running;
+        AranetAsync::process(1000);
+    }
+    unsigned long concurrent = millis() - t0;
+    errors += check(devices, &async, records);
+
+    for (auto& dev : async) {
+        if (dev->isConnected() || dev->isBusy()) errors++;
+    }
+
+    int values = 0;
+    for (BenchDevice& d : devices) values += d.history.values;
+
+    printf("devices:        %u, %u records, %u ms connection interval\n", count, records, intervalMs);
+    printf("%-28s %10s\n", "mode", "ms/cycle");
+    printf("%-28s %10lu\n", "Aranet4, sequential", blocking);
+    printf("%-28s %10lu\n", "AranetAsync wait()", waited);
+    printf("%-28s %10lu\n", "AranetAsync, one task", concurrent);
+    printf("max connections: %d, %d history values checked\n", maxRunning, values);
+    printf("state per device: %u bytes (AranetAsync), fleet worker stack %u bytes\n",
+        (uint32_t) sizeof(AranetAsync), (uint32_t) ARANET_FLEET_TASK_STACK);
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/*
+ *  History download, then connection kept open and current readings read
+ *  once more. Default connection parameters compared with connection
+ *  profiles (setConnProfiles): download speed, connection events device
+ *  is awake for while idle, and read latency on relaxed link. Profiles are
+ *  also used with AranetHistoryTransfer, which downloads one parameter at
+ *  a time: link must stay at bulk parameters in between. Checks every
+ *  history value and number of parameter updates.
+ *
+ *  Name:       ConnParamsBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: ConnParamsBench [-t 4|2|r|rn] [-n records] [-i interval_ms] [-I min_interval_ms] [-w idle_s]
+ *    -t  device type (default 4)
+ *    -n  records stored in device (default 2016)
+ *    -i  connection interval when link is established, milliseconds (default 30)
+ *    -I  shortest interval device accepts, milliseconds (default 15)
+ *    -w  idle time after download, seconds (default 10)
+ */
+
+#include "Aranet4.h"
+#include "AranetHistoryTransfer.h"
+#include "AranetSim.h"
+
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+static int checkChunk(AranetSim* sim, AranetHistoryChunk* chunk) {
+    int errors = 0;
+    uint64_t mask = chunk->width >= 8 ? ~0ULL : (1ULL << (chunk->width * 8)) - 1;
+    for (uint16_t i = 0; i < chunk->count; i++) {
+        if (chunk->get(i) != (sim->history(chunk->param, chunk->start + i) & mask)) errors++;
+    }
+    return errors;
+}
+
+// Compares every value with simulated device log
+class BenchHistory : public AranetHistoryCallbacks {
+public:
+    AranetSim* sim = nullptr;
+    int        errors = 0;
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        errors += checkChunk(sim, chunk);
+        return true;
+    }
+};
+
+// Same check on resumable download
+class BenchTransfer : public AranetHistoryTransfer {
+public:
+    BenchTransfer(Aranet4* ar4, AranetSim* sim, uint16_t count, AranetDataCompact* data, uint16_t params)
+        : AranetHistoryTransfer(ar4, 1, count, data, params), sim(sim) {}
+
+    AranetSim* sim;
+    int        errors = 0;
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        errors += checkChunk(sim, chunk);
+        return AranetHistoryTransfer::onHistoryChunk(chunk);
+    }
+};
+
+int main(int argc, char** argv) {
+    AranetSimConfig cfg;
+    uint32_t intervalMs = 30;
+    uint32_t minIntervalMs = 15;
+    uint32_t idleS = 10;
+    int opt;
+
+    cfg.totalReadings = 2016;
+
+    while ((opt = getopt(argc, argv, "t:n:i:I:w:")) != -1) {
+        switch (opt) {
+        case 't':
+            if (strcmp(optarg, "2") == 0) cfg.type = ARANET2;
+            else if (strcmp(optarg, "r") == 0) cfg.type = ARANET_RADIATION;
+            else if (strcmp(optarg, "rn") == 0) cfg.type = ARANET_RADON;
+            else cfg.type = ARANET4;
+            break;
+        case 'n': cfg.totalReadings = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        case 'I': minIntervalMs = atoi(optarg); break;
+        case 'w': idleS = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-t 4|2|r|rn] [-n records] [-i interval_ms] [-I min_interval_ms] [-w idle_s]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.capacity < cfg.totalReadings) cfg.capacity = cfg.totalReadings;
+
+    Aranet4::init();
+
+    AranetSim sim(NimBLEAddress("00:01:02:03:04:05"), cfg);
+    sim.link.connIntervalUs = intervalMs * 1000;
+    sim.link.minIntervalUs = minIntervalMs * 1000;
+
+    Aranet4 ar4(new BenchCallbacks());
+    uint16_t params = AranetSim::params(cfg.type);
+    int errors = 0;
+
+    // Pair once, gateway in use is already bonded
+    if (ar4.connect(sim.getAddress()) != AR4_OK) errors++;
+    ar4.disconnect();
+
+    const char* names[] = { "default parameters", "connection profiles", "profiles, resumable" };
+    printf("device:         %s, %u records, %u ms initial interval, %u ms shortest\n",
+        sim.name(), cfg.totalReadings, intervalMs, minIntervalMs);
+    printf("%-20s %10s %10s %10s %12s %10s %10s\n", "mode", "history ms", "records/s",
+        "events", "idle ev/s", "interval", "read ms");
+
+    for (int mode = 0; mode < 3; mode++) {
+        ar4.setConnProfiles(mode >= 1);
+
+        BenchHistory history;
+        history.sim = &sim;
+
+        if (ar4.connect(sim.getAddress()) != AR4_OK) {
+            printf("connect failed\n");
+            return 1;
+        }
+
+        // History download
+        uint32_t updates = sim.stats.connParamUpdates;
+        sim.countEvents();
+        uint32_t e0 = sim.stats.connEvents;
+        unsigned long t0 = millis();
+        int records;
+        if (mode == 2) {
+            AranetDataCompact* data = (AranetDataCompact*) calloc(cfg.totalReadings, sizeof(AranetDataCompact));
+            BenchTransfer transfer(&ar4, &sim, cfg.totalReadings, data, params);
+            records = transfer.run();
+            history.errors = transfer.errors;
+            free(data);
+        } else {
+            records = ar4.getHistory(1, cfg.totalReadings, &history, params);
+        }
+        unsigned long tHistory = millis() - t0;
+        sim.countEvents();
+        uint32_t eHistory = sim.stats.connEvents - e0;
+
+        if (records != cfg.totalReadings || ar4.getStatus() != AR4_OK) errors++;
+        errors += history.errors;
+
+        // Connection kept open, nothing to send
+        delay(idleS * 1000);
+        sim.countEvents();
+        uint32_t eIdle = sim.stats.connEvents - e0 - eHistory;
+        uint32_t interval = sim.getConnInterval();
+
+        // One more read on relaxed link
+        t0 = millis();
+        AranetData cur = ar4.getCurrentReadings();
+        unsigned long tRead = millis() - t0;
+        if (ar4.getStatus() != AR4_OK || cur.type != cfg.type) errors++;
+
+        ar4.disconnect();
+
+        // Profiles: one update at start of download, one at end
+        if (sim.stats.connParamUpdates - updates != (mode >= 1 ? 2u : 0u)) errors++;
+
+        printf("%-20s %10lu %10.1f %10u %12.1f %8.1f ms %10lu\n", names[mode], tHistory,
+            tHistory > 0 ? records * 1000.0 / tHistory : 0, eHistory,
+            idleS > 0 ? (double) eIdle / idleS : 0, interval / 1000.0, tRead);
+    }
+
+    printf("errors:         %d\n", errors);
+    return errors == 0 ? 0 : 1;
+}
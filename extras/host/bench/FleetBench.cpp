@@ -0,0 +1,238 @@
+/*
+ *  Poll cycle of device fleet from one gateway: one Aranet4 polling devices
+ *  one after another, compared with AranetFleet worker pool. Some addresses
+ *  have no device (out of range), they cost full connect timeout. Controller
+ *  allows one connection attempt at a time, so out of range device also
+ *  delays link setup of other workers: deadline must cover it. Checks that
+ *  every job got data of its own device.
+ *
+ *  Name:       FleetBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: FleetBench [-d devices] [-u unreachable] [-w workers] [-t timeout_ms] [-i interval_ms] [-n records] [-H]
+ *    -d  devices in range (default 12)
+ *    -u  addresses without device (default 1)
+ *    -w  fleet workers (default CONFIG_BT_NIMBLE_MAX_CONNECTIONS)
+ *    -t  job deadline in milliseconds (default 5000)
+ *    -i  connection interval in milliseconds (default 30)
+ *    -n  records stored in each device (default 100)
+ *    -H  also sync history, second cycle only gets new records
+ */
+
+#include "Aranet4.h"
+#include "AranetFleet.h"
+#include "AranetSim.h"
+
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+#define BENCH_NOW 1700000000
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+// Checks that records belong to device of job
+class BenchHistory : public AranetHistoryCallbacks {
+public:
+    AranetSim* sim = nullptr;
+    int        errors = 0;
+
+    bool onHistoryRecords(uint16_t start, AranetDataCompact* records, uint16_t count) {
+        for (uint16_t i = 0; i < count; i++) {
+            if (records[i].aranet4.co2 != (uint16_t) sim->history(AR4_PARAM_CO2, start + i)) errors++;
+            if (records[i].aranet4.temperature != (uint16_t) sim->history(AR4_PARAM_TEMPERATURE, start + i)) errors++;
+        }
+        return true;
+    }
+};
+
+struct BenchDevice {
+    NimBLEAddress       address;
+    AranetSim*          sim;      // nullptr if out of range
+    AranetHistoryCursor cursor;
+    BenchHistory        history;
+};
+
+static bool sameReadings(AranetSim* sim, const AranetData& d) {
+    AranetData c = sim->current();
+    return d.type == c.type && d.co2 == c.co2 && d.temperature == c.temperature
+        && d.pressure == c.pressure && d.humidity == c.humidity;
+}
+
+static void setupJob(AranetFleetJob* job, BenchDevice* dev, bool history, uint32_t timeout) {
+    job->address = dev->address;
+    job->ops = ARANET_JOB_CURRENT | (history ? ARANET_JOB_HISTORY : 0);
+    job->timeout = timeout;
+    job->cursor = &dev->cursor;
+    job->history = &dev->history;
+    job->now = BENCH_NOW;
+    job->user = dev;
+}
+
+// Checks fleet results, returns errors
+static int checkJobs(AranetFleetJob* jobs, uint32_t count, bool history, int expectRecords) {
+    int errors = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        AranetFleetJob* job = &jobs[i];
+        BenchDevice* dev = (BenchDevice*) job->user;
+
+        if (dev->sim == nullptr) {
+            if (job->status == AR4_OK) errors++;
+            continue;
+        }
+
+        if (job->status != AR4_OK || !sameReadings(dev->sim, job->data)) {
+            if (errors < 5) printf("%s: status %d, wrong readings\n", dev->sim->name(), job->status);
+            errors++;
+        }
+        if (history && job->records != expectRecords) {
+            if (errors < 5) printf("%s: %d records, expected %d\n", dev->sim->name(), job->records, expectRecords);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = 12;
+    uint32_t unreachable = 1;
+    uint32_t workers = CONFIG_BT_NIMBLE_MAX_CONNECTIONS;
+    uint32_t timeout = ARANET_FLEET_TIMEOUT;
+    uint32_t intervalMs = 30;
+    uint16_t records = 100;
+    bool history = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:u:w:t:i:n:H")) != -1) {
+        switch (opt) {
+        case 'd': count = atoi(optarg); break;
+        case 'u': unreachable = atoi(optarg); break;
+        case 'w': workers = atoi(optarg); break;
+        case 't': timeout = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        case 'n': records = atoi(optarg); break;
+        case 'H': history = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d devices] [-u unreachable] [-w workers] [-t timeout_ms] [-i interval_ms] [-n records] [-H]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Aranet4::init();
+
+    std::vector<std::unique_ptr<AranetSim>> sims;
+    std::vector<BenchDevice> devices(count + unreachable);
+
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        BenchDevice& dev = devices[i];
+        uint8_t mac[6] = { 0x10, 0x20, 0x30, 0x40, (uint8_t) (i >> 8), (uint8_t) i };
+        dev.address = NimBLEAddress(mac);
+        dev.sim = nullptr;
+
+        // Unreachable addresses spread over list
+        if (unreachable > 0 && i % (devices.size() / unreachable) == 0
+                && i / (devices.size() / unreachable) < unreachable) {
+            continue;
+        }
+
+        AranetSimConfig cfg;
+        cfg.totalReadings = records;
+        cfg.capacity = records;
+        sims.emplace_back(new AranetSim(dev.address, cfg));
+        sims.back()->link.connIntervalUs = intervalMs * 1000;
+        // different values per device, so mixed up data is detected
+        for (uint32_t m = 0; m < i * 3; m++) sims.back()->measure();
+        dev.sim = sims.back().get();
+    }
+
+    int errors = 0;
+
+    // Bond with all devices first, gateway in use is already bonded
+    Aranet4 ar4(new BenchCallbacks());
+    for (BenchDevice& dev : devices) {
+        if (dev.sim == nullptr) continue;
+        if (ar4.connect(dev.address) != AR4_OK) errors++;
+        ar4.disconnect();
+    }
+
+    // Sequential: single client, same connect timeout
+    uint32_t connectTimeout = timeout < ARANET_FLEET_CONNECT_TIMEOUT ? timeout : ARANET_FLEET_CONNECT_TIMEOUT;
+    ar4.setConnectTimeout((connectTimeout + 999) / 1000);
+    unsigned long t0 = millis();
+    for (BenchDevice& dev : devices) {
+        memset(&dev.cursor, 0, sizeof(dev.cursor));
+        if (ar4.connect(dev.address) != AR4_OK) {
+            if (dev.sim != nullptr) errors++;
+            continue;
+        }
+        AranetData data = ar4.getCurrentReadings();
+        if (!sameReadings(dev.sim, data)) errors++;
+        if (history) {
+            dev.history.sim = dev.sim;
+            if (ar4.syncHistory(&dev.cursor, BENCH_NOW, &dev.history) != records) errors++;
+        }
+        ar4.disconnect();
+    }
+    unsigned long sequential = millis() - t0;
+
+    // Fleet
+    AranetFleet fleet(new BenchCallbacks());
+    if (!fleet.begin(workers)) {
+        printf("fleet failed to start\n");
+        return 1;
+    }
+
+    std::vector<AranetFleetJob> jobs(devices.size());
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        memset(&devices[i].cursor, 0, sizeof(devices[i].cursor));
+        devices[i].history.sim = devices[i].sim;
+        setupJob(&jobs[i], &devices[i], history, timeout);
+    }
+
+    t0 = millis();
+    int ok = fleet.run(jobs.data(), jobs.size());
+    unsigned long parallel = millis() - t0;
+    errors += checkJobs(jobs.data(), jobs.size(), history, records);
+
+    uint32_t slowest = 0;
+    for (AranetFleetJob& job : jobs) {
+        BenchDevice* dev = (BenchDevice*) job.user;
+        if (dev->sim != nullptr && job.elapsed > slowest) slowest = job.elapsed;
+        // Out of range device must not hold worker past deadline (1 s connect timeout granularity)
+        if (job.elapsed > ((timeout + 999) / 1000) * 1000 + 500) errors++;
+    }
+
+    // Second cycle: one new measurement per device
+    unsigned long incremental = 0;
+    if (history) {
+        for (auto& sim : sims) sim->measure();
+        for (AranetFleetJob& job : jobs) job.now += AranetSimConfig().interval;
+        t0 = millis();
+        fleet.run(jobs.data(), jobs.size());
+        incremental = millis() - t0;
+        errors += checkJobs(jobs.data(), jobs.size(), history, 1);
+    }
+
+    uint8_t started = fleet.getWorkerCount();
+    fleet.end();
+
+    for (BenchDevice& dev : devices) errors += dev.history.errors;
+
+    printf("devices:        %u in range, %u unreachable, deadline %u ms, connect timeout %u ms\n",
+        count, unreachable, timeout, connectTimeout);
+    printf("%-24s %10s\n", "mode", "ms/cycle");
+    printf("%-24s %10lu\n", "sequential", sequential);
+    printf("%-24s %10lu\n", "fleet", parallel);
+    if (history) printf("%-24s %10lu\n", "fleet, new records only", incremental);
+    printf("fleet workers:  %u, %d/%u jobs ok, slowest in range device %u ms\n",
+        started, ok, (uint32_t) jobs.size(), slowest);
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
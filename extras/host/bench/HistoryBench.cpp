@@ -0,0 +1,421 @@
+/*
+ *  Measures history download from simulated Aranet device and checks
+ *  received records against values served by simulator.
+ *
+ *  Name:       HistoryBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: HistoryBench [-t 4|2|r|rn] [-n records] [-i interval_ms] [-m mtu] [-1] [-s] [-r] [-p] [-l n] [-T minutes] [-D n] [-E n] [-W n] [-R] [-C]
+ *    -t  device type (default 4)
+ *    -n  records stored in device (default 2016)
+ *    -i  connection interval in milliseconds (default 30)
+ *    -m  ATT MTU accepted by device (default 247)
+ *    -1  device without V2 history (notification based V1 protocol)
+ *    -s  streaming download (AranetHistoryCallbacks), records are checked as they arrive
+ *    -r  single pass download of complete records (getHistoryRecords)
+ *    -p  pipelined V2 transfer (setHistoryPipelining)
+ *    -l  lose every n-th notification (V1 history)
+ *    -T  only records of last minutes (getHistoryByTime), measurement times are checked
+ *    -D  drop link on every n-th ATT round trip during history download
+ *    -E  fail every n-th read with ATT error during history download
+ *    -W  lose every n-th write without response during history download (with -p)
+ *    -R  resumable download (AranetHistoryTransfer), retries and reconnects
+ *    -C  columnar storage (AranetHistoryColumns), values are checked at full width
+ */
+
+#include "Aranet4.h"
+#include "AranetHistoryColumns.h"
+#include "AranetHistoryTransfer.h"
+#include "AranetSim.h"
+#include "HostAlloc.h"
+
+#include <chrono>
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+static uint64_t field(AranetDataCompact& rec, uint8_t param) {
+    switch (param) {
+    case AR4_PARAM_TEMPERATURE:             return rec.aranet4.temperature;
+    case AR4_PARAM_HUMIDITY:
+    case AR4_PARAM_HUMIDITY2:               return rec.aranet4.humidity;
+    case AR4_PARAM_PRESSURE:                return rec.aranet4.pressure;
+    case AR4_PARAM_CO2:                     return rec.aranet4.co2;
+    case AR4_PARAM_RADIATION_PULSES:        return rec.aranetr.rad_pulses;
+    case AR4_PARAM_RADIATION_DOSE:          return rec.aranetr.rad_dose;
+    case AR4_PARAM_RADIATION_DOSE_RATE:     return rec.aranetr.rad_dose_rate;
+    case AR4_PARAM_RADIATION_DOSE_INTEGRAL: return rec.aranetr.rad_dose_integral;
+    case AR4_PARAM_RADON_CONCENTRATION:     return rec.aranetrn.radon_concentration;
+    }
+    return 0;
+}
+
+// Expected value after being stored in AranetDataCompact field
+static uint64_t stored(uint8_t param, uint64_t val) {
+    switch (param) {
+    case AR4_PARAM_RADIATION_DOSE_INTEGRAL: return val;
+    default:                                return val & 0xffff;
+    }
+}
+
+// Checks streamed values against simulator, nothing is stored
+class StreamChecker : public AranetHistoryCallbacks {
+public:
+    StreamChecker(AranetSim* sim) : sim(sim) {}
+
+    AranetSim* sim;
+    uint32_t   chunks = 0;
+    uint32_t   values = 0;
+    uint16_t   maxChunk = 0;
+    int        errors = 0;
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        chunks++;
+        values += chunk->count;
+        if (chunk->count > maxChunk) maxChunk = chunk->count;
+
+        for (uint16_t i = 0; i < chunk->count; i++) {
+            // V1 protocol sends 16 bit values
+            uint64_t expected = sim->history(chunk->param, chunk->start + i);
+            if (chunk->width < 8) expected &= (1ull << (chunk->width * 8)) - 1;
+            if (chunk->get(i) != expected) {
+                if (errors < 5) {
+                    printf("mismatch #%d param %u: got %llu expected %llu\n", chunk->start + i, chunk->param,
+                        (unsigned long long) chunk->get(i), (unsigned long long) expected);
+                }
+                errors++;
+            }
+        }
+        return true;
+    }
+};
+
+// Checks complete records against simulator, nothing is stored
+class RecordChecker : public AranetHistoryCallbacks {
+public:
+    RecordChecker(AranetSim* sim, uint16_t params) : sim(sim), params(params) {}
+
+    AranetSim*    sim;
+    uint16_t      params;
+    uint32_t      calls = 0;
+    uint32_t      records = 0;
+    uint32_t      next = 1;
+    unsigned long firstAt = 0;
+    int           errors = 0;
+
+    bool onHistoryRecords(uint16_t start, AranetDataCompact* recs, uint16_t count) {
+        if (calls++ == 0) firstAt = millis();
+        if (start != next) {
+            printf("records out of order: got %u expected %u\n", start, next);
+            errors++;
+        }
+        next = start + count;
+        records += count;
+
+        for (uint16_t i = 0; i < count; i++) {
+            for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+                if (!(params & (1 << (param - 1)))) continue;
+                uint64_t expected = stored(param, sim->history(param, start + i));
+                uint64_t got = field(recs[i], param);
+                if (got != expected) {
+                    if (errors < 5) {
+                        printf("mismatch #%d param %u: got %llu expected %llu\n", start + i, param,
+                            (unsigned long long) got, (unsigned long long) expected);
+                    }
+                    errors++;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// Decode time of one chunk, repeated: AranetDataCompact::set() per value vs column copy
+static void decodeBench(uint8_t param, uint16_t records) {
+    uint8_t width = Aranet4::getHistoryParamWidth(param);
+    uint8_t values[240];
+    for (uint16_t i = 0; i < sizeof(values); i++) values[i] = i * 7;
+
+    AranetHistoryChunk chunk;
+    chunk.param = param;
+    chunk.width = width;
+    chunk.values = values;
+    chunk.count = sizeof(values) / width;
+
+    AranetDataCompact* data = (AranetDataCompact*) calloc(records, sizeof(AranetDataCompact));
+    AranetHistoryColumns columns;
+    columns.begin(1, records, 1 << (param - 1));
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t start = 1; start + chunk.count <= records; start += chunk.count) {
+        for (uint16_t i = 0; i < chunk.count; i++) data[start - 1 + i].set(param, chunk.get(i));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (uint32_t start = 1; start + chunk.count <= records; start += chunk.count) {
+        chunk.start = start;
+        columns.onHistoryChunk(&chunk);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    uint32_t n = (records - 1) / chunk.count * chunk.count;
+    printf("decode:         param %2u: %5.2f ns/value compact, %5.2f ns/value columns\n", param,
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / n,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / n);
+    free(data);
+}
+
+int main(int argc, char** argv) {
+    AranetSimConfig cfg;
+    uint32_t intervalMs = 30;
+    uint16_t mtu = 247;
+    bool stream = false;
+    bool records = false;
+    bool pipelining = false;
+    uint16_t dropEvery = 0;
+    uint32_t minutes = 0;
+    uint16_t linkLossEvery = 0;
+    uint16_t readErrorEvery = 0;
+    uint16_t writeDropEvery = 0;
+    bool resumable = false;
+    bool columnar = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:i:m:1srpl:T:D:E:W:RC")) != -1) {
+        switch (opt) {
+        case 't':
+            if (strcmp(optarg, "2") == 0) cfg.type = ARANET2;
+            else if (strcmp(optarg, "r") == 0) cfg.type = ARANET_RADIATION;
+            else if (strcmp(optarg, "rn") == 0) cfg.type = ARANET_RADON;
+            else cfg.type = ARANET4;
+            break;
+        case 'n': cfg.totalReadings = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        case 'm': mtu = atoi(optarg); break;
+        case '1': cfg.historyV2 = false; break;
+        case 's': stream = true; break;
+        case 'r': records = true; break;
+        case 'p': pipelining = true; break;
+        case 'l': dropEvery = atoi(optarg); break;
+        case 'T': minutes = atoi(optarg); break;
+        case 'D': linkLossEvery = atoi(optarg); break;
+        case 'E': readErrorEvery = atoi(optarg); break;
+        case 'W': writeDropEvery = atoi(optarg); break;
+        case 'R': resumable = true; break;
+        case 'C': columnar = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-t 4|2|r|rn] [-n records] [-i interval_ms] [-m mtu] [-1] [-s] [-r] [-p] [-l n] [-T minutes] [-D n] [-E n] [-R] [-C]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (cfg.totalReadings > cfg.capacity) cfg.capacity = cfg.totalReadings;
+
+    Aranet4::init();
+
+    AranetSim sim(NimBLEAddress("00:01:02:03:04:05"), cfg);
+    sim.link.connIntervalUs = intervalMs * 1000;
+    sim.link.mtu = mtu;
+    sim.link.notifyDropEvery = dropEvery;
+
+    uint16_t params = AranetSim::params(cfg.type);
+    if (!cfg.historyV2) params &= AR4_PARAM_FLAGS | AR2_PARAM_FLAGS;
+
+    Aranet4 ar4(new BenchCallbacks());
+    ar4.setHistoryPipelining(pipelining);
+
+    unsigned long t0 = millis();
+    if (ar4.connect(sim.getAddress()) != AR4_OK) {
+        printf("connect failed\n");
+        return 1;
+    }
+    unsigned long tConnect = millis() - t0;
+
+    t0 = millis();
+    AranetData cur = ar4.getCurrentReadings();
+    unsigned long tCurrent = millis() - t0;
+    if (ar4.getStatus() != AR4_OK || cur.type != cfg.type) {
+        printf("current readings failed (%u)\n", ar4.getStatus());
+        return 1;
+    }
+
+    // Repeated poll on same connection: current readings and log state.
+    // Must not touch heap.
+    NimBLESimStats pollBefore = sim.stats;
+    size_t allocBefore = hostAllocations();
+    t0 = millis();
+    ar4.getCurrentReadings();
+    ar4.getTotalReadings();
+    ar4.getSecondsSinceUpdate();
+    unsigned long tPoll = millis() - t0;
+    size_t pollAllocs = hostAllocations() - allocBefore;
+    NimBLESimStats pollAfter = sim.stats;
+
+    // Device info, into char arrays. First read discovers service, repeated
+    // reads must not touch heap.
+    char name[ARANET_STRING_SIZE];
+    char version[ARANET_STRING_SIZE];
+    ar4.getName(name, sizeof(name));
+    ar4.getSwVersion(version, sizeof(version));
+    allocBefore = hostAllocations();
+    ar4.getName(name, sizeof(name));
+    ar4.getSwVersion(version, sizeof(version));
+    size_t infoAllocs = hostAllocations() - allocBefore;
+    uint32_t pollRtts = (pollAfter.reads - pollBefore.reads) + (pollAfter.writes - pollBefore.writes)
+                      + (pollAfter.discoveries - pollBefore.discoveries);
+
+    uint16_t count = cfg.totalReadings;
+    uint16_t first = 1;
+    AranetDataCompact* data = nullptr;
+    int timeErrors = 0;
+
+    // Gateway clock for -T, newest record was measured cfg.ago seconds ago
+    uint32_t now = 1760000000;
+    uint32_t newest = now - cfg.ago;
+    if (minutes > 0) {
+        uint32_t window = minutes * 60;
+        uint32_t n = window >= cfg.ago ? (window - cfg.ago) / cfg.interval + 1 : 0;
+        count = n < count ? n : count;
+        first = cfg.totalReadings - count + 1;
+    }
+    StreamChecker checker(&sim);
+    RecordChecker recordChecker(&sim, params);
+
+    sim.link.linkLossEvery = linkLossEvery;
+    sim.link.readErrorEvery = readErrorEvery;
+    sim.link.writeDropEvery = writeDropEvery;
+    uint16_t retries = 0;
+    uint16_t reconnects = 0;
+
+    NimBLESimStats before = sim.stats;
+    t0 = millis();
+    int recvd;
+    AranetHistoryColumns columns;
+    if (columnar) {
+        columns.begin(1, count, params);
+        recvd = ar4.getHistory(&columns);
+    } else if (resumable) {
+        data = (AranetDataCompact*) calloc(count, sizeof(AranetDataCompact));
+        AranetHistoryTransfer transfer(&ar4, 1, count, data, params);
+        recvd = transfer.run();
+        retries = transfer.getRetryCount();
+        reconnects = transfer.getReconnectCount();
+    } else if (records) {
+        recvd = ar4.getHistoryRecords(1, count, &recordChecker, params);
+    } else if (minutes > 0) {
+        AranetHistoryRecord* timed = (AranetHistoryRecord*) calloc(count + 1, sizeof(AranetHistoryRecord));
+        data = (AranetDataCompact*) calloc(count + 1, sizeof(AranetDataCompact));
+        recvd = ar4.getHistoryByTime(now - minutes * 60, now, now, timed, count + 1, params);
+        for (int i = 0; i < recvd; i++) {
+            data[i] = timed[i].data;
+            if (timed[i].time != newest - (uint32_t) (count - 1 - i) * cfg.interval) timeErrors++;
+        }
+        if (recvd != count) timeErrors++;
+        free(timed);
+    } else if (stream) {
+        recvd = ar4.getHistory(1, count, &checker, params);
+    } else {
+        data = (AranetDataCompact*) calloc(count, sizeof(AranetDataCompact));
+        recvd = ar4.getHistory(1, count, data, params);
+    }
+    unsigned long tHistory = millis() - t0;
+    NimBLESimStats after = sim.stats;
+    AranetTransferStats transfer = ar4.getTransferStats();
+    sim.link.linkLossEvery = 0;
+    sim.link.readErrorEvery = 0;
+    sim.link.writeDropEvery = 0;
+
+    ar4.disconnect();
+
+    int errors = checker.errors + recordChecker.errors + timeErrors;
+    if (records && recordChecker.records != (uint32_t) recvd) errors++;
+    if (pollAllocs != 0 || infoAllocs != 0) errors++;
+    for (int i = 0; data != nullptr && i < recvd; i++) {
+        for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+            if (!(params & (1 << (param - 1)))) continue;
+            uint64_t expected = stored(param, sim.history(param, first + i));
+            uint64_t got = field(data[i], param);
+            if (got != expected) {
+                if (errors < 5) {
+                    printf("mismatch #%d param %u: got %llu expected %llu\n", i + 1, param,
+                        (unsigned long long) got, (unsigned long long) expected);
+                }
+                errors++;
+            }
+        }
+    }
+    free(data);
+
+    for (int i = 0; columnar && i < recvd; i++) {
+        for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+            if (!(params & (1 << (param - 1)))) continue;
+            uint8_t width = columns.getWidth(param);
+            uint64_t expected = sim.history(param, i + 1);
+            if (width < 8) expected &= (1ull << (width * 8)) - 1;
+            if (columns.get(param, i) != expected) {
+                if (errors < 5) {
+                    printf("mismatch #%d param %u: got %llu expected %llu\n", i + 1, param,
+                        (unsigned long long) columns.get(param, i), (unsigned long long) expected);
+                }
+                errors++;
+            }
+        }
+    }
+
+    uint32_t reads = after.reads - before.reads;
+    uint32_t writes = after.writes - before.writes;
+    uint32_t writesNoRsp = after.writesNoRsp - before.writesNoRsp;
+    uint32_t notifications = after.notifications - before.notifications;
+
+    printf("device:         %s (%s history)\n", sim.name(), cfg.historyV2 ? "V2" : "V1");
+    printf("link:           %u ms interval, MTU %u\n", intervalMs, mtu);
+    printf("connect:        %lu ms\n", tConnect);
+    printf("current:        %lu ms\n", tCurrent);
+    printf("poll:           %lu ms, %u round trips, %zu allocations\n", tPoll, pollRtts, pollAllocs);
+    printf("device info:    %s %s, %zu allocations\n", name, version, infoAllocs);
+    printf("history:        %d/%u records in %lu ms (%.1f records/s)\n",
+        recvd, count, tHistory, tHistory ? recvd * 1000.0 / tHistory : 0.0);
+    printf("round trips:    %u reads, %u writes, %u notifications\n", reads, writes, notifications);
+    printf("no response:    %u writes, %u lost, %u chunks requested again\n", writesNoRsp,
+        after.writesLost - before.writesLost, cfg.historyV2 ? transfer.rerequests : 0);
+    if (!cfg.historyV2) {
+        printf("lost:           %u notifications, %u ranges requested again, %u values missing\n",
+            after.notificationsLost - before.notificationsLost, transfer.rerequests, transfer.missing);
+    }
+    printf("transfer stats: %u records, %u chunks, %u bytes in %u ms (%.1f records/s%s)\n",
+        transfer.records, transfer.chunks, transfer.bytes, transfer.elapsed,
+        transfer.recordsPerSecond(), transfer.pipelined ? ", pipelined" : "");
+    if (cfg.historyV2 && reads > 0) {
+        printf("per chunk:      %.1f ms, %.1f bytes per read at MTU %u\n", (double) tHistory / reads,
+            transfer.bytesPerRoundTrip(), transfer.mtu);
+    }
+    if (linkLossEvery || readErrorEvery || resumable) {
+        printf("faults:         %u link losses, %u read errors, %u retries, %u reconnects\n",
+            after.linkLosses - before.linkLosses, after.readErrors - before.readErrors, retries, reconnects);
+    }
+    if (minutes > 0) {
+        printf("time range:     last %u minutes, records %u..%u, %d time errors\n",
+            minutes, first, first + count - 1, timeErrors);
+    } else if (records) {
+        printf("records:        %u calls, first after %lu ms, no record storage\n",
+            recordChecker.calls, recordChecker.calls ? recordChecker.firstAt - t0 : 0);
+    } else if (columnar) {
+        printf("storage:        %zu bytes in columns, %zu bytes as AranetDataCompact\n",
+            columns.getMemoryUsage(), (size_t) count * sizeof(AranetDataCompact));
+        for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+            if (params & (1 << (param - 1))) decodeBench(param, 60000);
+        }
+    } else if (stream) {
+        printf("stream:         %u chunks, up to %u values, no record storage\n", checker.chunks, checker.maxChunk);
+    } else {
+        printf("storage:        %u bytes\n", (unsigned) (count * sizeof(AranetDataCompact)));
+    }
+    printf("errors:         %d\n", errors);
+
+    return (errors == 0 && recvd == count) ? 0 : 1;
+}
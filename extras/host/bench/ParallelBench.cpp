@@ -0,0 +1,144 @@
+/*
+ *  Downloads history from several simulated Aranet devices at the same
+ *  time, one Aranet4 instance and task per device, and checks that every
+ *  device received its own data. Controller allows one connection attempt
+ *  at a time, so tasks take turns to connect.
+ *
+ *  Name:       ParallelBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: ParallelBench [-d devices] [-n records] [-i interval_ms] [-1] [-S]
+ *    -d  number of devices (default 3, max CONFIG_BT_NIMBLE_MAX_CONNECTIONS)
+ *    -n  records stored in each device (default 500)
+ *    -i  connection interval in milliseconds (default 30)
+ *    -1  devices without V2 history (notification based V1 protocol)
+ *    -S  download devices one after another instead
+ */
+
+#include "Aranet4.h"
+#include "AranetSim.h"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+struct Job {
+    AranetSim*    sim;
+    Aranet4*      ar4;
+    uint16_t      params;
+    int           recvd = 0;
+    int           errors = 0;
+    unsigned long elapsed = 0;
+};
+
+static std::mutex connectLock;
+
+static void download(Job* job) {
+    AranetSim* sim = job->sim;
+    uint16_t count = sim->config.totalReadings;
+    unsigned long t0 = millis();
+
+    connectLock.lock();
+    ar4_err_t status = job->ar4->connect(sim->getAddress());
+    connectLock.unlock();
+
+    if (status != AR4_OK) {
+        printf("%s: connect failed\n", sim->name());
+        job->errors++;
+        return;
+    }
+
+    AranetDataCompact* data = (AranetDataCompact*) calloc(count, sizeof(AranetDataCompact));
+    job->recvd = job->ar4->getHistory(1, count, data, job->params);
+    job->ar4->disconnect();
+    job->elapsed = millis() - t0;
+
+    for (int i = 0; i < job->recvd; i++) {
+        if (data[i].aranet4.co2 != (uint16_t) sim->history(AR4_PARAM_CO2, i + 1)) job->errors++;
+        if (data[i].aranet4.temperature != (uint16_t) sim->history(AR4_PARAM_TEMPERATURE, i + 1)) job->errors++;
+        if (data[i].aranet4.pressure != (uint16_t) sim->history(AR4_PARAM_PRESSURE, i + 1)) job->errors++;
+        if (data[i].aranet4.humidity != (uint16_t) sim->history(AR4_PARAM_HUMIDITY, i + 1)) job->errors++;
+    }
+    free(data);
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = 3;
+    uint16_t records = 500;
+    uint32_t intervalMs = 30;
+    bool historyV2 = true;
+    bool sequential = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:i:1S")) != -1) {
+        switch (opt) {
+        case 'd': count = atoi(optarg); break;
+        case 'n': records = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        case '1': historyV2 = false; break;
+        case 'S': sequential = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d devices] [-n records] [-i interval_ms] [-1] [-S]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Aranet4::init();
+
+    std::vector<std::unique_ptr<AranetSim>> sims;
+    std::vector<std::unique_ptr<Aranet4>> clients;
+    std::vector<Job> jobs(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        AranetSimConfig cfg;
+        cfg.totalReadings = records;
+        cfg.capacity = records;
+        cfg.historyV2 = historyV2;
+        uint8_t mac[6] = { 0x10, 0x20, 0x30, 0x40, 0x50, (uint8_t) i };
+        sims.emplace_back(new AranetSim(NimBLEAddress(mac), cfg));
+        sims.back()->link.connIntervalUs = intervalMs * 1000;
+        // different log position per device, so mixed up data is detected
+        for (uint32_t m = 0; m < i * 7; m++) sims.back()->measure();
+
+        clients.emplace_back(new Aranet4(new BenchCallbacks()));
+        jobs[i].sim = sims.back().get();
+        jobs[i].ar4 = clients.back().get();
+        jobs[i].params = AR4_PARAM_FLAGS;
+    }
+
+    unsigned long t0 = millis();
+    if (sequential) {
+        for (Job& job : jobs) download(&job);
+    } else {
+        std::vector<std::thread> threads;
+        for (Job& job : jobs) threads.emplace_back(download, &job);
+        for (std::thread& t : threads) t.join();
+    }
+    unsigned long elapsed = millis() - t0;
+
+    int errors = 0;
+    uint32_t total = 0;
+    for (Job& job : jobs) {
+        printf("%s  %4d/%u records in %5lu ms, %d errors\n",
+            job.sim->getAddress().toString().c_str(), job.recvd, records, job.elapsed, job.errors);
+        errors += job.errors;
+        if (job.recvd != records) errors++;
+        total += job.recvd > 0 ? job.recvd : 0;
+    }
+
+    printf("mode:           %s, %s history\n", sequential ? "sequential" : "parallel", historyV2 ? "V2" : "V1");
+    printf("total:          %u records in %lu ms (%.1f records/s)\n", total, elapsed,
+        elapsed ? total * 1000.0 / elapsed : 0.0);
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/*
+ *  Gateway poll cycle against simulated Aranet device: connect, read
+ *  current readings and device info, disconnect. Compares getDeviceInfo()
+ *  with cached static info, getDeviceInfo() without cache and separate
+ *  getters, in round trips and time per cycle.
+ *
+ *  Name:       PollBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: PollBench [-t 4|2|r|rn] [-k cycles] [-i interval_ms]
+ *    -t  device type (default 4)
+ *    -k  poll cycles per mode (default 5)
+ *    -i  connection interval in milliseconds (default 30)
+ */
+
+#include "Aranet4.h"
+#include "AranetSim.h"
+
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+enum PollMode {
+    POLL_CACHED,    // getDeviceInfo(), static info from cache
+    POLL_UNCACHED,  // getDeviceInfo(), cache cleared before every cycle
+    POLL_GETTERS    // getName(), getSwVersion() ... one by one
+};
+
+static uint32_t roundTrips(const NimBLESimStats& a, const NimBLESimStats& b) {
+    return (b.reads - a.reads) + (b.writes - a.writes) + (b.discoveries - a.discoveries);
+}
+
+int main(int argc, char** argv) {
+    AranetSimConfig cfg;
+    uint32_t cycles = 5;
+    uint32_t intervalMs = 30;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:k:i:")) != -1) {
+        switch (opt) {
+        case 't':
+            if (strcmp(optarg, "2") == 0) cfg.type = ARANET2;
+            else if (strcmp(optarg, "r") == 0) cfg.type = ARANET_RADIATION;
+            else if (strcmp(optarg, "rn") == 0) cfg.type = ARANET_RADON;
+            else cfg.type = ARANET4;
+            break;
+        case 'k': cycles = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-t 4|2|r|rn] [-k cycles] [-i interval_ms]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Aranet4::init();
+
+    AranetSim sim(NimBLEAddress("00:01:02:03:04:05"), cfg);
+    sim.link.connIntervalUs = intervalMs * 1000;
+
+    Aranet4 ar4(new BenchCallbacks());
+    int errors = 0;
+
+    const char* names[] = { "getDeviceInfo cached", "getDeviceInfo no cache", "separate getters" };
+    printf("device:         %s, %u cycles per mode\n", sim.name(), cycles);
+    printf("%-24s %12s %12s\n", "mode", "rtt/cycle", "ms/cycle");
+
+    for (int mode = POLL_CACHED; mode <= POLL_GETTERS; mode++) {
+        Aranet4::clearDeviceInfoCache();
+        uint32_t rtts = 0;
+        unsigned long elapsed = 0;
+
+        // First cycle of cached mode fills cache, it is not measured
+        for (uint32_t c = 0; c < cycles + (mode == POLL_CACHED ? 1 : 0); c++) {
+            if (mode == POLL_UNCACHED) Aranet4::clearDeviceInfoCache();
+
+            NimBLESimStats before = sim.stats;
+            unsigned long t0 = millis();
+
+            if (ar4.connect(sim.getAddress()) != AR4_OK) {
+                printf("connect failed\n");
+                return 1;
+            }
+
+            AranetData cur = ar4.getCurrentReadings();
+            if (ar4.getStatus() != AR4_OK || cur.type != cfg.type) errors++;
+
+            AranetDeviceInfo info;
+            if (mode == POLL_GETTERS) {
+                memset(&info, 0, sizeof(info));
+                ar4.getName(info.name, sizeof(info.name));
+                ar4.getSwVersion(info.swVersion, sizeof(info.swVersion));
+                ar4.getFwVersion(info.fwVersion, sizeof(info.fwVersion));
+                ar4.getHwVersion(info.hwVersion, sizeof(info.hwVersion));
+                info.interval = ar4.getInterval();
+                info.totalReadings = ar4.getTotalReadings();
+                info.type = ar4.getType();
+            } else if (ar4.getDeviceInfo(&info) != AR4_OK) {
+                errors++;
+            }
+
+            ar4.disconnect();
+
+            if (strcmp(info.name, sim.name()) != 0 || info.type != cfg.type
+                || info.interval != sim.config.interval || info.totalReadings != sim.config.totalReadings) {
+                if (errors < 5) printf("%s: wrong device info\n", names[mode]);
+                errors++;
+            }
+
+            if (mode == POLL_CACHED && c == 0) continue;
+            elapsed += millis() - t0;
+            rtts += roundTrips(before, sim.stats);
+        }
+
+        printf("%-24s %12.1f %12.1f\n", names[mode], (double) rtts / cycles, (double) elapsed / cycles);
+    }
+
+    // Changing values are read again even when static info is cached
+    sim.config.capacity = sim.config.totalReadings + 1;
+    sim.measure();
+    if (ar4.connect(sim.getAddress()) == AR4_OK) {
+        AranetDeviceInfo info;
+        ar4.getDeviceInfo(&info);
+        if (info.totalReadings != sim.config.totalReadings) errors++;
+        ar4.disconnect();
+    } else {
+        errors++;
+    }
+
+    printf("errors:         %d\n", errors);
+    return errors == 0 ? 0 : 1;
+}
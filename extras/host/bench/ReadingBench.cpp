@@ -0,0 +1,201 @@
+/*
+ *  Memory of fleet state kept as AranetData compared with compact
+ *  AranetReading types, and pack/unpack cost. Checks that conversion to
+ *  compact reading and back does not change any field of device type.
+ *
+ *  Name:       ReadingBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: ReadingBench [-d devices] [-w window] [-n iterations]
+ *    -d  devices in fleet, mixed types (default 300)
+ *    -w  readings kept per device, including latest (default 12)
+ *    -n  pack/unpack iterations (default 10000000)
+ */
+
+#include "Aranet4.h"
+#include "AranetReading.h"
+#include "AranetDeviceTable.h"
+
+#include <chrono>
+#include <random>
+#include <unistd.h>
+
+static const AranetType types[] = { ARANET4, ARANET2, ARANET_RADIATION, ARANET_RADON };
+static const char* names[] = { "Aranet4", "Aranet2", "Radiation", "Radon" };
+
+// AranetData with random values in every field device type reports, zero elsewhere
+static AranetData randomData(AranetType type, std::mt19937_64& rng) {
+    AranetData d;
+    d.type = type;
+    d.battery = rng();
+    d.status = rng();
+    d.counter = rng();
+    d.interval = rng();
+    d.ago = rng();
+
+    switch (type) {
+    case ARANET4:
+        d.co2 = rng();
+        d.temperature = rng();
+        d.pressure = rng();
+        d.humidity = rng();
+        break;
+    case ARANET2:
+        d.temperature = rng();
+        d.humidity = rng();
+        break;
+    case ARANET_RADIATION:
+        d.radiation_pulses = rng();
+        d.radiation_rate = rng();
+        d.radiation_total = rng();
+        d.radiation_duration = rng();
+        break;
+    case ARANET_RADON:
+        d.radon_concentration = rng();
+        d.temperature = rng();
+        d.pressure = rng();
+        d.humidity = rng();
+        break;
+    default:
+        break;
+    }
+    return d;
+}
+
+static bool same(const AranetData& a, const AranetData& b) {
+    return memcmp((const void*) &a, (const void*) &b, sizeof(AranetData)) == 0;
+}
+
+template<typename R>
+static int checkTyped(AranetType type, std::mt19937_64& rng) {
+    int errors = 0;
+    for (int i = 0; i < 1000; i++) {
+        AranetData d = randomData(type, rng);
+        R r;
+        r.pack(d);
+        AranetData u;
+        r.unpack(u);
+        if (!same(d, u)) errors++;
+    }
+    return errors;
+}
+
+template<typename F>
+static double timeNs(uint32_t iterations, F fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) fn(i);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    uint32_t devices = 300;
+    uint32_t window = 12;
+    uint32_t iterations = 10000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:w:n:")) != -1) {
+        switch (opt) {
+        case 'd': devices = atoi(optarg); break;
+        case 'w': window = atoi(optarg); break;
+        case 'n': iterations = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d devices] [-w window] [-n iterations]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::mt19937_64 rng(1);
+    int errors = 0;
+
+    // Lossless conversion, typed readings and tagged reading
+    errors += checkTyped<AranetReading4>(ARANET4, rng);
+    errors += checkTyped<AranetReading2>(ARANET2, rng);
+    errors += checkTyped<AranetReadingRadiation>(ARANET_RADIATION, rng);
+    errors += checkTyped<AranetReadingRadon>(ARANET_RADON, rng);
+
+    uint8_t buf[sizeof(AranetReading)];
+    for (int i = 0; i < 4000; i++) {
+        AranetData d = randomData(types[i % 4], rng);
+        AranetReading r = AranetReading();
+        r.pack(d);
+        if (!same(d, r.toData())) errors++;
+
+        // serialized form keeps only bytes of type
+        AranetReading s = AranetReading();
+        uint8_t n = r.write(buf, sizeof(buf));
+        if (n != r.size() || s.read(buf, n) != n || !same(d, s.toData())) errors++;
+        if (s.read(buf, n - 1) != 0) errors++;
+    }
+
+    // Device table keeps latest reading
+    AranetDeviceTable<8> table;
+    AranetData last = randomData(ARANET_RADON, rng);
+    uint8_t addr[6] = { 1, 2, 3, 4, 5, 6 };
+    table.update(addr, last);
+    AranetDeviceEntry* e = table.find(addr);
+    if (e == nullptr || !same(last, e->reading.toData())) errors++;
+
+    // Window keeps last N in order
+    AranetReadingWindow<AranetReading4, 5> win;
+    AranetData pushed[8];
+    for (int i = 0; i < 8; i++) {
+        pushed[i] = randomData(ARANET4, rng);
+        win.push(pushed[i]);
+    }
+    for (int i = 0; i < 5; i++) {
+        AranetData u;
+        win.at(i).unpack(u);
+        if (!same(u, pushed[3 + i])) errors++;
+    }
+
+    printf("%-24s %8s %8s\n", "bytes per reading", "typed", "tagged");
+    printf("%-24s %8zu %8zu\n", "AranetData", sizeof(AranetData), sizeof(AranetData));
+    printf("%-24s %8s %8zu\n", "AranetReading", "", sizeof(AranetReading));
+    for (int i = 0; i < 4; i++) {
+        printf("%-24s %8u %8u\n", names[i], AranetReading::sizeOf(types[i]) - 1, AranetReading::sizeOf(types[i]));
+    }
+    printf("%-24s %8zu %8s\n", "AranetDeviceEntry", sizeof(AranetDeviceEntry), "");
+
+    // Fleet: equal share of each type, window per device
+    size_t full = 0, tagged = 0, typed = 0, packed = 0;
+    for (uint32_t i = 0; i < devices; i++) {
+        AranetType type = types[i % 4];
+        uint8_t size = AranetReading::sizeOf(type);
+        full += window * sizeof(AranetData);
+        tagged += window * sizeof(AranetReading);
+        typed += window * (size - 1) + 1;  // typed window, type stored once
+        packed += window * size;
+    }
+    printf("fleet:          %u devices x %u readings\n", devices, window);
+    printf("  AranetData:   %8zu bytes\n", full);
+    printf("  tagged:       %8zu bytes\n", tagged);
+    printf("  serialized:   %8zu bytes\n", packed);
+    printf("  typed:        %8zu bytes (%.1fx smaller)\n", typed, typed ? (double) full / typed : 0.0);
+
+    // Conversion cost
+    AranetData src[4];
+    AranetReading dst[4];
+    for (int i = 0; i < 4; i++) {
+        src[i] = randomData(types[i], rng);
+        dst[i].pack(src[i]);
+    }
+    volatile uint32_t sink = 0;
+    double tPack = timeNs(iterations, [&](uint32_t i) {
+        AranetReading r;
+        r.pack(src[i & 3]);
+        sink += r.getCounter();
+    });
+    double tUnpack = timeNs(iterations, [&](uint32_t i) {
+        AranetData d;
+        dst[i & 3].unpack(d);
+        sink += d.counter;
+    });
+    printf("pack:           %.2f ns\n", tPack);
+    printf("unpack:         %.2f ns\n", tUnpack);
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
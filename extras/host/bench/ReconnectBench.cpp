@@ -0,0 +1,149 @@
+/*
+ *  Reconnect cycle to bonded device: connect, encrypt, read current readings
+ *  and log size, disconnect. Compares attribute discovery on every
+ *  connection with fast reconnect (handles from cache), split in to
+ *  connect, encryption, discovery and read time. Also checks that cache
+ *  entry is dropped when device attributes change.
+ *
+ *  Name:       ReconnectBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: ReconnectBench [-t 4|2|r|rn] [-k cycles] [-i interval_ms]
+ *    -t  device type (default 4)
+ *    -k  reconnect cycles per mode (default 5)
+ *    -i  connection interval in milliseconds (default 30)
+ */
+
+#include "Aranet4.h"
+#include "AranetSim.h"
+
+#include <memory>
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+static uint32_t roundTrips(const NimBLESimStats& a, const NimBLESimStats& b) {
+    return (b.reads - a.reads) + (b.writes - a.writes) + (b.discoveries - a.discoveries);
+}
+
+struct Cycle {
+    double connect = 0;
+    double secure = 0;
+    double discovery = 0;
+    double reads = 0;
+    double total = 0;
+    double rtts = 0;
+};
+
+int main(int argc, char** argv) {
+    AranetSimConfig cfg;
+    uint32_t cycles = 5;
+    uint32_t intervalMs = 30;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:k:i:")) != -1) {
+        switch (opt) {
+        case 't':
+            if (strcmp(optarg, "2") == 0) cfg.type = ARANET2;
+            else if (strcmp(optarg, "r") == 0) cfg.type = ARANET_RADIATION;
+            else if (strcmp(optarg, "rn") == 0) cfg.type = ARANET_RADON;
+            else cfg.type = ARANET4;
+            break;
+        case 'k': cycles = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-t 4|2|r|rn] [-k cycles] [-i interval_ms]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cycles < 1) cycles = 1;
+
+    Aranet4::init();
+
+    NimBLEAddress addr("00:01:02:03:04:05");
+    std::unique_ptr<AranetSim> sim(new AranetSim(addr, cfg));
+    sim->link.connIntervalUs = intervalMs * 1000;
+
+    Aranet4 ar4(new BenchCallbacks());
+    int errors = 0;
+
+    // Pair once, gateway in use is already bonded
+    if (ar4.connect(addr) != AR4_OK) errors++;
+    ar4.disconnect();
+
+    const char* names[] = { "discovery every time", "fast reconnect" };
+    printf("device:         %s, %u cycles per mode\n", sim->name(), cycles);
+    printf("%-22s %9s %9s %9s %9s %9s %9s\n", "mode", "connect", "encrypt", "discover", "reads", "ms/cycle", "rtt");
+
+    for (int mode = 0; mode < 2; mode++) {
+        Aranet4::clearGattCache();
+        ar4.setFastReconnect(mode == 1);
+        Cycle sum;
+
+        // First fast cycle fills cache, it is not measured
+        for (uint32_t c = 0; c < cycles + mode; c++) {
+            NimBLESimStats before = sim->stats;
+            unsigned long t0 = millis();
+
+            if (ar4.connect(addr) != AR4_OK) {
+                printf("connect failed\n");
+                return 1;
+            }
+            unsigned long t1 = millis();
+
+            AranetData cur = ar4.getCurrentReadings();
+            if (ar4.getStatus() != AR4_OK || cur.type != cfg.type) errors++;
+            if (ar4.getTotalReadings() != sim->config.totalReadings) errors++;
+            unsigned long t2 = millis();
+
+            AranetConnectStats stats = ar4.getConnectStats();
+            ar4.disconnect();
+
+            if (stats.cached != (mode == 1 && c > 0)) errors++;
+            if (mode == 1 && c == 0) continue;
+
+            sum.connect += stats.connect;
+            sum.secure += stats.secure;
+            sum.discovery += stats.discovery;
+            sum.reads += (t2 - t1) - stats.discovery;
+            sum.total += t2 - t0;
+            sum.rtts += roundTrips(before, sim->stats);
+        }
+
+        printf("%-22s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", names[mode],
+            sum.connect / cycles, sum.secure / cycles, sum.discovery / cycles,
+            sum.reads / cycles, sum.total / cycles, sum.rtts / cycles);
+    }
+
+    // Device changes attributes (here: no V2 history anymore). Stale handle
+    // is discovered again within same call, history falls back to V1 and
+    // cache entry is replaced, next connection uses new handles.
+    cfg.historyV2 = false;
+    sim.reset();
+    sim.reset(new AranetSim(addr, cfg));
+    sim->link.connIntervalUs = intervalMs * 1000;
+
+    AranetDataCompact data[10];
+    int stale = -1;
+    int fresh = -1;
+    if (ar4.connect(addr) == AR4_OK) {
+        stale = ar4.getHistory(1, 10, data);
+        ar4.disconnect();
+    }
+    if (ar4.connect(addr) == AR4_OK) {
+        fresh = ar4.getHistory(1, 10, data);
+        if (!ar4.getConnectStats().cached) errors++;
+        ar4.disconnect();
+    }
+    if (stale != 10 || fresh != 10) errors++;
+    printf("changed device: stale handles got %d records, next connection %d\n", stale, fresh);
+
+    printf("errors:         %d\n", errors);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/*
+ *  Measures latency from new measurement on simulated Aranet devices to
+ *  decoded data reaching application. Compares AranetScanner continuous
+ *  ingestion with periodic blocking scan (examples/Scanner flow).
+ *
+ *  Name:       ScanBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: ScanBench [-d devices] [-a adv_interval_ms] [-p period_ms] [-s seconds] [-w window_s] [-P] [-F]
+ *    -d  number of simulated devices (default 8)
+ *    -a  advertising interval in milliseconds (default 100)
+ *    -p  measurement period of devices in milliseconds (default 1000)
+ *    -s  test duration in seconds (default 12)
+ *    -w  scan window of periodic scan in seconds (default 5)
+ *    -P  periodic blocking scan instead of AranetScanner
+ *    -F  disable AranetScanner change filter
+ */
+
+#include "Aranet4.h"
+#include "AranetScanner.h"
+#include "AranetSim.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+struct DeviceState {
+    AranetSim* sim;
+    uint64_t   measuredAt[256];  // by advertisement counter
+    int        lastCounter = -1;
+};
+
+static std::mutex stateLock;
+static std::vector<DeviceState> devices;
+static uint32_t delivered = 0;
+static uint32_t updates = 0;
+static uint64_t latencySum = 0;
+static uint64_t latencyMax = 0;
+
+static void process(NimBLEAdvertisedDevice* adv, AranetManufacturerData* mfdata) {
+    std::lock_guard<std::mutex> lk(stateLock);
+    delivered++;
+
+    for (DeviceState& dev : devices) {
+        if (!(dev.sim->getAddress() == adv->getAddress())) continue;
+        if (dev.lastCounter == mfdata->data.counter) return;
+
+        dev.lastCounter = mfdata->data.counter;
+        uint64_t at = dev.measuredAt[mfdata->data.counter];
+        if (at == 0) return;
+
+        uint64_t latency = NimBLESim::nowUs() - at;
+        latencySum += latency;
+        if (latency > latencyMax) latencyMax = latency;
+        updates++;
+        return;
+    }
+}
+
+class BenchCallbacks : public AranetScannerCallbacks {
+    void onAranetData(NimBLEAdvertisedDevice* adv, AranetManufacturerData* mfdata) {
+        process(adv, mfdata);
+    }
+};
+
+int main(int argc, char** argv) {
+    uint32_t count = 8;
+    uint32_t advIntervalMs = 100;
+    uint32_t periodMs = 1000;
+    uint32_t seconds = 12;
+    uint32_t windowS = 5;
+    bool periodic = false;
+    bool changeFilter = true;
+    uint32_t received = 0;
+    uint32_t unchanged = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:a:p:s:w:PF")) != -1) {
+        switch (opt) {
+        case 'd': count = atoi(optarg); break;
+        case 'a': advIntervalMs = atoi(optarg); break;
+        case 'p': periodMs = atoi(optarg); break;
+        case 's': seconds = atoi(optarg); break;
+        case 'w': windowS = atoi(optarg); break;
+        case 'P': periodic = true; break;
+        case 'F': changeFilter = false; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d devices] [-a adv_interval_ms] [-p period_ms] [-s seconds] [-w window_s] [-P] [-F]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Aranet4::init();
+
+    const AranetType types[] = { ARANET4, ARANET2, ARANET_RADIATION, ARANET_RADON };
+    std::vector<std::unique_ptr<AranetSim>> sims;
+    devices.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        AranetSimConfig cfg;
+        cfg.type = types[i % 4];
+        uint8_t mac[6] = { 0x10, 0x20, 0x30, 0x40, (uint8_t) (i >> 8), (uint8_t) i };
+        sims.emplace_back(new AranetSim(NimBLEAddress(mac), cfg));
+        sims.back()->link.advIntervalUs = advIntervalMs * 1000;
+        devices[i].sim = sims.back().get();
+        memset(devices[i].measuredAt, 0, sizeof(devices[i].measuredAt));
+    }
+
+    // Devices take new measurement every period, staggered
+    std::atomic<bool> done(false);
+    std::thread driver([&] {
+        uint64_t start = NimBLESim::nowUs();
+        uint64_t next[count];
+        for (uint32_t i = 0; i < count; i++) next[i] = start + (uint64_t) periodMs * 1000 * (i + 1) / count;
+
+        while (!done) {
+            uint64_t now = NimBLESim::nowUs();
+            for (uint32_t i = 0; i < count; i++) {
+                if (now < next[i]) continue;
+                std::lock_guard<std::recursive_mutex> simLk(NimBLESim::lock());
+                std::lock_guard<std::mutex> lk(stateLock);
+                devices[i].sim->measure();
+                devices[i].measuredAt[devices[i].sim->config.counter] = NimBLESim::nowUs();
+                next[i] += (uint64_t) periodMs * 1000;
+            }
+            NimBLESim::sleepUntil(now + 1000);
+        }
+    });
+
+    uint64_t end = NimBLESim::nowUs() + (uint64_t) seconds * 1000000;
+
+    if (periodic) {
+        NimBLEScan* pScan = NimBLEDevice::getScan();
+        pScan->setActiveScan(true);
+        while (NimBLESim::nowUs() < end) {
+            pScan->start(windowS);
+            NimBLEScanResults results = pScan->getResults();
+            for (int i = 0; i < results.getCount(); i++) {
+                NimBLEAdvertisedDevice adv = results.getDevice(i);
+                AranetManufacturerData mfdata;
+                if (mfdata.fromAdvertisement(&adv)) process(&adv, &mfdata);
+            }
+        }
+    } else {
+        BenchCallbacks callbacks;
+        AranetScanner scanner(&callbacks);
+        scanner.setChangeFilter(changeFilter);
+        scanner.begin();
+        NimBLESim::sleepUntil(end);
+        scanner.end();
+        received = scanner.getAdvertisementCount();
+        unchanged = scanner.getUnchangedCount();
+    }
+
+    done = true;
+    driver.join();
+
+    std::lock_guard<std::mutex> lk(stateLock);
+    printf("mode:           %s\n", periodic ? "periodic scan" : "AranetScanner");
+    printf("devices:        %u, adv every %u ms, measurement every %u ms\n", count, advIntervalMs, periodMs);
+    if (!periodic) {
+        printf("advs received:  %u\n", received);
+        printf("advs unchanged: %u (skipped before decode)\n", unchanged);
+    }
+    printf("advs delivered: %u\n", delivered);
+    printf("updates seen:   %u\n", updates);
+    if (updates > 0) {
+        printf("latency avg:    %.1f ms\n", latencySum / 1000.0 / updates);
+        printf("latency max:    %.1f ms\n", latencyMax / 1000.0);
+    }
+
+    return updates > 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+/*
+ *  Polls of simulated fleet over virtual time: fixed timer compared with
+ *  AranetPollScheduler aligned to measurements. Reports connections,
+ *  polls that got no new measurement, freshness (measurement to fetch
+ *  latency) and measurements never fetched. Also times scheduler
+ *  operations against linear scan of due times.
+ *
+ *  Name:       ScheduleBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: ScheduleBench [-d devices] [-p period_s] [-h hours] [-n iterations]
+ *    -d  devices, intervals of 60, 120, 300 and 600 s (default 500)
+ *    -p  fixed timer period in seconds (default 60)
+ *    -h  simulated hours (default 24)
+ *    -n  timed scheduler operations (default 1000000)
+ */
+
+#include "Aranet4.h"
+#include "AranetPollScheduler.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#define BENCH_DEVICES 1000
+
+struct Sensor {
+    uint8_t  addr[6];
+    uint16_t interval;  // s
+    uint32_t phase;     // ms of first measurement
+    uint32_t fetched;   // measurements fetched
+    int64_t  last;      // measurement index of last fetch, -1 none
+
+    // Index of last measurement at time t, -1 if none yet
+    int64_t measurement(uint64_t t) const {
+        if (t < phase) return -1;
+        return (t - phase) / (interval * 1000ULL);
+    }
+
+    uint64_t measuredAt(int64_t m) const {
+        return phase + m * interval * 1000ULL;
+    }
+
+    AranetData data(uint64_t t) const {
+        AranetData d;
+        d.interval = interval;
+        d.ago = (t - measuredAt(measurement(t))) / 1000;
+        return d;
+    }
+};
+
+struct Result {
+    uint64_t polls = 0;
+    uint64_t stale = 0;     // no new measurement since last fetch
+    uint64_t missed = 0;    // measurements never fetched
+    double   latency = 0;   // mean ms from measurement to fetch
+    uint64_t fetched = 0;
+};
+
+static void fetch(Sensor& s, uint64_t t, Result& r) {
+    int64_t m = s.measurement(t);
+    r.polls++;
+    if (m < 0 || m == s.last) {
+        r.stale++;
+        return;
+    }
+    if (s.last >= 0) r.missed += m - s.last - 1;
+    r.latency += t - s.measuredAt(m);
+    r.fetched++;
+    s.last = m;
+}
+
+static void finish(Result& r) {
+    if (r.fetched) r.latency /= r.fetched;
+}
+
+static AranetPollScheduler<BENCH_DEVICES> scheduler;
+
+int main(int argc, char** argv) {
+    uint32_t count = 500;
+    uint32_t period = 60;
+    uint32_t hours = 24;
+    uint32_t iterations = 1000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:p:h:n:")) != -1) {
+        switch (opt) {
+        case 'd': count = atoi(optarg); break;
+        case 'p': period = atoi(optarg); break;
+        case 'h': hours = atoi(optarg); break;
+        case 'n': iterations = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d devices] [-p period_s] [-h hours] [-n iterations]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (count > BENCH_DEVICES) count = BENCH_DEVICES;
+
+    static const uint16_t intervals[] = { 60, 120, 300, 600 };
+    std::mt19937 rng(1);
+    std::vector<Sensor> sensors(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Sensor& s = sensors[i];
+        for (int b = 0; b < 6; b++) s.addr[b] = rng();
+        s.addr[0] = i;
+        s.addr[1] = i >> 8;
+        s.interval = intervals[i % 4];
+        s.phase = rng() % (s.interval * 1000);
+    }
+
+    uint64_t end = hours * 3600000ULL;
+    int errors = 0;
+
+    // Fixed timer, every device each period
+    Result fixed;
+    for (Sensor& s : sensors) s.last = -1;
+    for (uint64_t t = 0; t < end; t += period * 1000ULL) {
+        for (Sensor& s : sensors) fetch(s, t, fixed);
+    }
+    finish(fixed);
+
+    // Scheduler: first poll on discovery, then after every measurement.
+    // Virtual time starts at value near millis() wrap.
+    uint32_t base = 0xFFFFFFFF - 3600000;
+    Result aligned;
+    for (Sensor& s : sensors) {
+        s.last = -1;
+        scheduler.schedule(s.addr, base);
+    }
+    uint64_t t = 0;
+    while (t < end) {
+        AranetPollEntry* e = scheduler.next(base + (uint32_t) t);
+        if (e == nullptr) {
+            t += scheduler.timeToNext(base + (uint32_t) t);
+            continue;
+        }
+        uint16_t id = e->addr[0] | (e->addr[1] << 8);
+        Sensor& s = sensors[id];
+        fetch(s, t, aligned);
+        if (s.measurement(t) >= 0) scheduler.update(s.addr, s.data(t), base + (uint32_t) t);
+    }
+    finish(aligned);
+
+    if (scheduler.size() != count) errors++;
+
+    printf("devices:        %u, %u h, fixed period %u s\n", count, hours, period);
+    printf("%-12s %10s %10s %10s %12s\n", "mode", "polls", "stale", "missed", "latency ms");
+    printf("%-12s %10llu %10llu %10llu %12.0f\n", "fixed", (unsigned long long) fixed.polls,
+        (unsigned long long) fixed.stale, (unsigned long long) fixed.missed, fixed.latency);
+    printf("%-12s %10llu %10llu %10llu %12.0f\n", "scheduler", (unsigned long long) aligned.polls,
+        (unsigned long long) aligned.stale, (unsigned long long) aligned.missed, aligned.latency);
+
+    // Aligned polls are only late by margin and never miss measurement
+    if (aligned.missed != 0 || aligned.latency > ARANET_POLL_MARGIN + 1000) errors++;
+
+    // Heap order against linear scan, with removals
+    std::vector<uint32_t> due(count);
+    for (uint32_t i = 0; i < count; i++) {
+        due[i] = base + rng() % 600000;
+        scheduler.schedule(sensors[i].addr, due[i]);
+    }
+    for (uint32_t i = 0; i < count; i += 7) {
+        if (!scheduler.remove(sensors[i].addr)) errors++;
+        due[i] = 0;
+    }
+    uint32_t last = 0;
+    bool first = true;
+    while (scheduler.size() > 0) {
+        AranetPollEntry* e = scheduler.peek();
+        uint16_t id = e->addr[0] | (e->addr[1] << 8);
+        if (due[id] != e->due || (!first && (int32_t) (e->due - last) < 0)) errors++;
+        last = e->due;
+        first = false;
+        scheduler.remove(e->addr);
+    }
+
+    // Operation cost: reschedule random device, then find earliest
+    for (uint32_t i = 0; i < count; i++) scheduler.schedule(sensors[i].addr, due[i] = rng());
+    volatile uint32_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        scheduler.schedule(sensors[i % count].addr, i * 2654435761u);
+        sink += scheduler.peek()->due;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        due[i % count] = i * 2654435761u;
+        uint32_t best = 0;
+        for (uint32_t j = 1; j < count; j++) {
+            if ((int32_t) (due[j] - due[best]) < 0) best = j;
+        }
+        sink += due[best];
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    printf("reschedule + earliest:  heap %.1f ns, linear scan %.1f ns\n",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / iterations);
+    // Full scheduler, lookup of address that is not scheduled (new advertiser)
+    scheduler.clear();
+    uint8_t addr[6];
+    for (uint32_t i = 0; i < BENCH_DEVICES; i++) {
+        for (int b = 0; b < 6; b++) addr[b] = rng();
+        addr[5] = 0;
+        if (scheduler.schedule(addr, rng()) == nullptr) errors++;
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int b = 0; b < 5; b++) addr[b] = i >> (b * 4);
+        addr[5] = 1;
+        if (scheduler.find(addr) != nullptr) errors++;
+    }
+    auto t4 = std::chrono::steady_clock::now();
+    printf("full (%u), lookup of unknown address: %.1f ns\n", (uint32_t) BENCH_DEVICES,
+        std::chrono::duration<double, std::nano>(t4 - t3).count() / iterations);
+
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
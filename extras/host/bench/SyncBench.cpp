@@ -0,0 +1,157 @@
+/*
+ *  Repeated history sync of simulated Aranet4, like gateway that wakes up
+ *  every few measurements. Compares incremental syncHistory() with
+ *  downloading whole log every cycle and checks that every measurement is
+ *  received exactly once, also after log wraps.
+ *
+ *  Name:       SyncBench.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Usage: SyncBench [-n records] [-c capacity] [-k cycles] [-m measurements] [-i interval_ms] [-1]
+ *    -n  records stored in device at start (default 2016)
+ *    -c  log capacity of device (default 2016)
+ *    -k  sync cycles (default 10)
+ *    -m  new measurements between syncs (default 3)
+ *    -i  connection interval in milliseconds (default 30)
+ *    -1  device without V2 history (notification based V1 protocol)
+ */
+
+#include "Aranet4.h"
+#include "AranetSim.h"
+
+#include <unistd.h>
+
+class BenchCallbacks : public Aranet4Callbacks {
+    uint32_t onPinRequested() {
+        return 123456;
+    }
+};
+
+// Expects every measurement once, in order. First stored record is measurement 1.
+class SyncChecker : public AranetHistoryCallbacks {
+public:
+    uint32_t measurement = 1;
+    uint32_t records = 0;
+    int      errors = 0;
+
+    bool onHistoryRecords(uint16_t start, AranetDataCompact* recs, uint16_t count) {
+        for (uint16_t i = 0; i < count; i++, measurement++) {
+            AranetDataCompact& r = recs[i];
+            if (r.aranet4.co2 != (uint16_t) AranetSim::value(AR4_PARAM_CO2, measurement)
+                || r.aranet4.temperature != (uint16_t) AranetSim::value(AR4_PARAM_TEMPERATURE, measurement)
+                || r.aranet4.pressure != (uint16_t) AranetSim::value(AR4_PARAM_PRESSURE, measurement)
+                || r.aranet4.humidity != (uint16_t) AranetSim::value(AR4_PARAM_HUMIDITY, measurement)) {
+                if (errors < 5) printf("mismatch: log index %u, expected measurement %u\n", start + i, measurement);
+                errors++;
+            }
+        }
+        records += count;
+        return true;
+    }
+};
+
+static uint32_t roundTrips(const NimBLESimStats& a, const NimBLESimStats& b) {
+    return (b.reads - a.reads) + (b.writes - a.writes) + (b.writesNoRsp - a.writesNoRsp);
+}
+
+int main(int argc, char** argv) {
+    AranetSimConfig cfg;
+    uint32_t cycles = 10;
+    uint32_t perCycle = 3;
+    uint32_t intervalMs = 30;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:k:m:i:1")) != -1) {
+        switch (opt) {
+        case 'n': cfg.totalReadings = atoi(optarg); break;
+        case 'c': cfg.capacity = atoi(optarg); break;
+        case 'k': cycles = atoi(optarg); break;
+        case 'm': perCycle = atoi(optarg); break;
+        case 'i': intervalMs = atoi(optarg); break;
+        case '1': cfg.historyV2 = false; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n records] [-c capacity] [-k cycles] [-m measurements] [-i interval_ms] [-1]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (cfg.totalReadings > cfg.capacity) cfg.totalReadings = cfg.capacity;
+
+    Aranet4::init();
+
+    AranetSim sim(NimBLEAddress("00:01:02:03:04:05"), cfg);
+    sim.link.connIntervalUs = intervalMs * 1000;
+
+    Aranet4 ar4(new BenchCallbacks());
+    if (ar4.connect(sim.getAddress()) != AR4_OK) {
+        printf("connect failed\n");
+        return 1;
+    }
+
+    // Gateway clock, unix seconds. Newest record was measured sim.config.ago seconds ago.
+    uint32_t measured = 1760000000;
+    uint32_t now = measured + sim.config.ago;
+
+    AranetHistoryCursor cursor;
+    memset(&cursor, 0, sizeof(cursor));
+    SyncChecker checker;
+    int errors = 0;
+
+    NimBLESimStats before = sim.stats;
+    unsigned long t0 = millis();
+    int recvd = ar4.syncHistory(&cursor, now, &checker);
+    unsigned long tFirst = millis() - t0;
+    uint32_t rttFirst = roundTrips(before, sim.stats);
+    if (recvd != cfg.totalReadings) errors++;
+
+    unsigned long tSync = 0;
+    uint32_t rttSync = 0;
+    uint32_t synced = 0;
+
+    for (uint32_t c = 0; c < cycles; c++) {
+        for (uint32_t m = 0; m < perCycle; m++) {
+            sim.measure();
+            measured += cfg.interval;
+        }
+        sim.config.ago = (c * 37) % cfg.interval;
+        now = measured + sim.config.ago;
+
+        before = sim.stats;
+        t0 = millis();
+        recvd = ar4.syncHistory(&cursor, now, &checker);
+        tSync += millis() - t0;
+        rttSync += roundTrips(before, sim.stats);
+
+        if (recvd != (int) perCycle) {
+            printf("cycle %u: synced %d records, expected %u\n", c + 1, recvd, perCycle);
+            errors++;
+        }
+        synced += recvd > 0 ? recvd : 0;
+    }
+
+    // Same cycle without cursor: whole log is downloaded again
+    before = sim.stats;
+    t0 = millis();
+    SyncChecker full;
+    full.measurement = checker.measurement - sim.config.totalReadings;
+    int fullRecvd = ar4.getHistoryRecords(1, sim.config.totalReadings, &full);
+    unsigned long tFull = millis() - t0;
+    uint32_t rttFull = roundTrips(before, sim.stats);
+
+    ar4.disconnect();
+
+    errors += checker.errors + full.errors;
+    if (checker.records != cfg.totalReadings + synced) errors++;
+
+    printf("device:         %s (%s history), %u records, capacity %u\n", sim.name(),
+        cfg.historyV2 ? "V2" : "V1", cfg.totalReadings, cfg.capacity);
+    printf("first sync:     %u records in %lu ms, %u round trips\n", cfg.totalReadings, tFirst, rttFirst);
+    printf("incremental:    %u cycles x %u records, %.1f ms and %.1f round trips per cycle\n",
+        cycles, perCycle, cycles ? (double) tSync / cycles : 0.0, cycles ? (double) rttSync / cycles : 0.0);
+    printf("full download:  %d records in %lu ms, %u round trips per cycle\n", fullRecvd, tFull, rttFull);
+    printf("errors:         %d\n", errors);
+
+    return errors == 0 ? 0 : 1;
+}
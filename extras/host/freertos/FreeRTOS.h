@@ -0,0 +1,58 @@
+/*
+ *  Name:       FreeRTOS.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Host stand-in for the FreeRTOS primitives used by this library.
+ *  One tick is one millisecond.
+ */
+
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define pdFALSE   0
+#define pdTRUE    1
+#define pdPASS    pdTRUE
+#define pdFAIL    pdFALSE
+
+#define portMAX_DELAY       ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS  ((TickType_t) 1)
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+
+typedef struct HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void          vQueueDelete(QueueHandle_t queue);
+BaseType_t    xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t    xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait);
+BaseType_t    xQueueReset(QueueHandle_t queue);
+UBaseType_t   uxQueueMessagesWaiting(QueueHandle_t queue);
+
+typedef struct HostSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+void              vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t sem);
+
+typedef struct HostTaskHandle* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// Task runs in its own thread. Stack size and priority are ignored.
+BaseType_t    xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                          void* param, UBaseType_t priority, TaskHandle_t* handle);
+// Only deleting calling task (NULL) is supported; task function must return after it
+void          vTaskDelete(TaskHandle_t task);
+TickType_t    xTaskGetTickCount();
+void          vTaskDelay(TickType_t ticks);
+
+#endif
@@ -6,19 +6,262 @@
  */
 
 #include "Aranet4.h"
+#include "AranetHistoryColumns.h"
 #include "Arduino.h"
 
-// Queue to store history data
-QueueHandle_t Aranet4::historyQueue = xQueueCreate(120, sizeof(uint16_t));
+// Most records buffered by getHistoryRecords(). Holds widest V2 chunk at
+// any MTU (count is one byte), fewer rows are used if chunks are smaller.
+#define HISTORY_ROWS 256
+
+// Stores streamed history of one parameter in AranetDataCompact array
+class CompactHistoryWriter : public AranetHistoryCallbacks {
+public:
+    CompactHistoryWriter(AranetDataCompact* data, uint16_t start) : data(data), start(start) {}
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        AranetDataCompact* dst = data + (chunk->start - start);
+        for (uint16_t i = 0; i < chunk->count; i++) {
+            dst[i].set(chunk->param, chunk->get(i));
+        }
+        return true;
+    }
+private:
+    AranetDataCompact* data;
+    uint16_t start;
+};
+
+// Stores streamed history in ring of records, indexed by log index.
+// Values at or past limit are dropped.
+class RowHistoryWriter : public AranetHistoryCallbacks {
+public:
+    RowHistoryWriter(AranetDataCompact* rows, uint16_t size) : rows(rows), size(size) {}
+
+    uint32_t limit = 0;
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        for (uint16_t i = 0; i < chunk->count; i++) {
+            uint32_t idx = chunk->start + i;
+            if (idx >= limit) break;
+            rows[idx % size].set(chunk->param, chunk->get(i));
+        }
+        return true;
+    }
+private:
+    AranetDataCompact* rows;
+    uint16_t size;
+};
+
+// Stores complete records with measurement time
+class TimedRecordWriter : public AranetHistoryCallbacks {
+public:
+    TimedRecordWriter(AranetHistoryRecord* records, const AranetHistoryTimeline* timeline, uint16_t start)
+        : records(records), timeline(timeline), start(start) {}
+
+    bool onHistoryRecords(uint16_t first, AranetDataCompact* recs, uint16_t count) {
+        for (uint16_t i = 0; i < count; i++) {
+            AranetHistoryRecord& rec = records[first + i - start];
+            rec.time = timeline->timeOf(first + i);
+            rec.data = recs[i];
+        }
+        return true;
+    }
+private:
+    AranetHistoryRecord* records;
+    const AranetHistoryTimeline* timeline;
+    uint16_t start;
+};
+
+// Stores streamed history of one parameter in uint16_t array
+class U16HistoryWriter : public AranetHistoryCallbacks {
+public:
+    U16HistoryWriter(uint16_t* data, uint16_t start) : data(data), start(start) {}
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk) {
+        uint16_t* dst = data + (chunk->start - start);
+        if (chunk->width == sizeof(uint16_t)) {
+            memcpy(dst, chunk->values, chunk->count * sizeof(uint16_t));
+        } else {
+            for (uint16_t i = 0; i < chunk->count; i++) dst[i] = chunk->get(i);
+        }
+        return true;
+    }
+private:
+    uint16_t* data;
+    uint16_t start;
+};
+
+// Static info of recently seen devices, shared by all Aranet4 instances.
+// Oldest entry is replaced when full.
+static AranetDeviceInfo  infoCache[ARANET_INFO_CACHE_SIZE];
+static uint8_t           infoCacheCount = 0;
+static uint8_t           infoCacheNext = 0;
+
+// Attribute handles of recently connected devices, same replacement
+static AranetGattHandles gattCache[ARANET_GATT_CACHE_SIZE];
+static uint8_t           gattCacheCount = 0;
+static uint8_t           gattCacheNext = 0;
+
+// Guards both caches. Created on first use, also before init(). Static
+// initialization is thread safe.
+static SemaphoreHandle_t cacheLock() {
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    return lock;
+}
+
+static void lockCache() {
+    xSemaphoreTake(cacheLock(), portMAX_DELAY);
+}
+
+static void unlockCache() {
+    xSemaphoreGive(cacheLock());
+}
+
+/**
+ * @brief Copy cached static info of device
+ * @param [in] addr Device address
+ * @param [out] info Cached info, interval and totalReadings are not set
+ * @return true if device is in cache
+ */
+static bool findCachedInfo(const uint8_t* addr, AranetDeviceInfo* info) {
+    bool found = false;
+    lockCache();
+    for (uint8_t i = 0; i < infoCacheCount; i++) {
+        if (memcmp(infoCache[i].addr, addr, sizeof(infoCache[i].addr)) == 0) {
+            *info = infoCache[i];
+            found = true;
+            break;
+        }
+    }
+    unlockCache();
+    return found;
+}
+
+/**
+ * @brief Add or replace static info of device in cache
+ */
+static void storeCachedInfo(const AranetDeviceInfo* info) {
+    lockCache();
+    uint8_t slot = infoCacheCount;
+    for (uint8_t i = 0; i < infoCacheCount; i++) {
+        if (memcmp(infoCache[i].addr, info->addr, sizeof(info->addr)) == 0) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot == infoCacheCount) {
+        if (infoCacheCount < ARANET_INFO_CACHE_SIZE) {
+            infoCacheCount++;
+        } else {
+            slot = infoCacheNext;
+            infoCacheNext = (infoCacheNext + 1) % ARANET_INFO_CACHE_SIZE;
+        }
+    }
+
+    infoCache[slot] = *info;
+    unlockCache();
+}
+
+/**
+ * @brief Copy cached attribute handles of device
+ * @param [in] addr Device address
+ * @param [out] gatt Cached handles
+ * @return true if device is in cache
+ */
+static bool findCachedGatt(const uint8_t* addr, AranetGattHandles* gatt) {
+    bool found = false;
+    lockCache();
+    for (uint8_t i = 0; i < gattCacheCount; i++) {
+        if (memcmp(gattCache[i].addr, addr, sizeof(gattCache[i].addr)) == 0) {
+            *gatt = gattCache[i];
+            found = true;
+            break;
+        }
+    }
+    unlockCache();
+    return found;
+}
+
+/**
+ * @brief Add or replace attribute handles of device in cache
+ */
+static void storeCachedGatt(const AranetGattHandles* gatt) {
+    lockCache();
+    uint8_t slot = gattCacheCount;
+    for (uint8_t i = 0; i < gattCacheCount; i++) {
+        if (memcmp(gattCache[i].addr, gatt->addr, sizeof(gatt->addr)) == 0) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot == gattCacheCount) {
+        if (gattCacheCount < ARANET_GATT_CACHE_SIZE) {
+            gattCacheCount++;
+        } else {
+            slot = gattCacheNext;
+            gattCacheNext = (gattCacheNext + 1) % ARANET_GATT_CACHE_SIZE;
+        }
+    }
+
+    gattCache[slot] = *gatt;
+    unlockCache();
+}
+
+/**
+ * @brief Remove attribute handles of device from cache, eg. when they do
+ *        not match device anymore after firmware update
+ */
+static void dropCachedGatt(const uint8_t* addr) {
+    lockCache();
+    for (uint8_t i = 0; i < gattCacheCount; i++) {
+        if (memcmp(gattCache[i].addr, addr, sizeof(gattCache[i].addr)) == 0) {
+            gattCache[i] = gattCache[--gattCacheCount];
+            gattCacheNext = 0;
+            break;
+        }
+    }
+    unlockCache();
+}
+
+// Characteristic handles in AranetGattHandles
+static uint16_t AranetGattHandles::* const gattHandleFields[] = {
+    &AranetGattHandles::currentReadingsA4,
+    &AranetGattHandles::currentReadingsA2,
+    &AranetGattHandles::interval,
+    &AranetGattHandles::secondsSinceUpdate,
+    &AranetGattHandles::totalReadings,
+    &AranetGattHandles::cmd,
+    &AranetGattHandles::history,
+    &AranetGattHandles::notifyHistory,
+};
+
+/**
+ * @brief Which characteristic handle belongs to
+ * @return Field in AranetGattHandles, nullptr if handle is not there
+ */
+static uint16_t AranetGattHandles::* findGattHandle(const AranetGattHandles* gatt, uint16_t handle) {
+    for (uint16_t AranetGattHandles::* field : gattHandleFields) {
+        if (gatt->*field == handle) return field;
+    }
+    return nullptr;
+}
 
 Aranet4::Aranet4(Aranet4Callbacks* callbacks) {
     pClient = NimBLEDevice::createClient();
     pClient->setClientCallbacks(callbacks, false);
+
+    // Signals that history packets were received
+    historyQueue = xQueueCreate(1, sizeof(uint8_t));
+    // Completion of GATT read, carries NimBLE status
+    readQueue = xQueueCreate(1, sizeof(int));
 }
 
 Aranet4::~Aranet4() {
     disconnect();
     NimBLEDevice::deleteClient(pClient);
+    vQueueDelete(historyQueue);
+    vQueueDelete(readQueue);
 }
 
 /**
@@ -31,7 +274,7 @@ void Aranet4::init(uint16_t mtu) {
     NimBLEDevice::setPower(ESP_PWR_LVL_P9);
     NimBLEDevice::setSecurityAuth(true, true, true);
     NimBLEDevice::setSecurityIOCap(BLE_HS_IO_KEYBOARD_ONLY);
-    NimBLEDevice::setMTU(mtu);
+    NimBLEDevice::setMTU(mtu < ARANET_MAX_MTU ? mtu : ARANET_MAX_MTU);
 }
 
 /**
@@ -46,7 +289,14 @@ ar4_err_t Aranet4::connect(NimBLEAdvertisedDevice* adv, bool secure) {
         pClient->disconnect();
     }
 
+    invalidateGatt();
+    secureConnect = secure;
+    connectStats = AranetConnectStats();
+    bulkActive = false;
+
+    unsigned long start = millis();
     if(pClient->connect(adv)) {
+        connectStats.connect = millis() - start;
         if (secure) return secureConnection();
         return AR4_OK;
     } else {
@@ -68,7 +318,14 @@ ar4_err_t Aranet4::connect(NimBLEAddress addr, bool secure) {
         pClient->disconnect();
     }
 
+    invalidateGatt();
+    secureConnect = secure;
+    connectStats = AranetConnectStats();
+    bulkActive = false;
+
+    unsigned long start = millis();
     if(pClient->connect(addr)) {
+        connectStats.connect = millis() - start;
         if (secure) return secureConnection();
         return AR4_OK;
     } else {
@@ -97,8 +354,35 @@ ar4_err_t Aranet4::connect(uint8_t* addr, bool secure, uint8_t type) {
  * @return status code
  */
 ar4_err_t Aranet4::connect(String addr, bool secure, uint8_t type) {
-    std::string addrstr(addr.c_str());
-    return connect(NimBLEAddress(addrstr, type), secure);
+    return connect(addr.c_str(), secure, type);
+}
+
+/**
+ * @brief Connect to Aranet4 device. Address is parsed in place, nothing is allocated.
+ * @param [in] addr Address of bluetooth device, "aa:bb:cc:dd:ee:ff"
+ * @param [in] secure Start in secure mode (bonded)
+ * @param [in] type Address type
+ * @return status code
+ */
+ar4_err_t Aranet4::connect(const char* addr, bool secure, uint8_t type) {
+    uint8_t mac[6];
+    if (addr == nullptr) return AR4_FAIL;
+
+    for (int i = 0; i < 6; i++) {
+        uint8_t b = 0;
+        for (int j = 0; j < 2; j++) {
+            char c = *addr++;
+            if (c >= '0' && c <= '9') b = (b << 4) | (c - '0');
+            else if (c >= 'a' && c <= 'f') b = (b << 4) | (c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') b = (b << 4) | (c - 'A' + 10);
+            else return AR4_FAIL;
+        }
+        mac[i] = b;
+        if (*addr != (i < 5 ? ':' : 0)) return AR4_FAIL;
+        if (i < 5) addr++;
+    }
+
+    return connect(mac, secure, type);
 }
 
 /**
@@ -106,10 +390,19 @@ ar4_err_t Aranet4::connect(String addr, bool secure, uint8_t type) {
  * @return status code
  */
 ar4_err_t Aranet4::secureConnection() {
-    if (pClient->secureConnection()) {
-        return AR4_OK;
-    }
-    return AR4_FAIL;
+    unsigned long start = millis();
+    bool ok = pClient->secureConnection();
+    connectStats.secure += millis() - start;
+    return ok ? AR4_OK : AR4_FAIL;
+}
+
+/**
+ * @brief Connect again to last device, with same security mode
+ * @return status code
+ */
+ar4_err_t Aranet4::reconnect() {
+    if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
+    return connect(pClient->getPeerAddress(), secureConnect);
 }
 
 /**
@@ -119,6 +412,7 @@ void Aranet4::disconnect() {
     if (pClient != nullptr && pClient->isConnected()) {
       pClient->disconnect();
     }
+    invalidateGatt();
 }
 
 /**
@@ -130,6 +424,33 @@ void Aranet4::setConnectTimeout(uint8_t time) {
     }
 }
 
+/**
+ * @brief Reuse attribute handles from earlier connection to same device,
+ *        instead of discovering services and characteristics again. Bond
+ *        is kept by NimBLE, so secure reconnect only encrypts the link.
+ * @param [in] enabled Use and fill handle cache
+ */
+void Aranet4::setFastReconnect(bool enabled) {
+    fastReconnect = enabled;
+}
+
+/**
+ * @brief Time spent in last connect() and in attribute discovery after it
+ */
+AranetConnectStats Aranet4::getConnectStats() {
+    return connectStats;
+}
+
+/**
+ * @brief Forget attribute handles of all devices, eg. after firmware update
+ */
+void Aranet4::clearGattCache() {
+    lockCache();
+    gattCacheCount = 0;
+    gattCacheNext = 0;
+    unlockCache();
+}
+
 /**
  * @brief Are we connected to a server?
  */
@@ -137,23 +458,43 @@ bool Aranet4::isConnected() {
     return pClient != nullptr && pClient->isConnected();
 }
 
+/**
+ * @brief ATT MTU negotiated with connected device, default MTU if not connected
+ */
+uint16_t Aranet4::getMTU() {
+    if (!isConnected()) return BLE_ATT_MTU_DFLT;
+    uint16_t mtu = pClient->getMTU();
+    return mtu < BLE_ATT_MTU_DFLT ? BLE_ATT_MTU_DFLT : mtu;
+}
+
+/**
+ * @brief Largest value part one read response carries (MTU - 1). Longer
+ *        values take one more round trip for every this many bytes.
+ */
+uint16_t Aranet4::getBytesPerRoundTrip() {
+    return getMTU() - 1;
+}
+
 /**
  * @brief Current readings from Aranet4
  */
 AranetData Aranet4::getCurrentReadings() {
     AranetData data;
     AranetType type = getType();
-    uint8_t raw[100];
-    uint16_t len = 100;
+    uint8_t raw[BLE_ATT_ATTR_MAX_LEN]; // longest value, never truncated
+    uint16_t len = sizeof(raw);
+
+    status = resolveGatt();
+    if (status != AR4_OK) return data;
 
     switch (type) {
     case ARANET4:
-        status = getValue(getAranetService(), UUID_Aranet4_CurrentReadingsDet, raw, &len);
+        status = getValue(gatt.currentReadingsA4, raw, &len);
         break;
     case ARANET2:
     case ARANET_RADIATION:
     case ARANET_RADON:
-        status = getValue(getAranetService(), UUID_Aranet2_CurrentReadings, raw, &len);
+        status = getValue(gatt.currentReadingsA2, raw, &len);
         break;
     default:
         status = AR4_FAIL;
@@ -170,49 +511,146 @@ AranetData Aranet4::getCurrentReadings() {
  * @brief Seconds since last Aranet4 measurement
  */
 uint16_t Aranet4::getSecondsSinceUpdate() {
-    return getU16Value(getAranetService(), UUID_Aranet4_SecondsSinceUpdate);
+    status = resolveGatt();
+    if (status != AR4_OK) return 0;
+    return getU16Value(gatt.secondsSinceUpdate);
 }
 
 /**
  * @brief Total readings stored in Aranet4 memory
  */
 uint16_t Aranet4::getTotalReadings() {
-    return getU16Value(getAranetService(), UUID_Aranet4_TotalReadings);
+    status = resolveGatt();
+    if (status != AR4_OK) return 0;
+    return getU16Value(gatt.totalReadings);
 }
 
 /**
  * @brief Aranet4 measurement intervals
  */
 uint16_t Aranet4::getInterval() {
-    return getU16Value(getAranetService(), UUID_Aranet4_Interval);
+    status = resolveGatt();
+    if (status != AR4_OK) return 0;
+    return getU16Value(gatt.interval);
 }
 
 /**
  * @brief Aranet4 device name
  */
 String Aranet4::getName() {
-    return getStringValue(UUID_Generic, UUID_Generic_DeviceName);
+    char buf[ARANET_STRING_SIZE];
+    getName(buf, sizeof(buf));
+    return String(buf);
 }
 
 /**
  * @brief Aranet4 software version
  */
 String Aranet4::getSwVersion() {
-    return getStringValue(UUID_Common, UUID_Common_SwRev);
+    char buf[ARANET_STRING_SIZE];
+    getSwVersion(buf, sizeof(buf));
+    return String(buf);
 }
 
 /**
  * @brief Aranet4 firmware version
  */
 String Aranet4::getFwVersion() {
-    return getStringValue(UUID_Common, UUID_Common_FwRev);
+    char buf[ARANET_STRING_SIZE];
+    getFwVersion(buf, sizeof(buf));
+    return String(buf);
 }
 
 /**
  * @brief Aranet4 hardware version
  */
 String Aranet4::getHwVersion() {
-    return getStringValue(UUID_Common, UUID_Common_HwRev);
+    char buf[ARANET_STRING_SIZE];
+    getHwVersion(buf, sizeof(buf));
+    return String(buf);
+}
+
+/**
+ * @brief Aranet4 device name, into caller buffer
+ * @param [out] buf Output buffer, always null terminated
+ * @param [in] size Buffer size
+ * @return status code
+ */
+ar4_err_t Aranet4::getName(char* buf, size_t size) {
+    return getStringValue(getGenericService(), UUID_Generic_DeviceName, buf, size);
+}
+
+/**
+ * @brief Aranet4 software version, into caller buffer
+ * @param [out] buf Output buffer, always null terminated
+ * @param [in] size Buffer size
+ * @return status code
+ */
+ar4_err_t Aranet4::getSwVersion(char* buf, size_t size) {
+    return getStringValue(getCommonService(), UUID_Common_SwRev, buf, size);
+}
+
+/**
+ * @brief Aranet4 firmware version, into caller buffer
+ * @param [out] buf Output buffer, always null terminated
+ * @param [in] size Buffer size
+ * @return status code
+ */
+ar4_err_t Aranet4::getFwVersion(char* buf, size_t size) {
+    return getStringValue(getCommonService(), UUID_Common_FwRev, buf, size);
+}
+
+/**
+ * @brief Aranet4 hardware version, into caller buffer
+ * @param [out] buf Output buffer, always null terminated
+ * @param [in] size Buffer size
+ * @return status code
+ */
+ar4_err_t Aranet4::getHwVersion(char* buf, size_t size) {
+    return getStringValue(getCommonService(), UUID_Common_HwRev, buf, size);
+}
+
+/**
+ * @brief Device info snapshot. Name, versions and type are read once per
+ *        device and then taken from cache, also after reconnect. Interval
+ *        and total readings are always read.
+ * @param [out] info Device info
+ * @param [in] refresh Read static info again, even if it is cached
+ * @return status code
+ */
+ar4_err_t Aranet4::getDeviceInfo(AranetDeviceInfo* info, bool refresh) {
+    status = resolveGatt();
+    if (status != AR4_OK) return status;
+
+    NimBLEAddress addr = pClient->getPeerAddress();
+    if (refresh || !findCachedInfo(addr.getNative(), info)) {
+        memset(info, 0, sizeof(AranetDeviceInfo));
+        memcpy(info->addr, addr.getNative(), sizeof(info->addr));
+
+        if (getName(info->name, sizeof(info->name)) != AR4_OK) return status;
+        if (getSwVersion(info->swVersion, sizeof(info->swVersion)) != AR4_OK) return status;
+        if (getFwVersion(info->fwVersion, sizeof(info->fwVersion)) != AR4_OK) return status;
+        if (getHwVersion(info->hwVersion, sizeof(info->hwVersion)) != AR4_OK) return status;
+        info->type = aranetTypeFromName(info->name);
+        storeCachedInfo(info);
+    }
+
+    type = info->type;
+
+    info->interval = getU16Value(gatt.interval);
+    if (status != AR4_OK) return status;
+    info->totalReadings = getU16Value(gatt.totalReadings);
+    return status;
+}
+
+/**
+ * @brief Forget static device info of all devices, eg. after firmware update
+ */
+void Aranet4::clearDeviceInfoCache() {
+    lockCache();
+    infoCacheCount = 0;
+    infoCacheNext = 0;
+    unlockCache();
 }
 
 /**
@@ -222,18 +660,161 @@ ar4_err_t Aranet4::getStatus() {
     return status;
 }
 
+/**
+ * @brief Pipeline V2 history transfer: next chunk is requested before
+ *        current one is processed, and command is written without response
+ *        if device allows it. Disabled by default.
+ * @param [in] enabled Enable pipelining
+ */
+void Aranet4::setHistoryPipelining(bool enabled) {
+    historyPipelining = enabled;
+}
+
+/**
+ * @brief Statistics of last history download
+ */
+AranetTransferStats Aranet4::getTransferStats() {
+    return transferStats;
+}
+
+/**
+ * @brief Switch connection parameters between history downloads (bulk)
+ *        and idle connection. Update is requested when download starts and
+ *        ends, it takes effect few connection events later. Several
+ *        downloads in a row stay at bulk parameters if wrapped in
+ *        beginBulk() / endBulk().
+ *        Idle parameters save device battery on link that is kept open, but
+ *        every later read on it is slower (up to (latency + 1) * interval per
+ *        round trip). Disconnect after download, or use idle parameters with
+ *        no latency, if link is kept for polling current readings.
+ * @param [in] enabled Request parameter updates
+ */
+void Aranet4::setConnProfiles(bool enabled) {
+    connProfiles = enabled;
+}
+
+/**
+ * @brief Set connection parameters used during and after history download,
+ *        and enable parameter updates
+ * @param [in] bulk Parameters during download
+ * @param [in] idle Parameters after download
+ */
+void Aranet4::setConnProfiles(const AranetConnParams& bulk, const AranetConnParams& idle) {
+    bulkParams = bulk;
+    idleParams = idle;
+    connProfiles = true;
+}
+
+/**
+ * @brief Keep bulk connection parameters until matching endBulk(), across
+ *        several history downloads. Calls can be nested, every history
+ *        download does it too.
+ */
+void Aranet4::beginBulk() {
+    if (bulkDepth < 255) bulkDepth++;
+    // Also after reconnect, new link starts with default parameters
+    if (connProfiles && !bulkActive) bulkActive = requestConnParams(bulkParams);
+}
+
+/**
+ * @brief End bulk transfer. Idle parameters are requested when last open
+ *        beginBulk() ends, so link is idle.
+ */
+void Aranet4::endBulk() {
+    if (bulkDepth == 0) return;
+    if (--bulkDepth > 0) return;
+
+    if (bulkActive) requestConnParams(idleParams);
+    bulkActive = false;
+}
+
+/**
+ * @brief Request connection parameter update. Does not wait for it to take
+ *        effect, device may also answer with parameters of its own. If
+ *        previous update is still in progress, waits for it up to
+ *        ARANET_CONN_UPDATE_WAIT.
+ * @return true if update was started
+ */
+bool Aranet4::requestConnParams(const AranetConnParams& params) {
+    if (!isConnected()) return false;
+
+    ble_gap_upd_params upd = {};
+    upd.itvl_min = params.minInterval;
+    upd.itvl_max = params.maxInterval;
+    upd.latency = params.latency;
+    upd.supervision_timeout = params.timeout;
+
+    unsigned long start = millis();
+    int rc;
+    while ((rc = ble_gap_update_params(pClient->getConnId(), &upd)) == BLE_HS_EALREADY) {
+        if (millis() - start >= ARANET_CONN_UPDATE_WAIT) break;
+        delay(10);
+    }
+
+    if (rc != 0) {
+        Serial.printf("WARNING: Connection parameter update failed, rc=%d\n", rc);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reset transfer statistics at start of history download
+ */
+void Aranet4::beginTransfer() {
+    beginBulk();
+
+    transferStats = AranetTransferStats();
+    transferStats.pipelined = historyPipelining;
+    transferStats.mtu = getMTU();
+    transferStats.elapsed = millis();
+    transferActive = true;
+    historyTotal = 0;
+}
+
+/**
+ * @brief Finish transfer statistics of history download
+ * @param [in] records Received record count
+ * @return records
+ */
+int Aranet4::endTransfer(int records) {
+    endBulk();
+
+    transferActive = false;
+    transferStats.elapsed = millis() - transferStats.elapsed;
+    transferStats.records = records > 0 ? records : 0;
+    return records;
+}
+
+/**
+ * @brief Device type, detected from device name. Name is read once per connection.
+ */
 AranetType Aranet4::getType() {
-    String name = getName();
-    char c0 = name.charAt(6);
-    char c1 = name.charAt(7);
-    char c2 = name.charAt(8);
+    if (!isConnected()) {
+        invalidateGatt();
+        return UNKNOWN;
+    }
+
+    if (type != UNKNOWN) return type;
 
-    if (c0 == '4') return ARANET4;
-    if (c0 == '2') return ARANET2;
-    if (c0 == (char) 0xE2 && c1 == (char) 0x98 && c2 == (char) 0xA2) return ARANET_RADIATION;
-    if (c0 == 'R' && c1 == 'n') return ARANET_RADON;
+    // Known device, name was read on earlier connection
+    AranetDeviceInfo info;
+    NimBLEAddress addr = pClient->getPeerAddress();
+    if (findCachedInfo(addr.getNative(), &info)) {
+        type = info.type;
+        return type;
+    }
+
+    char name[ARANET_STRING_SIZE];
+    getName(name, sizeof(name));
+    type = aranetTypeFromName(name);
 
-    return UNKNOWN;
+    // Next fast reconnect knows type without reading name
+    if (fastReconnect && gattResolved && gattStatus == AR4_OK) {
+        gatt.type = type;
+        storeCachedGatt(&gatt);
+    }
+    return type;
 }
 
 /**
@@ -260,7 +841,7 @@ bool Aranet4::isAranetRadiation() {
  * @brief Check is is Aranet Radon
  */
 bool Aranet4::isAranetRadon() {
-    getType() == ARANET_RADON;
+    return getType() == ARANET_RADON;
 }
 
 
@@ -269,10 +850,10 @@ bool Aranet4::isAranetRadon() {
  * @param [in] serviceUuid GATT Service UUID to read
  * @param [in] charUuid GATT Char UUID to read
  * @param [out] data Pointer to where received data will be stored
- * @param [in|out] Size of data on input, received data size on output (truncated if larger than input)
- * @return Read status code (AR4_READ_*)
+ * @param [in|out] Size of data on input, received data size on output
+ * @return Read status code, AR4_ERR_TRUNCATED if value did not fit in data
  */
-ar4_err_t Aranet4::getValue(NimBLEUUID serviceUuid, NimBLEUUID charUuid, uint8_t* data, uint16_t* len) {
+ar4_err_t Aranet4::getValue(const NimBLEUUID& serviceUuid, const NimBLEUUID& charUuid, uint8_t* data, uint16_t* len) {
     if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
     if (!pClient->isConnected())  return AR4_ERR_NOT_CONNECTED;
     return getValue(pClient->getService(serviceUuid), charUuid, data, len);
@@ -286,49 +867,198 @@ ar4_err_t Aranet4::getValue(NimBLEUUID serviceUuid, NimBLEUUID charUuid, uint8_t
  * @param [in|out] Size of data on input, received data size on output (truncated if larger than input)
  * @return Read status code (AR4_READ_*)
  */
-ar4_err_t Aranet4::getValue(NimBLERemoteService* service, NimBLEUUID charUuid, uint8_t* data, uint16_t* len) {
+ar4_err_t Aranet4::getValue(NimBLERemoteService* service, const NimBLEUUID& charUuid, uint8_t* data, uint16_t* len) {
     if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
     if (!pClient->isConnected())  return AR4_ERR_NOT_CONNECTED;
     if (service == nullptr) return AR4_ERR_NO_GATT_SERVICE;
 
-    NimBLERemoteCharacteristic* pRemoteCharacteristic = service->getCharacteristic(charUuid);
-    if (pRemoteCharacteristic == nullptr) {
-        return AR4_ERR_NO_GATT_CHAR;
+    return getValue(service->getCharacteristic(charUuid), data, len);
+}
+
+/**
+ * @brief Reads raw data from Aranet4, directly into data. Unlike
+ *        NimBLERemoteCharacteristic::readValue(), nothing is allocated.
+ * @param [in] chr GATT Char to read
+ * @param [out] data Pointer to where received data will be stored
+ * @param [in|out] Size of data on input, received data size on output (truncated if larger than input)
+ * @return Read status code (AR4_READ_*)
+ */
+ar4_err_t Aranet4::getValue(NimBLERemoteCharacteristic* chr, uint8_t* data, uint16_t* len) {
+    if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
+    if (!pClient->isConnected())  return AR4_ERR_NOT_CONNECTED;
+    if (chr == nullptr) return AR4_ERR_NO_GATT_CHAR;
+    if (!chr->canRead()) return AR4_FAIL;
+
+    return getValue(chr->getHandle(), data, len);
+}
+
+/**
+ * @brief Reads raw data from Aranet4 by attribute handle, directly into data.
+ *        If cached handle is stale, handles are discovered again and read is
+ *        retried once with new handle of same characteristic.
+ * @param [in] handle Attribute handle, 0 if characteristic is missing
+ * @param [out] data Pointer to where received data will be stored
+ * @param [in|out] Size of data on input, received data size on output (truncated if larger than input)
+ * @return Read status code (AR4_READ_*)
+ */
+ar4_err_t Aranet4::getValue(uint16_t handle, uint8_t* data, uint16_t* len) {
+    if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
+    if (!pClient->isConnected())  return AR4_ERR_NOT_CONNECTED;
+    if (handle == 0) return AR4_ERR_NO_GATT_CHAR;
+
+    uint16_t size = *len;
+    int rc = readValue(handle, data, len);
+
+    // Same as NimBLERemoteCharacteristic::readValue(): secure link and retry once
+    if (rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN) || rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC)) {
+        if (!pClient->secureConnection()) {
+            *len = 0;
+            return AR4_FAIL;
+        }
+        *len = size;
+        rc = readValue(handle, data, len);
     }
 
-    // Read the value of the characteristic.
-    if(pRemoteCharacteristic->canRead()) {
-        std::string str = pRemoteCharacteristic->readValue();
-        if (str.length() < *len) *len = str.length();
-        memcpy(data, str.c_str(), *len);
-        return AR4_OK;
+    if (rc == 0) return AR4_OK;
+    if (rc == BLE_HS_EMSGSIZE) return AR4_ERR_TRUNCATED;
+
+    // Cached handles do not match device anymore, discover again and read
+    // same characteristic once more
+    if (rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_INVALID_HANDLE) && gattCached) {
+        Serial.println("WARNING: Cached GATT handles are invalid.");
+        uint16_t AranetGattHandles::* field = findGattHandle(&gatt, handle);
+        dropCachedGatt(pClient->getPeerAddress().getNative());
+        gattResolved = false;
+        gattCached = false;
+
+        if (field != nullptr && resolveGatt() == AR4_OK) {
+            *len = size;
+            return getValue(gatt.*field, data, len); // not cached, no more retries
+        }
     }
 
+    *len = 0;
+    if (!pClient->isConnected()) return AR4_ERR_NOT_CONNECTED;
     return AR4_FAIL;
 }
 
+// Long read in progress, lives on caller stack until read is complete
+typedef struct {
+    uint8_t*      data;
+    uint16_t      size;
+    uint16_t      len;
+    bool          truncated;
+    QueueHandle_t done;
+} AranetReadContext;
+
+/**
+ * @brief GATT read callback. Called by NimBLE host task for every response
+ *        fragment, then once more with BLE_HS_EDONE or error.
+ */
+static int onReadValue(uint16_t conn_handle, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg) {
+    AranetReadContext* ctx = (AranetReadContext*) arg;
+
+    if (error->status == 0 && attr != nullptr) {
+        // value longer than buffer is truncated, but procedure must complete
+        uint16_t n = OS_MBUF_PKTLEN(attr->om);
+        if (attr->offset + n > ctx->size) ctx->truncated = true;
+        if (attr->offset >= ctx->size) return 0;
+        if (n > ctx->size - attr->offset) n = ctx->size - attr->offset;
+        os_mbuf_copydata(attr->om, 0, n, ctx->data + attr->offset);
+        if (attr->offset + n > ctx->len) ctx->len = attr->offset + n;
+        return 0;
+    }
+
+    int rc = error->status == BLE_HS_EDONE ? 0 : error->status;
+    xQueueSend(ctx->done, &rc, portMAX_DELAY);
+    return rc;
+}
+
+/**
+ * @brief Read characteristic value with ble_gattc_read_long(), straight
+ *        into caller buffer
+ * @param [in] handle Attribute handle
+ * @param [out] data Receive buffer
+ * @param [in|out] len Buffer size on input, received size on output
+ * @return 0 or NimBLE host error code, BLE_HS_EMSGSIZE if value was truncated
+ */
+int Aranet4::readValue(uint16_t handle, uint8_t* data, uint16_t* len) {
+    AranetReadContext ctx = { data, *len, 0, false, readQueue };
+    int rc;
+
+    *len = 0;
+    xQueueReset(readQueue);
+    rc = ble_gattc_read_long(pClient->getConnId(), handle, 0, onReadValue, &ctx);
+    if (rc != 0) return rc;
+
+    // Host always completes procedure, also when link is lost
+    xQueueReceive(readQueue, &rc, portMAX_DELAY);
+    *len = ctx.len;
+    if (rc == 0 && ctx.truncated) return BLE_HS_EMSGSIZE;
+    return rc;
+}
+
+/**
+ * @brief GATT write callback, called by NimBLE host task
+ */
+static int onWriteValue(uint16_t conn_handle, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg) {
+    int rc = error->status;
+    xQueueSend((QueueHandle_t) arg, &rc, portMAX_DELAY);
+    return 0;
+}
+
+/**
+ * @brief Write characteristic value with response, by attribute handle.
+ *        Secures link and retries once, same as NimBLERemoteCharacteristic.
+ * @param [in] handle Attribute handle
+ * @param [in] data Value
+ * @param [in] len Value length, must fit in single write
+ * @return 0 or NimBLE host error code
+ */
+int Aranet4::writeValue(uint16_t handle, const uint8_t* data, uint16_t len) {
+    int rc;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        xQueueReset(readQueue);
+        rc = ble_gattc_write_flat(pClient->getConnId(), handle, data, len, onWriteValue, readQueue);
+        if (rc != 0) return rc;
+        xQueueReceive(readQueue, &rc, portMAX_DELAY);
+
+        if (rc != BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN) && rc != BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_ENC)) break;
+        if (attempt > 0 || !pClient->secureConnection()) break;
+    }
+
+    return rc;
+}
+
 /**
  * @brief Reads string value from Aranet4
  * @param [in] serviceUuid GATT Service UUID to read
  * @param [in] charUuid GATT Char UUID to read
- * @return String value
+ * @param [out] buf Output buffer, always null terminated
+ * @param [in] size Buffer size
+ * @return status code, AR4_ERR_TRUNCATED if string did not fit (buf holds first part)
  */
-String Aranet4::getStringValue(NimBLEUUID serviceUuid, NimBLEUUID charUuid) {
-    return getStringValue(pClient->getService(serviceUuid), charUuid);
+ar4_err_t Aranet4::getStringValue(const NimBLEUUID& serviceUuid, const NimBLEUUID& charUuid, char* buf, size_t size) {
+    return getStringValue(pClient->getService(serviceUuid), charUuid, buf, size);
 }
 
 /**
  * @brief Reads string value from Aranet4
  * @param [in] service GATT Service to read
  * @param [in] charUuid GATT Char UUID to read
- * @return String value
+ * @param [out] buf Output buffer, always null terminated
+ * @param [in] size Buffer size
+ * @return status code, AR4_ERR_TRUNCATED if string did not fit (buf holds first part)
  */
-String Aranet4::getStringValue(NimBLERemoteService* service, NimBLEUUID charUuid) {
-    uint8_t buf[33];
-    uint16_t len = 32;
-    status = getValue(service, charUuid, buf, &len);
-    buf[len] = 0; // trerminate string
-    return String((char *) buf);
+ar4_err_t Aranet4::getStringValue(NimBLERemoteService* service, const NimBLEUUID& charUuid, char* buf, size_t size) {
+    if (size == 0) return AR4_FAIL;
+
+    uint16_t len = size - 1 > 0xffff ? 0xffff : size - 1;
+    status = getValue(service, charUuid, (uint8_t*) buf, &len);
+    if (status != AR4_OK && status != AR4_ERR_TRUNCATED) len = 0;
+    buf[len] = 0; // terminate string
+    return status;
 }
 
 /**
@@ -337,7 +1067,7 @@ String Aranet4::getStringValue(NimBLERemoteService* service, NimBLEUUID charUuid
  * @param [in] charUuid GATT Char UUID to read
  * @return u16 value
  */
-uint16_t Aranet4::getU16Value(NimBLEUUID serviceUuid, NimBLEUUID charUuid) {
+uint16_t Aranet4::getU16Value(const NimBLEUUID& serviceUuid, const NimBLEUUID& charUuid) {
     return getU16Value(pClient->getService(serviceUuid), charUuid);
 }
 
@@ -347,73 +1077,217 @@ uint16_t Aranet4::getU16Value(NimBLEUUID serviceUuid, NimBLEUUID charUuid) {
  * @param [in] charUuid GATT Char UUID to read
  * @return u16 value
  */
-uint16_t Aranet4::getU16Value(NimBLERemoteService* service, NimBLEUUID charUuid) {
-    uint16_t val = 0;
-    uint16_t len = 2;
-    status = getValue(service, charUuid, (uint8_t *) &val, &len);
-
-    if (len == 2) {
-        return val;
+uint16_t Aranet4::getU16Value(NimBLERemoteService* service, const NimBLEUUID& charUuid) {
+    if (service == nullptr) {
+        status = AR4_ERR_NO_GATT_SERVICE;
+        return 0;
     }
-
-    status = AR4_FAIL;
-    return 0;
+    return getU16Value(service->getCharacteristic(charUuid));
 }
 
 /**
- * @brief Writes command to Aranet
+ * @brief Reads u16 value from Aranet4
+ * @param [in] chr GATT Char to read
+ * @return u16 value
+ */
+uint16_t Aranet4::getU16Value(NimBLERemoteCharacteristic* chr) {
+    if (chr == nullptr) {
+        status = AR4_ERR_NO_GATT_CHAR;
+        return 0;
+    }
+    return getU16Value(chr->getHandle());
+}
+
+/**
+ * @brief Reads u16 value from Aranet4
+ * @param [in] handle Attribute handle
+ * @return u16 value
+ */
+uint16_t Aranet4::getU16Value(uint16_t handle) {
+    uint16_t val = 0;
+    uint16_t len = 2;
+    status = getValue(handle, (uint8_t *) &val, &len);
+
+    if (len == 2) {
+        return val;
+    }
+
+    status = AR4_FAIL;
+    return 0;
+}
+
+/**
+ * @brief Writes command to Aranet
  * @param [in] data Command data
  * @param [in] len Command data length
+ * @param [in] response Wait for write response. Without response, write is
+ *             only queued. Falls back to write with response if device does
+ *             not allow it.
  * @return write status
  */
-ar4_err_t Aranet4::writeCmd(uint8_t* data, uint16_t len) {
-    if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
-    if (!pClient->isConnected())  return AR4_ERR_NOT_CONNECTED;
-
-    NimBLERemoteService* pRemoteService = getAranetService();
-    if (pRemoteService == nullptr) {
-        return AR4_ERR_NO_GATT_SERVICE;
-    }
+ar4_err_t Aranet4::writeCmd(uint8_t* data, uint16_t len, bool response) {
+    ar4_err_t err = resolveGatt();
+    if (err != AR4_OK) return err;
+    if (gatt.cmd == 0) return AR4_ERR_NO_GATT_CHAR;
 
-    NimBLERemoteCharacteristic* pRemoteCharacteristic = pRemoteService->getCharacteristic(UUID_Aranet4_Cmd);
-    if (pRemoteCharacteristic == nullptr) {
-        return AR4_ERR_NO_GATT_CHAR;
+    if (!response && (gatt.cmdProperties & BLE_GATT_CHR_PROP_WRITE_NO_RSP)) {
+        if (ble_gattc_write_no_rsp_flat(pClient->getConnId(), gatt.cmd, data, len) == 0) return AR4_OK;
+        return AR4_FAIL;
     }
 
-    // Read the value of the characteristic.
-    if(pRemoteCharacteristic->canWrite()) {
-        if (pRemoteCharacteristic->writeValue(data, len, true)) return AR4_OK;
+    if (gatt.cmdProperties & BLE_GATT_CHR_PROP_WRITE) {
+        if (writeValue(gatt.cmd, data, len) == 0) return AR4_OK;
     }
     return AR4_FAIL;
 }
 
 /**
- * @brief Callback for history subscriptions. This will store received data in historyQueue
+ * @brief Callback for history subscriptions. This will store received packet in
+ *        historyRing and wake up reader. Runs in BLE host task, never blocks.
  */
 void Aranet4::historyCallback(BLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify) {
-    uint8_t param = pData[0];
-    uint16_t idx = pData[1] + (pData[2] << 8) - 1;
-    uint8_t count = pData[3];
-    uint16_t pos = 4;
+    if (length < 4) return;
 
-    while (count > 0 && pos < length) {
-        uint16_t val = pData[pos++];
+    if (!historyRing.push(pData, length)) {
+        historyRing.dropped++;
+    }
 
-        if (param != AR4_PARAM_HUMIDITY) {
-            val += (pData[pos++] << 8);
-        }
+    uint8_t wake = 1;
+    xQueueSend(historyQueue, &wake, 0);
+}
+
+/**
+ * @brief Resolve Aranet service and its characteristics. Done once per
+ *        connection, later calls return cached result without GATT traffic.
+ * @return status code
+ */
+ar4_err_t Aranet4::resolveGatt() {
+    if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
+    if (!pClient->isConnected()) {
+        invalidateGatt();
+        return AR4_ERR_NOT_CONNECTED;
+    }
+
+    if (gattResolved) return gattStatus;
+    gattResolved = true;
+
+    NimBLEAddress peer = pClient->getPeerAddress();
+    const uint8_t* addr = peer.getNative();
+    if (fastReconnect && findCachedGatt(addr, &gatt)) {
+        gattCached = true;
+        connectStats.cached = true;
+        if (type == UNKNOWN) type = gatt.type;
+        gattStatus = AR4_OK;
+        return gattStatus;
+    }
+
+    // Stale handles must not survive rediscovery
+    memset(&gatt, 0, sizeof(gatt));
+    gatt.type = UNKNOWN;
+    pNotifyHistory = nullptr;
+
+    unsigned long start = millis();
+
+    pAranetService = pClient->getService(UUID_Aranet4);
+    if (pAranetService == nullptr) {
+        pAranetService = pClient->getService(UUID_Aranet4_Old);
+    }
+
+    if (pAranetService == nullptr) {
+        connectStats.discovery += millis() - start;
+        gattStatus = AR4_ERR_NO_GATT_SERVICE;
+        return gattStatus;
+    }
 
-        xQueueSend(historyQueue, &val, portMAX_DELAY);
-        count -= 1;
+    // Discover all characteristics at once. Missing ones (eg. history on
+    // older firmware) are then known to be missing and not searched again.
+    std::vector<NimBLERemoteCharacteristic*>* chars = pAranetService->getCharacteristics(true);
+    for (NimBLERemoteCharacteristic* chr : *chars) {
+        NimBLEUUID uuid = chr->getUUID();
+        uint16_t handle = chr->getHandle();
+        if (uuid == UUID_Aranet4_CurrentReadingsDet)       gatt.currentReadingsA4 = handle;
+        else if (uuid == UUID_Aranet2_CurrentReadings)     gatt.currentReadingsA2 = handle;
+        else if (uuid == UUID_Aranet4_Interval)            gatt.interval = handle;
+        else if (uuid == UUID_Aranet4_SecondsSinceUpdate)  gatt.secondsSinceUpdate = handle;
+        else if (uuid == UUID_Aranet4_TotalReadings)       gatt.totalReadings = handle;
+        else if (uuid == UUID_Aranet4_History)             gatt.history = handle;
+        else if (uuid == UUID_Aranet4_Notify_History) {
+            gatt.notifyHistory = handle;
+            pNotifyHistory = chr;
+        } else if (uuid == UUID_Aranet4_Cmd) {
+            gatt.cmd = handle;
+            gatt.cmdProperties = (chr->canWrite() ? BLE_GATT_CHR_PROP_WRITE : 0)
+                               | (chr->canWriteNoResponse() ? BLE_GATT_CHR_PROP_WRITE_NO_RSP : 0);
+        }
     }
+
+    connectStats.discovery += millis() - start;
+    memcpy(gatt.addr, addr, sizeof(gatt.addr));
+    gatt.type = type;
+    if (fastReconnect) storeCachedGatt(&gatt);
+
+    gattStatus = AR4_OK;
+    return gattStatus;
+}
+
+/**
+ * @brief Forget cached GATT attributes and device type. Called when
+ *        connection is closed or lost.
+ */
+void Aranet4::invalidateGatt() {
+    gattResolved = false;
+    gattStatus = AR4_OK;
+    type = UNKNOWN;
+    gattCached = false;
+    memset(&gatt, 0, sizeof(gatt));
+    gatt.type = UNKNOWN;
+    pAranetService = nullptr;
+    pNotifyHistory = nullptr;
+    pGenericService = nullptr;
+    pCommonService = nullptr;
+    historyTotal = 0;
 }
 
 NimBLERemoteService* Aranet4::getAranetService() {
-    NimBLERemoteService* pRemoteService = pClient->getService(UUID_Aranet4);
-    if (pRemoteService == nullptr) {
-        pRemoteService = pClient->getService(UUID_Aranet4_Old);
+    resolveGatt();
+    // Not discovered if handles came from cache
+    if (pAranetService == nullptr && gattStatus == AR4_OK && isConnected()) {
+        pAranetService = pClient->getService(UUID_Aranet4);
+        if (pAranetService == nullptr) pAranetService = pClient->getService(UUID_Aranet4_Old);
     }
-    return pRemoteService;
+    return pAranetService;
+}
+
+/**
+ * @brief V1 history characteristic. Subscription needs NimBLE attribute
+ *        objects, so it is discovered here if handles came from cache.
+ */
+NimBLERemoteCharacteristic* Aranet4::getNotifyHistory() {
+    if (pNotifyHistory == nullptr && gatt.notifyHistory != 0) {
+        NimBLERemoteService* service = getAranetService();
+        if (service != nullptr) pNotifyHistory = service->getCharacteristic(UUID_Aranet4_Notify_History);
+    }
+    return pNotifyHistory;
+}
+
+/**
+ * @brief Generic access service, looked up once per connection
+ */
+NimBLERemoteService* Aranet4::getGenericService() {
+    if (pGenericService == nullptr && isConnected()) {
+        pGenericService = pClient->getService(UUID_Generic);
+    }
+    return pGenericService;
+}
+
+/**
+ * @brief Device information service, looked up once per connection
+ */
+NimBLERemoteService* Aranet4::getCommonService() {
+    if (pCommonService == nullptr && isConnected()) {
+        pCommonService = pClient->getService(UUID_Common);
+    }
+    return pCommonService;
 }
 
 /**
@@ -422,16 +1296,13 @@ NimBLERemoteService* Aranet4::getAranetService() {
  * @return subscription status
  */
 ar4_err_t Aranet4::subscribeHistory(uint8_t* cmd) {
-    if (pClient == nullptr) return AR4_ERR_NO_CLIENT;
-    if (!pClient->isConnected())  return AR4_ERR_NOT_CONNECTED;
-
-    NimBLERemoteService* pRemoteService = getAranetService();
-    if (pRemoteService == nullptr) {
+    ar4_err_t err = resolveGatt();
+    if (err == AR4_ERR_NO_GATT_SERVICE) {
          Serial.println("NO SERVC");
-        return AR4_ERR_NO_GATT_SERVICE;
     }
+    if (err != AR4_OK) return err;
 
-    NimBLERemoteCharacteristic* pRemoteCharacteristic = pRemoteService->getCharacteristic(UUID_Aranet4_Notify_History);
+    NimBLERemoteCharacteristic* pRemoteCharacteristic = getNotifyHistory();
     if (pRemoteCharacteristic == nullptr) {
         Serial.println("NO CHAR");
         return AR4_ERR_NO_GATT_CHAR;
@@ -443,7 +1314,12 @@ ar4_err_t Aranet4::subscribeHistory(uint8_t* cmd) {
         return AR4_FAIL;
     }
 
-    if (pRemoteCharacteristic->subscribe(true, historyCallback)) {
+    // Route notifications to this instance
+    auto callback = [this](BLERemoteCharacteristic* pChr, uint8_t* pData, size_t length, bool isNotify) {
+        historyCallback(pChr, pData, length, isNotify);
+    };
+
+    if (pRemoteCharacteristic->subscribe(true, callback)) {
         return AR4_OK;
     }
 
@@ -456,35 +1332,205 @@ ar4_err_t Aranet4::subscribeHistory(uint8_t* cmd) {
  * @param [in] count Data points to read
  * @param [out] data Pointer to data array, whre results will be stored
  * @param [in] param PArameter to fetch
- * @return Received point count
+ * @return Point count received contiguously from start
  */
 int Aranet4::getHistoryByParamV1(int start, uint16_t count, uint16_t* data, uint8_t param) {
+    U16HistoryWriter writer(data, start < 1 ? 1 : start);
+    return getHistoryByParamV1(start, count, &writer, param);
+}
+
+/**
+ * @brief Adds lost range. When list is full, range is merged in to last one.
+ */
+static void addHistoryGap(AranetHistoryRange* gaps, uint8_t* gapCount, uint16_t start, uint16_t end) {
+    if (*gapCount < ARANET_HISTORY_MAX_GAPS) {
+        gaps[*gapCount].start = start;
+        gaps[*gapCount].end = end;
+        *gapCount += 1;
+    } else {
+        gaps[*gapCount - 1].end = end;
+    }
+}
+
+/**
+ * @brief Reads history data and passes it to callback as it is received.
+ *        Transfer ends as soon as last index arrives. Lost ranges are
+ *        requested again, up to ARANET_HISTORY_V1_RETRIES times.
+ *        Values after a lost range are still passed to callback, but are not
+ *        counted: returned count covers only values received without gaps.
+ * @param [in] start Start index
+ * @param [in] count Data points to read
+ * @param [in] callbacks Callback receiving data
+ * @param [in] param Parameter to fetch
+ * @return Point count received contiguously from start
+ */
+int Aranet4::getHistoryByParamV1(int start, uint16_t count, AranetHistoryCallbacks* callbacks, uint8_t param) {
     if (start < 1) start = 1;
+    if (count == 0) return 0;
+
+    // Device stops at newest record. Requesting past it would end in timeout.
+    uint16_t total = historyTotal;
+    if (total == 0) {
+        total = getTotalReadings();
+        if (status != AR4_OK) return 0;
+        if (transferActive) historyTotal = total;
+    }
 
     // id 1 is oldest
-    uint16_t end = start + (count - 1);
+    uint32_t end = (uint32_t) start + count - 1;
+    if (end > total) end = total;
+    if ((uint32_t) start > end) return 0;
+
+    // One notification at negotiated MTU
+    uint16_t size = getMTU() - 3;
+    uint8_t* packet = (uint8_t*) malloc(size);
+    if (packet == nullptr) {
+        status = AR4_FAIL;
+        return 0;
+    }
+
+    AranetHistoryRange ranges[ARANET_HISTORY_MAX_GAPS];
+    AranetHistoryRange gaps[ARANET_HISTORY_MAX_GAPS];
+    uint8_t rangeCount = 1;
+    uint8_t gapCount = 0;
+
+    ranges[0].start = start;
+    ranges[0].end = end;
+
+    for (uint8_t attempt = 0; ; attempt++) {
+        uint8_t i = 0;
+        gapCount = 0;
+
+        for (; i < rangeCount && status == AR4_OK; i++) {
+            receiveHistoryV1(ranges[i].start, ranges[i].end, callbacks, param, packet, size, gaps, &gapCount);
+        }
+
+        if (status != AR4_OK) {
+            // Ranges that were not requested are still missing
+            for (; i < rangeCount; i++) addHistoryGap(gaps, &gapCount, ranges[i].start, ranges[i].end);
+            break;
+        }
+
+        if (gapCount == 0) break;
+
+        if (attempt == ARANET_HISTORY_V1_RETRIES) {
+            uint16_t missing = 0;
+            for (uint8_t g = 0; g < gapCount; g++) missing += gaps[g].end - gaps[g].start + 1;
+            transferStats.missing += missing;
+            Serial.printf("History incomplete. Missing %i of %i values\n", missing, end - start + 1);
+            break;
+        }
+
+        transferStats.rerequests += gapCount;
+        memcpy(ranges, gaps, gapCount * sizeof(AranetHistoryRange));
+        rangeCount = gapCount;
+    }
+
+    free(packet);
+
+    // Gaps are in index order. Values past first one are not contiguous.
+    if (gapCount > 0) return gaps[0].start - start;
+    return end - start + 1;
+}
+
+/**
+ * @brief Requests single range of V1 history and receives notifications till
+ *        last index of range arrives, device goes silent, or keeps sending
+ *        packets that do not advance the range.
+ * @param [in] start First index
+ * @param [in] end Last index
+ * @param [in] callbacks Callback receiving data
+ * @param [in] param Parameter to fetch
+ * @param [in] packet Receive buffer of one notification
+ * @param [in] size Receive buffer size
+ * @param [out] gaps Ranges that were not received
+ * @param [in,out] gapCount Number of ranges in gaps
+ * @return Received point count
+ */
+int Aranet4::receiveHistoryV1(uint16_t start, uint16_t end, AranetHistoryCallbacks* callbacks, uint8_t param, uint8_t* packet, uint16_t size, AranetHistoryRange* gaps, uint8_t* gapCount) {
     uint8_t cmd[] = {0x82,param,0x00,0x00,0x01,0x00,0x01,0x00};
 
     memcpy(&cmd[4], (unsigned char*) &start, 2);
     memcpy(&cmd[6], (unsigned char*) &end,   2);
 
+    historyRing.clear();
+    xQueueReset(historyQueue);
+
     status = subscribeHistory(cmd);
-    if (status != AR4_OK) return 0;
+    if (status != AR4_OK) {
+        addHistoryGap(gaps, gapCount, start, end);
+        return 0;
+    }
+
+    AranetHistoryChunk chunk;
+    chunk.param = param;
+    chunk.width = param == AR4_PARAM_HUMIDITY ? 1 : 2;
+
+    // Each packet: param, index of first value (u16), value count, values.
+    // Packets arrive in order, so index jump means notifications were lost.
+    uint32_t next = start;
+    int recvd = 0;
+    uint8_t stalls = 0;
+
+    while (next <= end) {
+        uint16_t len = historyRing.pop(packet, size);
+        if (len == 0) {
+            uint8_t wake;
+            if (!xQueueReceive(historyQueue, &wake, 500 / portTICK_PERIOD_MS)) {
+                Serial.printf("History queue timeout. Received %i, Expected: %i\n", recvd, end - start + 1);
+                break;
+            }
+            continue;
+        }
+
+        uint32_t idx = 0;
+        uint32_t n = 0;
+        const uint8_t* values = packet + 4;
+
+        if (len >= 4 && packet[0] == param) {
+            idx = packet[1] | (packet[2] << 8);
+            n = packet[3];
+            if (4 + n * chunk.width > len) n = (len - 4) / chunk.width;
+        }
+
+        if (n == 0 || idx + n <= next || idx > end) {
+            // stale, other param or out of range
+            if (++stalls >= ARANET_HISTORY_V1_STALLS) {
+                Serial.printf("History stalled. Received %i, Expected: %i\n", recvd, end - start + 1);
+                break;
+            }
+            continue;
+        }
+
+        stalls = 0;
+        if (idx + n - 1 > end) n = end + 1 - idx;
 
-    // wait for queue
-    uint16_t recvd = 0;
-    while (recvd < count) {
-        if (!xQueueReceive(historyQueue, &data[recvd], 500 / portTICK_PERIOD_MS)) {
-            Serial.printf("History queue timeout. Received %i, Expected: %i\n",recvd, count);
+        if (idx > next) {
+            addHistoryGap(gaps, gapCount, next, idx - 1);
+        } else {
+            uint32_t skip = next - idx;
+            values += skip * chunk.width;
+            idx += skip;
+            n -= skip;
+        }
+
+        chunk.start = idx;
+        chunk.count = n;
+        chunk.values = values;
+        recvd += n;
+        next = idx + n;
+
+        if (!callbacks->onHistoryChunk(&chunk)) {
+            status = AR4_ERR_ABORTED;
+            getNotifyHistory()->unsubscribe(false);
             break;
         }
-        recvd++;
     }
-    uint16_t tmp = 0;
-    while (xQueueReceive(historyQueue, &tmp, 100 / portTICK_PERIOD_MS)) {
-        // wait till done
+
+    if (next <= end) {
+        addHistoryGap(gaps, gapCount, next, end);
     }
-    xQueueReset(historyQueue);
+
     return recvd;
 }
 
@@ -551,6 +1597,7 @@ int Aranet4::getHistoryHumidity2(int start, uint16_t count, uint16_t* data) {
  * @return Received point count (smallest)
  */
 int Aranet4::getHistoryV1(int start, uint16_t count, AranetDataCompact* data, uint8_t flags) {
+    beginTransfer();
     uint16_t* temp = (uint16_t*) malloc(count * sizeof(uint16_t));
     int ret = count;
     int result = 0;
@@ -585,7 +1632,7 @@ int Aranet4::getHistoryV1(int start, uint16_t count, AranetDataCompact* data, ui
 
     free(temp);
 
-    return ret;
+    return endTransfer(ret);
 }
 
 /**
@@ -599,78 +1646,509 @@ int Aranet4::getHistoryV2(uint16_t start, uint16_t count, AranetDataCompact* dat
     int ret = count;
     int result = 0;
 
+    beginTransfer();
+
     for (uint16_t param = 1; param < AR4_PARAM_MAX; param++) {
         uint16_t mask = 1 << (param - 1);
         if (params & mask) {
             result = getHistoryChunk(start, count, data, param);
             if (result < ret) ret = result;
+            if (gatt.history == 0) break; // gone after rediscovery
+        }
+    }
+
+    return endTransfer(ret);
+}
+
+int Aranet4::getHistoryChunk(uint16_t start, uint16_t count, AranetDataCompact* data, uint8_t param) {
+    CompactHistoryWriter writer(data, start);
+    return getHistoryByParamV2(start, count, &writer, param);
+}
+
+int Aranet4::getHistoryChunk(uint16_t start, uint16_t count, AranetHistoryColumns* columns, uint8_t param) {
+    return getHistoryByParamV2(start, count, columns, param);
+}
+
+/**
+ * @brief Reads history in to columns, range and parameters are set by
+ *        AranetHistoryColumns::begin() (autodetect v1 or v2)
+ * @param [out] columns Allocated columns
+ * @return Received point count (smallest)
+ */
+int Aranet4::getHistory(AranetHistoryColumns* columns) {
+    status = resolveGatt();
+    if (status != AR4_OK) {
+        return 0;
+    }
+
+    uint16_t start = columns->getStart();
+    uint16_t count = columns->getCount();
+    uint16_t params = columns->getParams();
+
+    // V1 has only Aranet4 parameters
+    if (gatt.history == 0) params &= (AR4_PARAM_FLAGS | AR4_PARAM_HUMIDITY2_FLAG);
+
+    int ret = count;
+    int result = 0;
+
+    beginTransfer();
+
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        if (!(params & (1 << (param - 1)))) continue;
+
+        if (gatt.history != 0) {
+            result = getHistoryChunk(start, count, columns, param);
+        } else {
+            result = getHistoryByParamV1(start, count, columns, param);
         }
+
+        if (result < ret) ret = result;
+        if (status != AR4_OK) break;
     }
 
-    return ret;
+    return endTransfer(ret);
 }
 
-int Aranet4::getHistoryChunk(uint16_t start, uint8_t count, AranetDataCompact* data, uint8_t param) {
+/**
+ * @brief Reads history data and passes every received chunk to callback.
+ *        Only one GATT read buffer is used, regardless of count.
+ * @param [in] start Start index
+ * @param [in] count Data points to read
+ * @param [in] callbacks Callback receiving data
+ * @param [in] param Parameter to fetch
+ * @return Received point count, -1 on error
+ */
+int Aranet4::getHistoryByParamV2(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint8_t param) {
     int end = start + count;
     int pos = 0;
-    AranetHistoryHeader hdr;
-    uint8_t buffer[256];
-    uint16_t len = 256;
+    AranetHistoryChunk chunk;
 
-    uint8_t flen = 2;
+    if (start >= end) return 0;
 
-    switch (param){
-    case AR4_PARAM_HUMIDITY:
-        flen = 1;
-        break;
-    case AR4_PARAM_RADIATION_DOSE:
-    case AR4_PARAM_RADIATION_DOSE_RATE:
-        flen = 3;
-        break;
-    case AR4_PARAM_RADON_CONCENTRATION:
-        flen = 4;
-        break;
-    case AR4_PARAM_RADIATION_DOSE_INTEGRAL:
-        flen = 8;
-        break;
+    // One read response at negotiated MTU
+    uint16_t size = getBytesPerRoundTrip();
+    uint8_t* buffer = (uint8_t*) malloc(size);
+    if (buffer == nullptr) {
+        status = AR4_FAIL;
+        return -1;
     }
 
-    while (start < end) {
-        buffer[0] = 0x61;              // command
-        buffer[1] = param;             // parameter
-        memcpy(buffer + 2, &start, 2); // start addr
+    status = requestHistoryChunk(param, start);
 
-        // write cmd
-        status = writeCmd(buffer, 4);
+    while (start < end && status == AR4_OK) {
+        status = readHistoryChunk(param, start, buffer, size, &chunk);
+        if (status != AR4_OK) break;
+        if (chunk.count == 0) break; // nothing more stored
 
-        if (status != AR4_OK) {
-            Serial.println("History CMD failed");
-            return -1;
+        if (chunk.count > end - start) chunk.count = end - start;
+        start += chunk.count;
+        pos += chunk.count;
+
+        // Pipelined: next request is on its way while this chunk is processed
+        if (historyPipelining && start < end) {
+            status = requestHistoryChunk(param, start);
+            if (status != AR4_OK) break;
+        }
+
+        if (!callbacks->onHistoryChunk(&chunk)) {
+            status = AR4_ERR_ABORTED;
+            break;
+        }
+
+        if (!historyPipelining && start < end) {
+            status = requestHistoryChunk(param, start);
         }
+    }
+
+    free(buffer);
+    if (status != AR4_OK && status != AR4_ERR_ABORTED) return -1;
+    return pos;
+}
+
+/**
+ * @brief Requests V2 history chunk. When pipelining is enabled, command is
+ *        written without response if device allows it.
+ * @param [in] param Parameter to fetch
+ * @param [in] start Index of first value
+ * @param [in] response Always write with response
+ * @return status code
+ */
+ar4_err_t Aranet4::requestHistoryChunk(uint8_t param, uint16_t start, bool response) {
+    uint8_t cmd[4];
+    cmd[0] = 0x61;              // command
+    cmd[1] = param;             // parameter
+    memcpy(cmd + 2, &start, 2); // start addr
+
+    ar4_err_t err = writeCmd(cmd, sizeof(cmd), response || !historyPipelining);
+    if (err != AR4_OK) {
+        Serial.println("History CMD failed");
+    }
+    return err;
+}
+
+/**
+ * @brief Reads V2 history chunk, requested with requestHistoryChunk()
+ * @param [in] param Requested parameter
+ * @param [in] start Requested index of first value
+ * @param [in] buffer Receive buffer, chunk values will point to it
+ * @param [in] size Receive buffer size
+ * @param [out] chunk Received values
+ * @return status code
+ */
+ar4_err_t Aranet4::readHistoryChunk(uint8_t param, uint16_t start, uint8_t* buffer, uint16_t size, AranetHistoryChunk* chunk) {
+    AranetHistoryHeader hdr;
+    uint16_t len;
 
+    for (uint8_t attempt = 0; ; attempt++) {
         // read history data
-        status = getValue(getAranetService(), UUID_Aranet4_History, buffer, &len);
+        len = size;
+        ar4_err_t err = getValue(gatt.history, buffer, &len);
 
-        if (status != AR4_OK || len < sizeof(AranetHistoryHeader)) {
+        if (err != AR4_OK || len < sizeof(AranetHistoryHeader)) {
             Serial.println("History Read failed");
-            return -1;
+            return err != AR4_OK ? err : AR4_FAIL;
         }
 
-        // process history data
+        transferStats.chunks++;
+        transferStats.bytes += len;
+
         memcpy(&hdr, buffer, sizeof(AranetHistoryHeader));
-        uint8_t* histptr = buffer + 10;
-        uint8_t i = 0; // record id
+        if (hdr.param == param && hdr.start == start) break;
 
-        uint64_t val = 0;
-        while (start < end && i < hdr.count) {
-            memcpy(&val, histptr, flen);
-            data[pos].set(param, val);
-            histptr += flen;
-            start++; i++; pos++;
+        // Values of other parameter or index: command written without
+        // response was lost or is late. Write it with response and read again.
+        if (attempt > 0) {
+            Serial.println("History chunk does not match request");
+            return AR4_FAIL;
         }
-    }    
+        transferStats.rerequests++;
+        err = requestHistoryChunk(param, start, true);
+        if (err != AR4_OK) return err;
+    }
 
-    return pos;
+    // process history data
+
+    chunk->param = param;
+    chunk->start = start;
+    chunk->width = getHistoryParamWidth(param);
+    chunk->values = buffer + sizeof(AranetHistoryHeader);
+    chunk->count = hdr.count;
+
+    uint16_t fits = (len - sizeof(AranetHistoryHeader)) / chunk->width;
+    if (chunk->count > fits) chunk->count = fits;
+
+    return AR4_OK;
+}
+
+/**
+ * @brief Reads history and passes it to callback in chunks, as it is received.
+ *        Parameters are downloaded one after another (autodetect v1 or v2).
+ * @param [in] start Start index
+ * @param [in] count Data points to read
+ * @param [in] callbacks Callback receiving data
+ * @param [in] params Parameters to fetch
+ * @return Received point count (smallest)
+ */
+int Aranet4::getHistory(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint16_t params) {
+    status = resolveGatt();
+    if (status != AR4_OK) {
+        return 0;
+    }
+
+    // V1 has only Aranet4 parameters, humidity in one format is enough
+    if (gatt.history == 0) {
+        params &= (AR4_PARAM_FLAGS | AR4_PARAM_HUMIDITY2_FLAG);
+        if (params & AR4_PARAM_HUMIDITY2_FLAG) params &= ~(AR4_PARAM_HUMIDITY_FLAG);
+    }
+
+    int ret = count;
+    int result = 0;
+
+    beginTransfer();
+
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        uint16_t mask = 1 << (param - 1);
+        if (!(params & mask)) continue;
+
+        if (gatt.history != 0) {
+            result = getHistoryByParamV2(start, count, callbacks, param);
+        } else {
+            result = getHistoryByParamV1(start, count, callbacks, param);
+        }
+
+        if (result < ret) ret = result;
+        if (status != AR4_OK) break;
+    }
+
+    return endTransfer(ret);
+}
+
+/**
+ * @brief Reads history of all parameters in a single pass. Parameters are
+ *        requested interleaved, so records are completed from oldest to newest
+ *        and passed to onHistoryRecords() as soon as every parameter is there.
+ *        If connection drops, all delivered records are complete.
+ * @param [in] start Start index
+ * @param [in] count Data points to read
+ * @param [in] callbacks Callback receiving records
+ * @param [in] params Parameters to fetch
+ * @return Complete record count
+ */
+int Aranet4::getHistoryRecords(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint16_t params) {
+    status = resolveGatt();
+    if (status != AR4_OK) {
+        return 0;
+    }
+
+    if (start < 1) start = 1;
+
+    // V1 has only Aranet4 parameters, humidity in one format is enough
+    if (gatt.history == 0) {
+        params &= (AR4_PARAM_FLAGS | AR4_PARAM_HUMIDITY2_FLAG);
+        if (params & AR4_PARAM_HUMIDITY2_FLAG) params &= ~(AR4_PARAM_HUMIDITY_FLAG);
+    }
+
+    if (params == 0) return 0;
+
+    // Window of widest chunk at negotiated MTU, no more than requested. Read
+    // buffer holds one read response and is allocated with rows.
+    uint16_t size = HISTORY_ROWS;
+    uint16_t bufferSize = 0;
+    if (gatt.history != 0) {
+        size = 1;
+        for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+            uint16_t n = getHistoryChunkSize(param);
+            if ((params & (1 << (param - 1))) && n > size) size = n;
+        }
+        bufferSize = getBytesPerRoundTrip();
+    }
+    if (count > 0 && count < size) size = count;
+
+    AranetDataCompact* rows = (AranetDataCompact*) calloc(1, size * sizeof(AranetDataCompact) + bufferSize);
+    if (rows == nullptr) {
+        status = AR4_FAIL;
+        return 0;
+    }
+    uint8_t* buffer = (uint8_t*) (rows + size);
+
+    uint32_t end = (uint32_t) start + count;
+    uint32_t base = start;          // oldest incomplete record
+    uint32_t next[AR4_PARAM_MAX];   // next index to request, per parameter
+    for (uint8_t param = 0; param < AR4_PARAM_MAX; param++) next[param] = start;
+
+    RowHistoryWriter writer(rows, size);
+    AranetHistoryChunk chunk;
+
+    beginTransfer();
+
+    while (base < end && status == AR4_OK) {
+        writer.limit = base + size < end ? base + size : end;
+
+        // Request only parameters that hold back oldest record. Parameters with
+        // wider chunks (eg. 1 byte humidity) are requested less often.
+        uint8_t round[AR4_PARAM_MAX];
+        uint8_t rounds = 0;
+        for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+            if ((params & (1 << (param - 1))) && next[param] == base) round[rounds++] = param;
+        }
+
+        if (gatt.history != 0 && historyPipelining) {
+            status = requestHistoryChunk(round[0], next[round[0]]);
+        }
+
+        for (uint8_t r = 0; r < rounds && status == AR4_OK; r++) {
+            uint8_t param = round[r];
+            int recvd;
+
+            if (gatt.history != 0) {
+                if (!historyPipelining) {
+                    status = requestHistoryChunk(param, next[param]);
+                    if (status != AR4_OK) break;
+                }
+
+                status = readHistoryChunk(param, next[param], buffer, bufferSize, &chunk);
+                if (status != AR4_OK) break;
+
+                // Pipelined: request next parameter before storing this one
+                if (historyPipelining && r + 1 < rounds) {
+                    status = requestHistoryChunk(round[r + 1], next[round[r + 1]]);
+                    if (status != AR4_OK) break;
+                }
+
+                if (chunk.count > writer.limit - next[param]) chunk.count = writer.limit - next[param];
+                writer.onHistoryChunk(&chunk);
+                recvd = chunk.count;
+            } else {
+                uint16_t n = writer.limit - next[param];
+                recvd = getHistoryByParamV1(next[param], n, &writer, param);
+                if (recvd < n) end = next[param] + recvd;
+            }
+
+            if (recvd == 0) end = next[param]; // nothing more stored
+            next[param] += recvd;
+        }
+
+        if (status != AR4_OK) break;
+
+        // Records up to slowest parameter are complete
+        uint32_t complete = end;
+        for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+            if ((params & (1 << (param - 1))) && next[param] < complete) complete = next[param];
+        }
+
+        while (base < complete) {
+            uint16_t slot = base % size;
+            uint16_t n = complete - base;
+            if (n > size - slot) n = size - slot;
+
+            if (!callbacks->onHistoryRecords(base, rows + slot, n)) {
+                status = AR4_ERR_ABORTED;
+                break;
+            }
+            memset(rows + slot, 0, n * sizeof(AranetDataCompact));
+            base += n;
+        }
+    }
+
+    free(rows);
+    return endTransfer(base - start);
+}
+
+/**
+ * @brief Reads log size, interval and age of newest record
+ * @param [in] now Current unix time, seconds
+ * @param [out] timeline Measurement time of log records
+ * @return status code
+ */
+ar4_err_t Aranet4::getHistoryTimeline(uint32_t now, AranetHistoryTimeline* timeline) {
+    timeline->total = getTotalReadings();
+    if (status != AR4_OK) return status;
+    timeline->interval = getInterval();
+    if (status != AR4_OK) return status;
+    uint16_t ago = getSecondsSinceUpdate();
+    if (status != AR4_OK) return status;
+
+    timeline->newest = now - ago;
+    return AR4_OK;
+}
+
+/**
+ * @brief Reads records measured in given time range, with measurement time.
+ *        Only records in range are downloaded.
+ * @param [in] from Unix time, inclusive
+ * @param [in] to Unix time, inclusive
+ * @param [in] now Current unix time, seconds
+ * @param [out] records Received records, oldest first
+ * @param [in] size Size of records array. Newest records are kept if range has more.
+ * @param [in] params Parameters to fetch
+ * @return Received record count, -1 on error
+ */
+int Aranet4::getHistoryByTime(uint32_t from, uint32_t to, uint32_t now, AranetHistoryRecord* records, uint16_t size, uint16_t params) {
+    AranetHistoryTimeline timeline;
+    if (getHistoryTimeline(now, &timeline) != AR4_OK) return -1;
+
+    uint16_t start, count;
+    if (!timeline.range(from, to, &start, &count)) return 0;
+
+    if (count > size) {
+        start += count - size;
+        count = size;
+    }
+
+    TimedRecordWriter writer(records, &timeline, start);
+    int recvd = getHistoryRecords(start, count, &writer, params);
+    return status == AR4_OK ? recvd : -1;
+}
+
+/**
+ * @brief Downloads only records that were added since last sync. New records are
+ *        found from total readings and, after log wraps, from time passed since
+ *        last synced record. Cursor is advanced to last delivered record.
+ * @param [in,out] cursor Sync state of this device. Zeroed cursor syncs whole log.
+ * @param [in] now Current unix time, seconds
+ * @param [in] callbacks Callback receiving records, see getHistoryRecords()
+ * @param [in] params Parameters to fetch
+ * @return Synced record count, -1 on error
+ */
+int Aranet4::syncHistory(AranetHistoryCursor* cursor, uint32_t now, AranetHistoryCallbacks* callbacks, uint16_t params) {
+    if (!isConnected()) {
+        status = AR4_ERR_NOT_CONNECTED;
+        return -1;
+    }
+
+    NimBLEAddress address = pClient->getPeerAddress();
+    if (memcmp(cursor->addr, address.getNative(), 6) != 0) {
+        // Cursor of other device
+        memset(cursor, 0, sizeof(AranetHistoryCursor));
+        memcpy(cursor->addr, address.getNative(), 6);
+    }
+
+    AranetHistoryTimeline timeline;
+    if (getHistoryTimeline(now, &timeline) != AR4_OK) return -1;
+
+    uint16_t total = timeline.total;
+    uint16_t interval = timeline.interval;
+    uint32_t newest = timeline.newest;
+    uint16_t count = total;
+
+    if (total == 0 || interval == 0) return 0;
+
+    if (cursor->timestamp != 0 && total >= cursor->total) {
+        uint32_t added = total - cursor->total;
+
+        // Log is full: total stays same, but older records are dropped
+        if (newest > cursor->timestamp) {
+            uint32_t passed = (newest - cursor->timestamp + interval / 2) / interval;
+            if (passed > added) added = passed;
+        }
+
+        if (added < count) count = added;
+    }
+    // else: never synced, or log was cleared (total decreased)
+
+    if (count == 0) return 0;
+
+    uint16_t start = total - count + 1;
+    int recvd = getHistoryRecords(start, count, callbacks, params);
+
+    if (recvd > 0) {
+        uint16_t last = start + recvd - 1;
+        cursor->total = last;
+        cursor->timestamp = timeline.timeOf(last);
+    }
+
+    return status == AR4_OK ? recvd : -1;
+}
+
+/**
+ * @brief Size of single history value in V2 history protocol
+ * @param [in] param Parameter
+ * @return Value size in bytes
+ */
+uint8_t Aranet4::getHistoryParamWidth(uint8_t param) {
+    switch (param){
+    case AR4_PARAM_HUMIDITY:
+        return 1;
+    case AR4_PARAM_RADIATION_DOSE:
+    case AR4_PARAM_RADIATION_DOSE_RATE:
+        return 3;
+    case AR4_PARAM_RADON_CONCENTRATION:
+        return 4;
+    case AR4_PARAM_RADIATION_DOSE_INTEGRAL:
+        return 8;
+    }
+    return 2;
+}
+
+/**
+ * @brief Values of parameter one V2 history read returns at current MTU,
+ *        device sizes history value to fit in single read response
+ * @param [in] param Parameter
+ * @return Value count
+ */
+uint16_t Aranet4::getHistoryChunkSize(uint8_t param) {
+    uint16_t fits = (getBytesPerRoundTrip() - sizeof(AranetHistoryHeader)) / getHistoryParamWidth(param);
+    return fits < 255 ? fits : 255;
 }
 
 /**
@@ -681,14 +2159,17 @@ int Aranet4::getHistoryChunk(uint16_t start, uint8_t count, AranetDataCompact* d
  * @return Received point count (smallest)
  */
 int Aranet4::getHistory(uint16_t start, uint16_t count, AranetDataCompact* data, uint16_t params) {
-    NimBLERemoteService* pRemoteService = getAranetService();
-    if (pRemoteService == nullptr) {
+    status = resolveGatt();
+    if (status != AR4_OK) {
         return 0;
     }
 
-    NimBLERemoteCharacteristic* pRemoteCharacteristic = pRemoteService->getCharacteristic(UUID_Aranet4_History);
-    if (pRemoteCharacteristic) {
-        return getHistoryV2(start, count, data, params);
+    if (gatt.history != 0) {
+        int ret = getHistoryV2(start, count, data, params);
+        if (gatt.history != 0 || gattStatus != AR4_OK) return ret;
+
+        // Cached handles were stale, rediscovered device has V1 history only
+        status = AR4_OK;
     }
     return getHistoryV1(start, count, data, params);
 }
@@ -10,6 +10,7 @@
 
 #include "Arduino.h"
 #include <NimBLEDevice.h>
+#include <atomic>
 
 #define ARANET4_MANUFACTURER_ID 0x0702
 
@@ -23,6 +24,9 @@ typedef uint16_t ar4_err_t;
 #define AR4_ERR_NO_GATT_CHAR       0x02
 #define AR4_ERR_NO_CLIENT          0x03
 #define AR4_ERR_NOT_CONNECTED      0x04
+#define AR4_ERR_ABORTED            0x05
+#define AR4_ERR_TIMEOUT            0x06
+#define AR4_ERR_TRUNCATED          0x07 // value longer than buffer, buffer holds first part
 
 // Aranet4 specific codes
 #define AR4_PARAM_TEMPERATURE              1
@@ -115,165 +119,306 @@ typedef struct {
 
     uint32_t radon_concentration = 0;
 
-    bool parseFromAdvertisement(uint8_t* data, int len, AranetType type) {
-        int dp = 0;
-
-        this->type = type;
-        switch (type) {
-        case ARANET4:
-            if (len < 22) return false;
-            memcpy(&co2,         (uint8_t*) data + 8, 2);
-            memcpy(&temperature, (uint8_t*) data + 10, 2);
-            memcpy(&pressure,    (uint8_t*) data + 12, 2);
-            memcpy(&interval,    (uint8_t*) data + 17, 2);
-            memcpy(&ago,         (uint8_t*) data + 19, 2);
-            humidity = data[14];
-            battery = data[15];
-            status = data[16];
-            counter = data[21];
-            return true;
-        case ARANET2:
-            if (len < 24) return false;
-            memcpy(&temperature, (uint8_t*) data + 10, 2);
-            memcpy(&humidity,    (uint8_t*) data + 14, 2);
-            memcpy(&interval,    (uint8_t*) data + 19, 2);
-            memcpy(&ago,         (uint8_t*) data + 21, 2);
-            battery = data[17];
-            status = data[18];
-            counter = data[23];
-            return true;
-        case ARANET_RADIATION:
-            if (len < 24) return false;
-
-            // Preclear. Advertisement uses smaller datatypes than GATT
-            radiation_rate = 0;
-            radiation_total = 0;
-            radiation_duration = 0;
-
-            memcpy(&radiation_total,    (uint8_t*) data + 6, 4);
-            memcpy(&radiation_duration, (uint8_t*) data + 10, 4);
-            memcpy(&radiation_rate,     (uint8_t*) data + 14, 2);
-            battery = data[17];
-            memcpy(&interval,    (uint8_t*) data + 19, 2);
-            memcpy(&ago,         (uint8_t*) data + 21, 2);
-            counter = data[23];
-            return true;
-        case ARANET_RADON:
-            radiation_rate = 0;
-
-            memcpy(&radon_concentration, (uint8_t*) data + 8, 2);
-            memcpy(&temperature, (uint8_t*) data + 10, 2);
-            memcpy(&pressure,    (uint8_t*) data + 12, 2);
-            memcpy(&humidity,    (uint8_t*) data + 14, 2);
-            memcpy(&interval,    (uint8_t*) data + 19, 2);
-            memcpy(&ago,         (uint8_t*) data + 21, 2);
-            battery = data[17];
-            status = data[18];
-            counter = data[23];
-            return true;
-        }
+    // Decoders are generated from AranetLayout tables below
+    bool      parseFromAdvertisement(const uint8_t* data, int len, AranetType type);
+    ar4_err_t parseFromGATT(uint8_t* data, int len, AranetType type);
+
+    uint16_t getCO2();
+    float    getTemperature();
+    float    getPressure();
+    float    getHumidity();
+    uint32_t getRadiationRate();
+    uint64_t getRadiationTotal();
+    uint64_t getRadiationDuration();
+    uint16_t getRadonConcentration();
+} AranetData;
+#pragma pack(pop)
+
+// Value of AranetData field, Size bytes at Offset in payload (little endian)
+template<typename T, T AranetData::*Member, uint8_t Offset, uint8_t Size = sizeof(T)>
+struct AranetField {
+    static const uint8_t end = Offset + Size;
 
-        // bad type
-        return false;
+    static inline void decode(AranetData& d, const uint8_t* data) {
+        T val = 0;
+        memcpy(&val, data + Offset, Size);
+        // AranetData is packed, member may be misaligned
+        memcpy(&(d.*Member), &val, sizeof(val));
     }
+};
 
-    ar4_err_t parseFromGATT(uint8_t* data, int len, AranetType type) {
-        this->type = type;
-
-        switch (type) {
-        case ARANET4:
-            if (len < 12) return AR4_FAIL;
-            memcpy(&co2,         (uint8_t*) data + 0, 2);
-            memcpy(&temperature, (uint8_t*) data + 2, 2);
-            memcpy(&pressure,    (uint8_t*) data + 4, 2);
-            memcpy(&interval,    (uint8_t*) data + 9, 2);
-            memcpy(&ago,         (uint8_t*) data + 11, 2);
-
-            humidity = data[6];
-            battery = data[7];
-            status = data[8];
-
-            return AR4_OK;
-        case ARANET2:
-            if (len < 12) return AR4_FAIL;
-            memcpy(&temperature, (uint8_t*) data + 7, 2);
-            memcpy(&humidity,    (uint8_t*) data + 9, 2);
-            memcpy(&interval,    (uint8_t*) data + 2, 2);
-            memcpy(&ago,         (uint8_t*) data + 4, 2);
-
-            battery = data[6];
-            status = data[11];
-
-            return AR4_OK;
-        case ARANET_RADIATION:
-            if (len < 28) return AR4_FAIL;
-            memcpy(&interval,    (uint8_t*) data + 2, 2);
-            memcpy(&ago,         (uint8_t*) data + 4, 2);
-            battery = data[6];
-
-            memcpy(&radiation_rate,     (uint8_t*) data + 7, 4);
-            memcpy(&radiation_total,    (uint8_t*) data + 11, 8);
-            memcpy(&radiation_duration, (uint8_t*) data + 19, 8);
-            status = data[27];
-
-            return AR4_OK;
-        case ARANET_RADON:
-            memcpy(&temperature,         (uint8_t*) data + 7, 2);
-            memcpy(&pressure,            (uint8_t*) data + 9, 2);
-            memcpy(&humidity,            (uint8_t*) data + 11, 2);
-            memcpy(&radon_concentration, (uint8_t*) data + 13, 4);
-            battery = data[6];
-            status = data[17];
-
-            return AR4_OK;
-        }
+// AranetData field that is not in payload, but must be cleared
+template<typename T, T AranetData::*Member>
+struct AranetZero {
+    static const uint8_t end = 0;
 
-        // bad type
-        return AR4_FAIL;
+    static inline void decode(AranetData& d, const uint8_t*) {
+        memset(&(d.*Member), 0, sizeof(T));
     }
+};
 
-    uint16_t getCO2() {
-        if (type == ARANET4) return co2;
-        return -1;
-    }
+// Payload layout: list of fields. Decoder is unrolled at compile time,
+// shortest valid payload is known at compile time too.
+template<typename... Fields>
+struct AranetLayout;
 
-    float getTemperature() {
-        if (type == ARANET4 || type == ARANET2 || type == ARANET_RADON) return temperature / 20.0;
-        return -1.0;
-    }
+template<>
+struct AranetLayout<> {
+    static const uint8_t minLength = 0;
+    static inline void decode(AranetData&, const uint8_t*) {}
+};
 
-    float getPressure() {
-        if (type == ARANET4 || type == ARANET_RADON) return pressure / 10.0;
-        return -1.0;
-    }
+template<typename Field, typename... Fields>
+struct AranetLayout<Field, Fields...> {
+    static const uint8_t minLength = Field::end > AranetLayout<Fields...>::minLength
+                                   ? Field::end : AranetLayout<Fields...>::minLength;
 
-    float getHumidity() {
-        if (type == ARANET2 || type == ARANET_RADON) return humidity / 10.0;
-        if (type == ARANET4) return humidity;
-        return -1.0;
+    static inline void decode(AranetData& d, const uint8_t* data) {
+        Field::decode(d, data);
+        AranetLayout<Fields...>::decode(d, data);
     }
+};
 
-    uint32_t getRadiationRate() {
-        if (type == ARANET_RADIATION) return radiation_rate;
-        return 0;
-    }
+#define ARANET_FIELD(member, offset, size) AranetField<decltype(AranetData::member), &AranetData::member, offset, size>
+#define ARANET_ZERO(member) AranetZero<decltype(AranetData::member), &AranetData::member>
+
+// Payload layouts and unit conversion of each device type.
+// Accessors do not check type, use them when type is known.
+template<AranetType Type>
+struct AranetDevice;
+
+template<>
+struct AranetDevice<ARANET4> {
+    typedef AranetLayout<
+        ARANET_FIELD(co2,         8,  2),
+        ARANET_FIELD(temperature, 10, 2),
+        ARANET_FIELD(pressure,    12, 2),
+        ARANET_FIELD(humidity,    14, 1),
+        ARANET_FIELD(battery,     15, 1),
+        ARANET_FIELD(status,      16, 1),
+        ARANET_FIELD(interval,    17, 2),
+        ARANET_FIELD(ago,         19, 2),
+        ARANET_FIELD(counter,     21, 1)
+    > Advertisement;
+
+    typedef AranetLayout<
+        ARANET_FIELD(co2,         0,  2),
+        ARANET_FIELD(temperature, 2,  2),
+        ARANET_FIELD(pressure,    4,  2),
+        ARANET_FIELD(humidity,    6,  1),
+        ARANET_FIELD(battery,     7,  1),
+        ARANET_FIELD(status,      8,  1),
+        ARANET_FIELD(interval,    9,  2),
+        ARANET_FIELD(ago,         11, 2)
+    > GATT;
+
+    static inline uint16_t co2(const AranetData& d)        { return d.co2; }
+    static inline float temperature(const AranetData& d)   { return d.temperature / 20.0; }
+    static inline float pressure(const AranetData& d)      { return d.pressure / 10.0; }
+    static inline float humidity(const AranetData& d)      { return d.humidity; }
+};
+
+template<>
+struct AranetDevice<ARANET2> {
+    typedef AranetLayout<
+        ARANET_FIELD(temperature, 10, 2),
+        ARANET_FIELD(humidity,    14, 2),
+        ARANET_FIELD(battery,     17, 1),
+        ARANET_FIELD(status,      18, 1),
+        ARANET_FIELD(interval,    19, 2),
+        ARANET_FIELD(ago,         21, 2),
+        ARANET_FIELD(counter,     23, 1)
+    > Advertisement;
+
+    typedef AranetLayout<
+        ARANET_FIELD(interval,    2,  2),
+        ARANET_FIELD(ago,         4,  2),
+        ARANET_FIELD(battery,     6,  1),
+        ARANET_FIELD(temperature, 7,  2),
+        ARANET_FIELD(humidity,    9,  2),
+        ARANET_FIELD(status,      11, 1)
+    > GATT;
+
+    static inline float temperature(const AranetData& d)   { return d.temperature / 20.0; }
+    static inline float humidity(const AranetData& d)      { return d.humidity / 10.0; }
+};
 
-    uint64_t getRadiationTotal() {
-        if (type == ARANET_RADIATION) return radiation_total;
-        return 0;
+template<>
+struct AranetDevice<ARANET_RADIATION> {
+    // Advertisement uses smaller datatypes than GATT, upper bytes are cleared
+    typedef AranetLayout<
+        ARANET_FIELD(radiation_total,    6,  4),
+        ARANET_FIELD(radiation_duration, 10, 4),
+        ARANET_FIELD(radiation_rate,     14, 2),
+        ARANET_FIELD(battery,            17, 1),
+        ARANET_FIELD(interval,           19, 2),
+        ARANET_FIELD(ago,                21, 2),
+        ARANET_FIELD(counter,            23, 1)
+    > Advertisement;
+
+    typedef AranetLayout<
+        ARANET_FIELD(interval,           2,  2),
+        ARANET_FIELD(ago,                4,  2),
+        ARANET_FIELD(battery,            6,  1),
+        ARANET_FIELD(radiation_rate,     7,  4),
+        ARANET_FIELD(radiation_total,    11, 8),
+        ARANET_FIELD(radiation_duration, 19, 8),
+        ARANET_FIELD(status,             27, 1)
+    > GATT;
+
+    static inline uint32_t radiationRate(const AranetData& d)     { return d.radiation_rate; }
+    static inline uint64_t radiationTotal(const AranetData& d)    { return d.radiation_total; }
+    static inline uint64_t radiationDuration(const AranetData& d) { return d.radiation_duration; }
+};
+
+template<>
+struct AranetDevice<ARANET_RADON> {
+    typedef AranetLayout<
+        ARANET_ZERO(radiation_rate),
+        ARANET_FIELD(radon_concentration, 8,  2),
+        ARANET_FIELD(temperature,         10, 2),
+        ARANET_FIELD(pressure,            12, 2),
+        ARANET_FIELD(humidity,            14, 2),
+        ARANET_FIELD(battery,             17, 1),
+        ARANET_FIELD(status,              18, 1),
+        ARANET_FIELD(interval,            19, 2),
+        ARANET_FIELD(ago,                 21, 2),
+        ARANET_FIELD(counter,             23, 1)
+    > Advertisement;
+
+    typedef AranetLayout<
+        ARANET_FIELD(battery,             6,  1),
+        ARANET_FIELD(temperature,         7,  2),
+        ARANET_FIELD(pressure,            9,  2),
+        ARANET_FIELD(humidity,            11, 2),
+        ARANET_FIELD(radon_concentration, 13, 4),
+        ARANET_FIELD(status,              17, 1)
+    > GATT;
+
+    static inline uint16_t radonConcentration(const AranetData& d) { return d.radon_concentration; }
+    static inline float temperature(const AranetData& d)   { return d.temperature / 20.0; }
+    static inline float pressure(const AranetData& d)      { return d.pressure / 10.0; }
+    static inline float humidity(const AranetData& d)      { return d.humidity / 10.0; }
+};
+
+/**
+ * @brief Decode advertisement of known device type, without runtime dispatch
+ * @return false if payload is too short
+ */
+template<AranetType Type>
+inline bool aranetDecodeAdvertisement(AranetData& d, const uint8_t* data, int len) {
+    typedef typename AranetDevice<Type>::Advertisement Layout;
+    d.type = Type;
+    if (len < Layout::minLength) return false;
+    Layout::decode(d, data);
+    return true;
+}
+
+/**
+ * @brief Decode GATT current readings of known device type, without runtime dispatch
+ * @return false if payload is too short
+ */
+template<AranetType Type>
+inline bool aranetDecodeGATT(AranetData& d, const uint8_t* data, int len) {
+    typedef typename AranetDevice<Type>::GATT Layout;
+    d.type = Type;
+    if (len < Layout::minLength) return false;
+    Layout::decode(d, data);
+    return true;
+}
+
+/**
+ * @brief Device type from GATT device name, eg. "Aranet4 12345"
+ */
+inline AranetType aranetTypeFromName(const char* name) {
+    size_t len = strlen(name);
+    char c0 = len > 6 ? name[6] : 0;
+    char c1 = len > 7 ? name[7] : 0;
+    char c2 = len > 8 ? name[8] : 0;
+
+    if (c0 == '4') return ARANET4;
+    if (c0 == '2') return ARANET2;
+    if (c0 == (char) 0xE2 && c1 == (char) 0x98 && c2 == (char) 0xA2) return ARANET_RADIATION;
+    if (c0 == 'R' && c1 == 'n') return ARANET_RADON;
+    return UNKNOWN;
+}
+
+inline bool AranetData::parseFromAdvertisement(const uint8_t* data, int len, AranetType type) {
+    switch (type) {
+    case ARANET4:          return aranetDecodeAdvertisement<ARANET4>(*this, data, len);
+    case ARANET2:          return aranetDecodeAdvertisement<ARANET2>(*this, data, len);
+    case ARANET_RADIATION: return aranetDecodeAdvertisement<ARANET_RADIATION>(*this, data, len);
+    case ARANET_RADON:     return aranetDecodeAdvertisement<ARANET_RADON>(*this, data, len);
+    default:               break;
     }
 
-    uint64_t getRadiationDuration() {
-        if (type == ARANET_RADIATION) return radiation_duration;
-        return 0;
+    // bad type
+    this->type = type;
+    return false;
+}
+
+inline ar4_err_t AranetData::parseFromGATT(uint8_t* data, int len, AranetType type) {
+    bool ok = false;
+    switch (type) {
+    case ARANET4:          ok = aranetDecodeGATT<ARANET4>(*this, data, len); break;
+    case ARANET2:          ok = aranetDecodeGATT<ARANET2>(*this, data, len); break;
+    case ARANET_RADIATION: ok = aranetDecodeGATT<ARANET_RADIATION>(*this, data, len); break;
+    case ARANET_RADON:     ok = aranetDecodeGATT<ARANET_RADON>(*this, data, len); break;
+    default:               this->type = type; break;
+    }
+    return ok ? AR4_OK : AR4_FAIL;
+}
+
+inline uint16_t AranetData::getCO2() {
+    if (type == ARANET4) return AranetDevice<ARANET4>::co2(*this);
+    return -1;
+}
+
+inline float AranetData::getTemperature() {
+    switch (type) {
+    case ARANET4:      return AranetDevice<ARANET4>::temperature(*this);
+    case ARANET2:      return AranetDevice<ARANET2>::temperature(*this);
+    case ARANET_RADON: return AranetDevice<ARANET_RADON>::temperature(*this);
+    default:           return -1.0;
     }
+}
 
-    uint16_t getRadonConcentration() {
-        if (type == ARANET_RADON) return radon_concentration;
-        return -1;
+inline float AranetData::getPressure() {
+    switch (type) {
+    case ARANET4:      return AranetDevice<ARANET4>::pressure(*this);
+    case ARANET_RADON: return AranetDevice<ARANET_RADON>::pressure(*this);
+    default:           return -1.0;
     }
-} AranetData;
-#pragma pack(pop)
+}
+
+inline float AranetData::getHumidity() {
+    switch (type) {
+    case ARANET4:      return AranetDevice<ARANET4>::humidity(*this);
+    case ARANET2:      return AranetDevice<ARANET2>::humidity(*this);
+    case ARANET_RADON: return AranetDevice<ARANET_RADON>::humidity(*this);
+    default:           return -1.0;
+    }
+}
+
+inline uint32_t AranetData::getRadiationRate() {
+    if (type == ARANET_RADIATION) return AranetDevice<ARANET_RADIATION>::radiationRate(*this);
+    return 0;
+}
+
+inline uint64_t AranetData::getRadiationTotal() {
+    if (type == ARANET_RADIATION) return AranetDevice<ARANET_RADIATION>::radiationTotal(*this);
+    return 0;
+}
+
+inline uint64_t AranetData::getRadiationDuration() {
+    if (type == ARANET_RADIATION) return AranetDevice<ARANET_RADIATION>::radiationDuration(*this);
+    return 0;
+}
+
+inline uint16_t AranetData::getRadonConcentration() {
+    if (type == ARANET_RADON) return AranetDevice<ARANET_RADON>::radonConcentration(*this);
+    return -1;
+}
 
 #pragma pack(push, 1)
 typedef struct {
@@ -299,23 +444,49 @@ typedef struct {
     uint8_t packing;
     AranetData data;
 
+    /**
+     * @brief Parse manufacturer data from received advertisement
+     * @param [in] adv Advertised bluetooth device
+     * @return true if advertisement is from Aranet device
+     */
     bool fromAdvertisement(NimBLEAdvertisedDevice* adv) {
-        std::string strManufacturerData = adv->getManufacturerData();
-        int cLength = strManufacturerData.length();
+        return fromPayload(adv->getPayload(), adv->getPayloadLength());
+    }
 
-        if (cLength < 8) return false; // not enough data
-        if (cLength > 100) cLength = 50; // trim
+    /**
+     * @brief Parse manufacturer data from raw advertisement payload (AD structures).
+     *        Payload is decoded in place, nothing is copied or allocated.
+     * @param [in] payload Raw advertisement payload
+     * @param [in] len Payload length
+     * @return true if advertisement is from Aranet device
+     */
+    bool fromPayload(const uint8_t* payload, size_t len) {
+        uint8_t mlen = 0;
+        const uint8_t* mdata = findManufacturerData(payload, len, &mlen);
+        if (mdata == nullptr) return false;
+        return fromManufacturerData(mdata, mlen);
+    }
 
-        uint8_t cManufacturerData[50];
-        strManufacturerData.copy((char *) &manufacturer_id, 2, 0);
-        strManufacturerData.copy((char *) cManufacturerData, cLength, 2);
+    /**
+     * @brief Parse manufacturer data, starting with 2 byte manufacturer id.
+     *        Anything not from ARANET4_MANUFACTURER_ID is rejected before decoding.
+     * @param [in] mdata Manufacturer data
+     * @param [in] len Manufacturer data length
+     * @return true if data is from Aranet device
+     */
+    bool fromManufacturerData(const uint8_t* mdata, size_t len) {
+        if (len < 8) return false; // not enough data
 
         // check manufacturer id
-        if(manufacturer_id != ARANET4_MANUFACTURER_ID) return false;
+        manufacturer_id = mdata[0] | (mdata[1] << 8);
+        if (manufacturer_id != ARANET4_MANUFACTURER_ID) return false;
 
-        int idx = 1;
+        const uint8_t* cManufacturerData = mdata + 2;
+        size_t cLength = len - 2;
+
+        size_t idx = 1;
         // TODO: Check by name
-        if (cLength == 9 || cLength == 24) {
+        if (cLength == 7 || cLength == 22) {
             idx = 0;
             data.type = AranetType::ARANET4;
         } else if (cManufacturerData[0] == 1) {
@@ -329,13 +500,15 @@ typedef struct {
             return false;
         }
 
+        if (cLength < idx + 7) return false;
+
         this->flags.all = cManufacturerData[idx + 0];
         this->version.patch = cManufacturerData[idx + 1];
         this->version.minor = cManufacturerData[idx + 2];
         this->version.major = cManufacturerData[idx + 3] | (cManufacturerData[idx + 4] << 8);
         this->hw_rev = cManufacturerData[idx + 4];
         this->__unknown3 = cManufacturerData[idx + 6];
-        this->packing = cManufacturerData[idx + 7];
+        this->packing = cLength > idx + 7 ? cManufacturerData[idx + 7] : 0;
 
         if (this->flags.bits.integrations) {
             data.parseFromAdvertisement(cManufacturerData, cLength, data.type);
@@ -343,6 +516,61 @@ typedef struct {
 
         return true;
     }
+
+    /**
+     * @brief Read measurement counter from manufacturer data without decoding it.
+     *        Counter changes only when device stores new measurement.
+     * @param [in] mdata Manufacturer data, starting with 2 byte manufacturer id
+     * @param [in] len Manufacturer data length
+     * @param [out] counter Measurement counter
+     * @return true if data is from Aranet device with integrations enabled
+     */
+    static bool peekCounter(const uint8_t* mdata, size_t len, uint8_t* counter) {
+        if (len < 8) return false;
+        if ((mdata[0] | (mdata[1] << 8)) != ARANET4_MANUFACTURER_ID) return false;
+
+        const uint8_t* cManufacturerData = mdata + 2;
+        size_t cLength = len - 2;
+        size_t pos;
+
+        if (cLength == 22) {
+            pos = 21;  // Aranet4
+        } else if (cLength >= 24 && cManufacturerData[0] >= 1 && cManufacturerData[0] <= 3) {
+            pos = 23;
+        } else {
+            return false;
+        }
+
+        size_t idx = cLength == 22 ? 0 : 1;
+        if (!(cManufacturerData[idx] & 0x20)) return false; // integrations disabled
+
+        *counter = cManufacturerData[pos];
+        return true;
+    }
+
+    /**
+     * @brief Find manufacturer specific data (AD type 0xFF) in raw advertisement payload
+     * @param [in] payload Raw advertisement payload
+     * @param [in] len Payload length
+     * @param [out] mlen Manufacturer data length
+     * @return Pointer to manufacturer data inside payload, or nullptr if not found
+     */
+    static const uint8_t* findManufacturerData(const uint8_t* payload, size_t len, uint8_t* mlen) {
+        size_t pos = 0;
+
+        while (pos + 1 < len) {
+            uint8_t flen = payload[pos];
+            if (flen == 0 || pos + 1 + flen > len) break;
+
+            if (payload[pos + 1] == 0xFF) {
+                *mlen = flen - 1;
+                return payload + pos + 2;
+            }
+            pos += flen + 1;
+        }
+
+        return nullptr;
+    }
 } AranetManufacturerData;
 #pragma pack(pop)
 
@@ -406,6 +634,279 @@ typedef union {
     }
 } AranetDataCompact;
 
+// History values of single parameter, as received from device.
+// Values point to receive buffer and are valid only during callback.
+typedef struct {
+    uint8_t        param;
+    uint16_t       start;   // log index of first value, 1 is oldest
+    uint16_t       count;
+    uint8_t        width;   // bytes per value
+    const uint8_t* values;
+
+    uint64_t get(uint16_t i) const {
+        uint64_t val = 0;
+        memcpy(&val, values + i * width, width);
+        return val;
+    }
+} AranetHistoryChunk;
+
+// Statistics of last history download
+typedef struct {
+    uint16_t records = 0;   // received records (smallest count of all params)
+    uint16_t chunks = 0;    // V2 history reads
+    uint32_t bytes = 0;     // V2 history bytes received
+    uint16_t rerequests = 0; // V1 ranges requested again after lost notifications, V2 chunks after mismatch
+    uint16_t missing = 0;   // V1 values not received after all retries
+    uint32_t elapsed = 0;   // download time, ms
+    uint16_t mtu = 0;       // ATT MTU of connection
+    bool     pipelined = false;
+
+    float recordsPerSecond() const {
+        return elapsed > 0 ? records * 1000.0f / elapsed : 0;
+    }
+
+    // V2 history bytes per read, up to MTU - 1
+    float bytesPerRoundTrip() const {
+        return chunks > 0 ? (float) bytes / chunks : 0;
+    }
+} AranetTransferStats;
+
+// Time spent in last connect(), ms. Discovery is counted when attributes are
+// first used, it is 0 if handles came from cache.
+typedef struct {
+    uint32_t connect = 0;     // link establishment
+    uint32_t secure = 0;      // encryption, or pairing if not bonded
+    uint32_t discovery = 0;   // Aranet service and characteristic discovery
+    bool     cached = false;  // attribute handles came from cache
+} AranetConnectStats;
+
+// Connection parameters, in NimBLE units
+typedef struct {
+    uint16_t minInterval;   // 1.25 ms
+    uint16_t maxInterval;   // 1.25 ms
+    uint16_t latency;       // connection events device may skip
+    uint16_t timeout;       // supervision timeout, 10 ms
+} AranetConnParams;
+
+// Attribute handles of Aranet service, 0 if characteristic is missing.
+// Remembered per address for fast reconnect.
+typedef struct {
+    uint8_t    addr[6];
+    AranetType type;            // UNKNOWN until resolved
+    uint16_t   currentReadingsA4;
+    uint16_t   currentReadingsA2;
+    uint16_t   interval;
+    uint16_t   secondsSinceUpdate;
+    uint16_t   totalReadings;
+    uint16_t   cmd;
+    uint16_t   history;
+    uint16_t   notifyHistory;
+    uint8_t    cmdProperties;   // BLE_GATT_CHR_PROP_* of cmd
+} AranetGattHandles;
+
+// Maps log indexes to measurement time. Records are measured every interval
+// seconds, newest record (index total) at time newest.
+typedef struct {
+    uint32_t newest;      // unix time of newest record
+    uint16_t interval;    // seconds between records
+    uint16_t total;       // records stored, 1 is oldest
+
+    uint32_t timeOf(uint16_t index) const {
+        return newest - (uint32_t) (total - index) * interval;
+    }
+
+    /**
+     * @brief Resolve time range to log indexes
+     * @param [in] from Unix time, inclusive
+     * @param [in] to Unix time, inclusive
+     * @param [out] start First record measured at or after from
+     * @param [out] count Records measured from start till to
+     * @return false if no record is in range
+     */
+    bool range(uint32_t from, uint32_t to, uint16_t* start, uint16_t* count) const {
+        *start = 0;
+        *count = 0;
+        if (total == 0 || interval == 0 || from > to || from > newest) return false;
+
+        uint32_t oldest = timeOf(1);
+        if (to < oldest) return false;
+
+        uint32_t first = from <= oldest ? 1 : total - (newest - from) / interval;
+        uint32_t last = to >= newest ? total : total - (newest - to + interval - 1) / interval;
+        if (first > last) return false;
+
+        *start = first;
+        *count = last - first + 1;
+        return true;
+    }
+} AranetHistoryTimeline;
+
+// History record with measurement time
+typedef struct {
+    uint32_t          time;   // unix time
+    AranetDataCompact data;
+} AranetHistoryRecord;
+
+// Incremental history sync state of single device, see Aranet4::syncHistory().
+// Plain data, can be stored as is (eg. in NVS) to survive reboot.
+typedef struct {
+    uint8_t  addr[6];     // device address, NimBLEAddress::getNative() order
+    uint16_t total;       // log index of last synced record
+    uint32_t timestamp;   // unix time of last synced record, 0 if never synced
+} AranetHistoryCursor;
+
+// Range of log indexes, both inclusive
+typedef struct {
+    uint16_t start;
+    uint16_t end;
+} AranetHistoryRange;
+
+class AranetHistoryCallbacks {
+public:
+    virtual ~AranetHistoryCallbacks() {};
+
+    // Values of single parameter, from getHistory(). Return false to stop download.
+    // V1 ranges that were lost and requested again arrive after newer values.
+    virtual bool onHistoryChunk(AranetHistoryChunk* chunk) { return true; };
+
+    // Complete records, oldest first, from getHistoryRecords(). First record has
+    // log index start. Records are valid only during call. Return false to stop download.
+    virtual bool onHistoryRecords(uint16_t start, AranetDataCompact* records, uint16_t count) { return true; };
+};
+
+// Lost V1 history ranges tracked per request. More gaps are merged in to last one.
+#ifndef ARANET_HISTORY_MAX_GAPS
+#define ARANET_HISTORY_MAX_GAPS 8
+#endif
+
+// How many times lost V1 history ranges are requested again
+#ifndef ARANET_HISTORY_V1_RETRIES
+#define ARANET_HISTORY_V1_RETRIES 2
+#endif
+
+// Consecutive V1 history packets that do not advance the range before it
+// is given up, rest of range is then counted as lost
+#ifndef ARANET_HISTORY_V1_STALLS
+#define ARANET_HISTORY_V1_STALLS 16
+#endif
+
+// Largest ATT MTU requested by init(). History read and notification
+// buffers hold one value of this size, 517 fits longest attribute (512).
+#ifndef ARANET_MAX_MTU
+#define ARANET_MAX_MTU 517
+#endif
+
+// Buffer for string values (name, versions), including terminator
+#ifndef ARANET_STRING_SIZE
+#define ARANET_STRING_SIZE 33
+#endif
+
+// Buffer for version strings in AranetDeviceInfo, including terminator
+#ifndef ARANET_VERSION_SIZE
+#define ARANET_VERSION_SIZE 16
+#endif
+
+// Devices whose static info is remembered across connections, shared by all instances
+#ifndef ARANET_INFO_CACHE_SIZE
+#define ARANET_INFO_CACHE_SIZE 8
+#endif
+
+// Devices whose attribute handles are remembered for fast reconnect, shared by all instances
+#ifndef ARANET_GATT_CACHE_SIZE
+#define ARANET_GATT_CACHE_SIZE 8
+#endif
+
+// Connection parameters during history download: shortest interval, device
+// answers in every connection event
+#ifndef ARANET_CONN_BULK
+#define ARANET_CONN_BULK { 6, 12, 0, 400 }
+#endif
+
+// Connection parameters after history download: long interval, device may
+// sleep through 4 events. Reads on such link take up to 1 s per round trip.
+#ifndef ARANET_CONN_IDLE
+#define ARANET_CONN_IDLE { 80, 160, 4, 600 }
+#endif
+
+// Longest wait for previous connection parameter update to take effect, ms.
+// Controller runs one update at a time.
+#ifndef ARANET_CONN_UPDATE_WAIT
+#define ARANET_CONN_UPDATE_WAIT 2000
+#endif
+
+// Smallest power of 2 that is at least n
+constexpr uint32_t aranetPow2(uint32_t n, uint32_t size = 1) {
+    return size >= n ? size : aranetPow2(n, size * 2);
+}
+
+// Bytes buffered for V1 history notifications, per Aranet4 instance. Power of 2.
+// Default holds 4 notifications at ARANET_MAX_MTU (value + 2 byte length each).
+#ifndef ARANET_HISTORY_RING_SIZE
+#define ARANET_HISTORY_RING_SIZE aranetPow2(4 * (ARANET_MAX_MTU - 1))
+#endif
+
+static_assert((ARANET_HISTORY_RING_SIZE & (ARANET_HISTORY_RING_SIZE - 1)) == 0,
+    "ARANET_HISTORY_RING_SIZE must be a power of 2");
+
+// Lock-free single producer / single consumer ring of whole packets.
+// Producer (BLE host task) never blocks: packet is dropped if it doesn't fit.
+class AranetPacketRing {
+public:
+    bool push(const uint8_t* data, uint16_t len) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        if ((uint32_t) len + 2 > ARANET_HISTORY_RING_SIZE - (h - t)) return false;
+
+        uint8_t hdr[2] = { (uint8_t) len, (uint8_t) (len >> 8) };
+        write(h, hdr, 2);
+        write(h + 2, data, len);
+        head.store(h + 2 + len, std::memory_order_release);
+        return true;
+    }
+
+    // Returns packet length, 0 if ring is empty. Packet is truncated to size.
+    uint16_t pop(uint8_t* data, uint16_t size) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        if (h == t) return 0;
+
+        uint8_t hdr[2];
+        read(t, hdr, 2);
+        uint16_t len = hdr[0] | (hdr[1] << 8);
+        uint16_t n = len < size ? len : size;
+        read(t + 2, data, n);
+        tail.store(t + 2 + len, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side: drop everything received so far
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    uint32_t dropped = 0;
+private:
+    uint8_t buf[ARANET_HISTORY_RING_SIZE];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+
+    void write(uint32_t pos, const uint8_t* data, uint16_t len) {
+        uint32_t i = pos & (ARANET_HISTORY_RING_SIZE - 1);
+        uint32_t n = ARANET_HISTORY_RING_SIZE - i;
+        if (n > len) n = len;
+        memcpy(buf + i, data, n);
+        memcpy(buf, data + n, len - n);
+    }
+
+    void read(uint32_t pos, uint8_t* data, uint16_t len) {
+        uint32_t i = pos & (ARANET_HISTORY_RING_SIZE - 1);
+        uint32_t n = ARANET_HISTORY_RING_SIZE - i;
+        if (n > len) n = len;
+        memcpy(data, buf + i, n);
+        memcpy(data + n, buf, len - n);
+    }
+};
+
 class Aranet4Callbacks : public NimBLEClientCallbacks {
     uint32_t onPassKeyRequest() {
         return onPinRequested();
@@ -414,19 +915,41 @@ class Aranet4Callbacks : public NimBLEClientCallbacks {
     virtual uint32_t onPinRequested() = 0;
 };
 
+// Device metadata. Static part is read once per device and cached by
+// address, interval and totalReadings are read on every getDeviceInfo().
+typedef struct {
+    uint8_t    addr[6];     // NimBLEAddress::getNative() byte order
+    AranetType type;
+    char       name[ARANET_STRING_SIZE];
+    char       swVersion[ARANET_VERSION_SIZE];
+    char       fwVersion[ARANET_VERSION_SIZE];
+    char       hwVersion[ARANET_VERSION_SIZE];
+    uint16_t   interval;
+    uint16_t   totalReadings;
+} AranetDeviceInfo;
+
+class AranetHistoryColumns;
+
 class Aranet4 {
 public:
     Aranet4(Aranet4Callbacks* callbacks);
     ~Aranet4();
-    static void init(uint16_t mtu = 247);
+    static void init(uint16_t mtu = ARANET_MAX_MTU);
     ar4_err_t connect(NimBLEAdvertisedDevice* adv, bool secure = true);
     ar4_err_t connect(NimBLEAddress addr, bool secure = true);
     ar4_err_t connect(uint8_t* addr, bool secure = true, uint8_t type = BLE_ADDR_RANDOM);
     ar4_err_t connect(String addr, bool secure = true, uint8_t type = BLE_ADDR_RANDOM);
+    ar4_err_t connect(const char* addr, bool secure = true, uint8_t type = BLE_ADDR_RANDOM);
     ar4_err_t secureConnection();
+    ar4_err_t reconnect();
     void      disconnect();
     void      setConnectTimeout(uint8_t time);
     bool      isConnected();
+    uint16_t  getMTU();
+    uint16_t  getBytesPerRoundTrip();
+    void      setFastReconnect(bool enabled);
+    AranetConnectStats getConnectStats();
+    static void clearGattCache();
 
     AranetData  getCurrentReadings();
     uint16_t    getSecondsSinceUpdate();
@@ -436,8 +959,14 @@ public:
     String      getSwVersion();
     String      getFwVersion();
     String      getHwVersion();
+    ar4_err_t   getName(char* buf, size_t size);
+    ar4_err_t   getSwVersion(char* buf, size_t size);
+    ar4_err_t   getFwVersion(char* buf, size_t size);
+    ar4_err_t   getHwVersion(char* buf, size_t size);
+    ar4_err_t   getDeviceInfo(AranetDeviceInfo* info, bool refresh = false);
+    static void clearDeviceInfoCache();
 
-    ar4_err_t   writeCmd(uint8_t* data, uint16_t len);
+    ar4_err_t   writeCmd(uint8_t* data, uint16_t len, bool response = true);
 
     int         getHistoryCO2(int start, uint16_t count, uint16_t* data);
     int         getHistoryTemperature(int start, uint16_t count, uint16_t* data);
@@ -447,8 +976,24 @@ public:
     int         getHistory(uint16_t start, uint16_t count, AranetDataCompact* data, uint16_t params = AR4_PARAM_FLAGS);
     int         getHistoryV1(int start, uint16_t count, AranetDataCompact* data, uint8_t params = AR4_PARAM_FLAGS);
     int         getHistoryV2(uint16_t start, uint16_t count, AranetDataCompact* data, uint16_t params = AR4_PARAM_FLAGS);
+    int         getHistory(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint16_t params = AR4_PARAM_FLAGS);
+    int         getHistoryRecords(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint16_t params = AR4_PARAM_FLAGS);
+    int         getHistory(AranetHistoryColumns* columns);
+    int         getHistoryByTime(uint32_t from, uint32_t to, uint32_t now, AranetHistoryRecord* records, uint16_t size, uint16_t params = AR4_PARAM_FLAGS);
+    ar4_err_t   getHistoryTimeline(uint32_t now, AranetHistoryTimeline* timeline);
+    int         syncHistory(AranetHistoryCursor* cursor, uint32_t now, AranetHistoryCallbacks* callbacks, uint16_t params = AR4_PARAM_FLAGS);
     ar4_err_t   getStatus();
 
+    void        setHistoryPipelining(bool enabled);
+    void        setConnProfiles(bool enabled);
+    void        setConnProfiles(const AranetConnParams& bulk, const AranetConnParams& idle);
+    void        beginBulk();
+    void        endBulk();
+    AranetTransferStats getTransferStats();
+
+    static uint8_t getHistoryParamWidth(uint8_t param);
+    uint16_t    getHistoryChunkSize(uint8_t param);
+
     AranetType getType();
 
     bool isAranet4();
@@ -457,25 +1002,74 @@ public:
     bool isAranetRadon();
 private:
     NimBLEClient* pClient = nullptr;
+    bool          secureConnect = true;   // secure mode of last connect(), for reconnect()
     ar4_err_t status = AR4_OK;
 
+    // GATT attributes and device type of current connection, resolved once,
+    // by discovery or from handle cache
+    bool                        gattResolved = false;
+    bool                        gattCached = false;
+    ar4_err_t                   gattStatus = AR4_OK;
+    AranetType                  type = UNKNOWN;
+    AranetGattHandles           gatt;
+    NimBLERemoteService*        pAranetService = nullptr;
+    NimBLERemoteCharacteristic* pNotifyHistory = nullptr;  // V1 history, found on first use
+    NimBLERemoteService*        pGenericService = nullptr;
+    NimBLERemoteService*        pCommonService = nullptr;
+
+    bool                fastReconnect = false;
+    AranetConnectStats  connectStats;
+
+    bool                historyPipelining = false;
+    bool                connProfiles = false;
+    AranetConnParams    bulkParams = ARANET_CONN_BULK;
+    AranetConnParams    idleParams = ARANET_CONN_IDLE;
+    uint8_t             bulkDepth = 0;      // open beginBulk() calls
+    bool                bulkActive = false; // bulk parameters requested on current link
+    AranetTransferStats transferStats;
+    bool                transferActive = false;
+    uint16_t            historyTotal = 0;   // log size, cached during transfer
+
+    ar4_err_t resolveGatt();
+    void      invalidateGatt();
     NimBLERemoteService* getAranetService();
-
-    ar4_err_t getValue(NimBLEUUID serviceUuid, NimBLEUUID charUuid, uint8_t* data, uint16_t* len);;
-    ar4_err_t getValue(NimBLERemoteService* service, NimBLEUUID charUuid, uint8_t* data, uint16_t* len);;
-    String    getStringValue(NimBLEUUID serviceUuid, NimBLEUUID charUuid);
-    String    getStringValue(NimBLERemoteService* service, NimBLEUUID charUuid);
-    uint16_t  getU16Value(NimBLEUUID serviceUuid, NimBLEUUID charUuid);
-    uint16_t  getU16Value(NimBLERemoteService* service, NimBLEUUID charUuid);
+    NimBLERemoteCharacteristic* getNotifyHistory();
+    NimBLERemoteService* getGenericService();
+    NimBLERemoteService* getCommonService();
+
+    ar4_err_t getValue(const NimBLEUUID& serviceUuid, const NimBLEUUID& charUuid, uint8_t* data, uint16_t* len);
+    ar4_err_t getValue(NimBLERemoteService* service, const NimBLEUUID& charUuid, uint8_t* data, uint16_t* len);
+    ar4_err_t getStringValue(const NimBLEUUID& serviceUuid, const NimBLEUUID& charUuid, char* buf, size_t size);
+    ar4_err_t getStringValue(NimBLERemoteService* service, const NimBLEUUID& charUuid, char* buf, size_t size);
+    uint16_t  getU16Value(const NimBLEUUID& serviceUuid, const NimBLEUUID& charUuid);
+    uint16_t  getU16Value(NimBLERemoteService* service, const NimBLEUUID& charUuid);
+    ar4_err_t getValue(NimBLERemoteCharacteristic* chr, uint8_t* data, uint16_t* len);
+    ar4_err_t getValue(uint16_t handle, uint8_t* data, uint16_t* len);
+    int       readValue(uint16_t handle, uint8_t* data, uint16_t* len);
+    int       writeValue(uint16_t handle, const uint8_t* data, uint16_t len);
+    uint16_t  getU16Value(NimBLERemoteCharacteristic* chr);
+    uint16_t  getU16Value(uint16_t handle);
 
     // History stuff
     int       getHistoryByParamV1(int start, uint16_t count, uint16_t* data, uint8_t param);
-    int       getHistoryByParamV2(uint16_t start, uint16_t count, AranetDataCompact* data, size_t size, uint8_t param);
-    int       getHistoryChunk(uint16_t start, uint8_t count, AranetDataCompact* data, uint8_t param);
+    int       getHistoryByParamV1(int start, uint16_t count, AranetHistoryCallbacks* callbacks, uint8_t param);
+    int       receiveHistoryV1(uint16_t start, uint16_t end, AranetHistoryCallbacks* callbacks, uint8_t param, uint8_t* packet, uint16_t size, AranetHistoryRange* gaps, uint8_t* gapCount);
+    int       getHistoryByParamV2(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint8_t param);
+    int       getHistoryChunk(uint16_t start, uint16_t count, AranetDataCompact* data, uint8_t param);
+    int       getHistoryChunk(uint16_t start, uint16_t count, AranetHistoryColumns* columns, uint8_t param);
+    ar4_err_t requestHistoryChunk(uint8_t param, uint16_t start, bool response = false);
+    ar4_err_t readHistoryChunk(uint8_t param, uint16_t start, uint8_t* buffer, uint16_t size, AranetHistoryChunk* chunk);
+    void      beginTransfer();
+    bool      requestConnParams(const AranetConnParams& params);
+    int       endTransfer(int records);
     ar4_err_t subscribeHistory(uint8_t* cmd);
 
-    static QueueHandle_t historyQueue;
-    static void historyCallback(BLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+    // V1 history notifications of this instance. Queue only wakes up
+    // consumer, packets are passed through ring.
+    AranetPacketRing historyRing;
+    QueueHandle_t    historyQueue;
+    QueueHandle_t    readQueue;
+    void historyCallback(BLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
 };
 
 #endif
@@ -0,0 +1,602 @@
+/*
+ *  Name:       AranetAsync.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "AranetAsync.h"
+
+QueueHandle_t AranetAsync::events = nullptr;
+AranetAsync*  AranetAsync::connecting = nullptr;
+AranetAsync*  AranetAsync::connectHead = nullptr;
+AranetAsync*  AranetAsync::connectTail = nullptr;
+
+AranetAsync::AranetAsync(Aranet4Callbacks* callbacks, AranetAsyncCallbacks* asyncCallbacks) {
+    this->callbacks = callbacks;
+    this->asyncCallbacks = asyncCallbacks;
+
+    op.type = ARANET_OP_NONE;
+    op.done = true;
+    op.status = AR4_OK;
+    op.result = 0;
+
+    // Shared by all devices, so single process() call serves all of them
+    if (events == nullptr) {
+        events = xQueueCreate(ARANET_ASYNC_QUEUE_SIZE, sizeof(AranetAsyncEvent));
+    }
+}
+
+AranetAsync::~AranetAsync() {
+    if (step != STEP_IDLE) wait(&op);
+    if (connected) wait(disconnect());
+}
+
+/**
+ * @brief Start connection: connect, exchange MTU, secure link and discover
+ *        characteristics. Device type is read from device name, if not given.
+ *        If other device is connecting, attempt waits for it to finish.
+ * @param [in] addr Address of bluetooth device
+ * @param [in] secure Start in secure mode (bonded)
+ * @param [in] type Device type, if known (eg. from advertisement)
+ * @return Operation handle or nullptr if device is busy or connected
+ */
+AranetOp* AranetAsync::connect(NimBLEAddress addr, bool secure, AranetType type) {
+    if (connected) {
+        Serial.println("WARNING: Previous connection was not closed.");
+        return nullptr;
+    }
+    if (begin(ARANET_OP_CONNECT) == nullptr) return nullptr;
+
+    this->address = addr;
+    this->secure = secure;
+    this->type = type;
+    hName = hCurrent = hCurrentA2 = hCmd = hHistory = 0;
+
+    step = STEP_CONNECT;
+    connectNext = nullptr;
+
+    if (connecting == nullptr) {
+        startConnect();
+    } else if (connectTail == nullptr) {
+        connectHead = connectTail = this;
+    } else {
+        connectTail->connectNext = this;
+        connectTail = this;
+    }
+
+    return &op;
+}
+
+// Starts connection attempt. Ends operation if it could not be started.
+void AranetAsync::startConnect() {
+    ble_addr_t peer;
+    peer.type = address.getType();
+    memcpy(peer.val, address.getNative(), 6);
+
+    connecting = this;
+    int rc = ble_gap_connect(BLE_OWN_ADDR_PUBLIC, &peer, connectTimeout, nullptr, onGapEvent, this);
+    if (rc != 0) {
+        connecting = nullptr;
+        Serial.printf("ERROR: Connect failed, rc=%d\n", rc);
+        complete(rc == BLE_HS_ENOMEM ? AR4_ERR_NO_CLIENT : AR4_ERR_NOT_CONNECTED);
+    }
+}
+
+// Starts first queued connection attempt, once previous one is done
+void AranetAsync::connectQueued() {
+    while (connecting == nullptr && connectHead != nullptr) {
+        AranetAsync* dev = connectHead;
+        connectHead = dev->connectNext;
+        if (connectHead == nullptr) connectTail = nullptr;
+        dev->connectNext = nullptr;
+        dev->startConnect();
+    }
+}
+
+/**
+ * @brief Start reading current measurements
+ * @param [out] data Receives readings, must stay valid until operation is done
+ * @return Operation handle or nullptr if device is busy
+ */
+AranetOp* AranetAsync::readCurrent(AranetData* data) {
+    if (begin(ARANET_OP_READ_CURRENT) == nullptr) return nullptr;
+    if (!connected) return complete(AR4_ERR_NOT_CONNECTED);
+
+    uint16_t handle = type == ARANET4 ? hCurrent : hCurrentA2;
+    if (handle == 0) return complete(AR4_ERR_NO_GATT_CHAR);
+
+    this->data = data;
+    step = STEP_READ_CURRENT;
+    if (!read(handle)) return complete(AR4_FAIL);
+
+    return &op;
+}
+
+/**
+ * @brief Start history download. Parameters are read one after another and
+ *        every chunk is passed to onHistoryChunk(), called from process().
+ *        Next chunk is already requested while callback runs. Only V2 history
+ *        is supported.
+ * @param [in] start Start index
+ * @param [in] count Data points to read
+ * @param [in] callbacks Callback receiving data
+ * @param [in] params Parameters to fetch
+ * @return Operation handle or nullptr if device is busy. Result is received
+ *         point count (smallest).
+ */
+AranetOp* AranetAsync::readHistory(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint16_t params) {
+    if (begin(ARANET_OP_HISTORY) == nullptr) return nullptr;
+    if (!connected) return complete(AR4_ERR_NOT_CONNECTED);
+    if (hCmd == 0 || hHistory == 0) return complete(AR4_ERR_NO_GATT_CHAR);
+
+    if (start < 1) start = 1;
+
+    history.callbacks = callbacks;
+    history.params = params;
+    history.param = 0;
+    history.first = start;
+    history.end = (uint32_t) start + count;
+    history.aborted = false;
+    history.retried = false;
+    op.result = count;
+
+    if (!nextParam()) return complete(AR4_OK);
+    if (!inFlight) return complete(AR4_FAIL);
+
+    return &op;
+}
+
+/**
+ * @brief Start disconnect
+ * @return Operation handle or nullptr if device is busy
+ */
+AranetOp* AranetAsync::disconnect() {
+    if (begin(ARANET_OP_DISCONNECT) == nullptr) return nullptr;
+    if (!connected) return complete(AR4_OK);
+
+    close(AR4_OK);
+    return &op;
+}
+
+/**
+ * @brief Wait until operation is done. Events of all devices are processed
+ *        meanwhile. With this, every operation can be used as blocking call.
+ * @param [in] op Operation handle
+ * @param [in] timeout Max time to wait, milliseconds
+ * @return Operation status, AR4_ERR_TIMEOUT if it is still running
+ */
+ar4_err_t AranetAsync::wait(AranetOp* op, uint32_t timeout) {
+    if (op == nullptr) return AR4_FAIL;
+
+    unsigned long start = millis();
+    while (!op->done) {
+        uint32_t left = portMAX_DELAY;
+        if (timeout != portMAX_DELAY) {
+            uint32_t elapsed = millis() - start;
+            if (elapsed >= timeout) return AR4_ERR_TIMEOUT;
+            left = timeout - elapsed;
+        }
+        process(left);
+    }
+
+    return op->status;
+}
+
+/**
+ * @brief Handle completions of all devices. Call from single task, in loop.
+ *        Operation callbacks and history callbacks are called from here.
+ * @param [in] timeout Max time to wait for first event, milliseconds
+ * @return Number of handled events
+ */
+int AranetAsync::process(uint32_t timeout) {
+    if (events == nullptr) return 0;
+
+    AranetAsyncEvent ev;
+    int handled = 0;
+    TickType_t ticks = timeout == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
+
+    while (xQueueReceive(events, &ev, handled == 0 ? ticks : 0) == pdTRUE) {
+        ev.device->handle(ev);
+        handled++;
+    }
+
+    return handled;
+}
+
+/**
+ * @brief Check if operation is in progress
+ */
+bool AranetAsync::isBusy() {
+    return step != STEP_IDLE;
+}
+
+/**
+ * @brief Check if device is connected (connect operation was successful)
+ */
+bool AranetAsync::isConnected() {
+    return connected;
+}
+
+/**
+ * @brief Type of connected device
+ */
+AranetType AranetAsync::getType() {
+    return type;
+}
+
+/**
+ * @brief Address of last connected device
+ */
+NimBLEAddress AranetAsync::getAddress() {
+    return address;
+}
+
+/**
+ * @brief Set the time to wait for connection attempt to complete
+ * @param [in] ms Timeout in milliseconds
+ */
+void AranetAsync::setConnectTimeout(uint32_t ms) {
+    connectTimeout = ms;
+}
+
+AranetOp* AranetAsync::begin(AranetOpType type) {
+    if (step != STEP_IDLE || events == nullptr) return nullptr;
+
+    op.type = type;
+    op.done = false;
+    op.status = AR4_OK;
+    op.result = 0;
+    failStatus = AR4_OK;
+    return &op;
+}
+
+// Called from host task, only queues event
+void AranetAsync::post(Event event, int rc, uint16_t conn) {
+    AranetAsyncEvent ev = { this, event, conn, rc };
+    xQueueSend(events, &ev, portMAX_DELAY);
+}
+
+// Operation ended before any procedure was started. It is still reported
+// from process(), so callbacks never run inside caller.
+AranetOp* AranetAsync::complete(ar4_err_t status) {
+    AranetAsyncEvent ev = { this, EVENT_FINISH, 0, status };
+    step = STEP_FINISH;
+    if (xQueueSend(events, &ev, 0) != pdTRUE) {
+        Serial.println("WARNING: Async event queue is full.");
+        finish(status);
+    }
+    return &op;
+}
+
+void AranetAsync::finish(ar4_err_t status) {
+    step = STEP_IDLE;
+    op.status = status;
+    op.done = true;
+
+    if (asyncCallbacks != nullptr) {
+        asyncCallbacks->onOpDone(this, &op);
+    }
+}
+
+// Closes link after error, operation ends when link is down
+void AranetAsync::close(ar4_err_t status) {
+    failStatus = status;
+    step = STEP_DISCONNECT;
+
+    if (ble_gap_terminate(connHandle, BLE_ERR_REM_USER_CONN_TERM) != 0) {
+        // Link is already gone, its disconnect event is ignored
+        connected = false;
+        complete(failStatus);
+    }
+}
+
+bool AranetAsync::read(uint16_t handle) {
+    len = 0;
+    inFlight = ble_gattc_read_long(connHandle, handle, 0, onRead, this) == 0;
+    return inFlight;
+}
+
+void AranetAsync::handle(const AranetAsyncEvent& ev) {
+    switch (ev.event) {
+    case EVENT_FINISH:
+        finish((ar4_err_t) ev.rc);
+        return;
+    case EVENT_CONNECTED:
+        if (connecting == this) connecting = nullptr;
+        connectQueued();
+        if (ev.rc != 0) {
+            finish(AR4_ERR_NOT_CONNECTED);
+            return;
+        }
+        connHandle = ev.conn;
+        connected = true;
+        step = STEP_MTU;
+        inFlight = ble_gattc_exchange_mtu(connHandle, onMtu, this) == 0;
+        if (!inFlight) close(AR4_FAIL);
+        return;
+    case EVENT_DISCONNECTED:
+        if (!connected || ev.conn != connHandle) return;  // old link
+        connected = false;
+        // Pending procedure fails too, operation ends with its event
+        if (step == STEP_IDLE || inFlight) return;
+        finish(failStatus != AR4_OK || step == STEP_DISCONNECT ? failStatus : AR4_ERR_NOT_CONNECTED);
+        return;
+    case EVENT_ENCRYPTED:
+        if (step != STEP_SECURE) return;
+        if (ev.rc != 0) {
+            Serial.printf("ERROR: Pairing failed, rc=%d\n", ev.rc);
+            close(AR4_FAIL);
+            return;
+        }
+        discover();
+        return;
+    default:
+        onProcedureDone(ev);
+        return;
+    }
+}
+
+void AranetAsync::onProcedureDone(const AranetAsyncEvent& ev) {
+    inFlight = false;
+
+    if (!connected) {
+        finish(failStatus != AR4_OK ? failStatus : AR4_ERR_NOT_CONNECTED);
+        return;
+    }
+
+    switch (step) {
+    case STEP_MTU:
+        // Default MTU still works, only slower
+        if (secure) {
+            step = STEP_SECURE;
+            if (ble_gap_security_initiate(connHandle) != 0) close(AR4_FAIL);
+        } else {
+            discover();
+        }
+        break;
+    case STEP_DISCOVER:
+        if (ev.rc != 0) close(AR4_ERR_NO_GATT_SERVICE);
+        else discovered();
+        break;
+    case STEP_READ_NAME:
+        if (ev.rc == 0) {
+            buffer[len] = 0;
+            type = aranetTypeFromName((const char*) buffer);
+        }
+        finish(AR4_OK);
+        break;
+    case STEP_READ_CURRENT:
+        finish(ev.rc != 0 ? AR4_FAIL : data->parseFromGATT(buffer, len, type));
+        break;
+    case STEP_HISTORY_CMD:
+        if (ev.rc != 0) {
+            Serial.println("History CMD failed");
+            finish(AR4_FAIL);
+        } else if (history.aborted) {
+            finish(AR4_ERR_ABORTED);
+        } else {
+            step = STEP_HISTORY_READ;
+            if (!read(hHistory)) finish(AR4_FAIL);
+        }
+        break;
+    case STEP_HISTORY_READ:
+        if (ev.rc != 0) {
+            Serial.println("History Read failed");
+            finish(AR4_FAIL);
+        } else {
+            historyChunk();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void AranetAsync::discover() {
+    step = STEP_DISCOVER;
+    inFlight = ble_gattc_disc_all_chrs(connHandle, 1, 0xFFFF, onChr, this) == 0;
+    if (!inFlight) close(AR4_FAIL);
+}
+
+void AranetAsync::discovered() {
+    if (hCurrent == 0 && hCurrentA2 == 0) {
+        close(AR4_ERR_NO_GATT_CHAR);
+        return;
+    }
+
+    if (type == UNKNOWN && hCurrent != 0) type = ARANET4;
+
+    // Other types share characteristics, only name tells them apart
+    if (type == UNKNOWN && hName != 0) {
+        step = STEP_READ_NAME;
+        if (!read(hName)) close(AR4_FAIL);
+        return;
+    }
+
+    finish(AR4_OK);
+}
+
+// Decodes received chunk. Next chunk is requested before callback, so
+// device prepares it while callback runs.
+void AranetAsync::historyChunk() {
+    AranetHistoryHeader hdr;
+    AranetHistoryChunk chunk;
+
+    if (len < sizeof(AranetHistoryHeader)) {
+        Serial.println("History Read failed");
+        finish(AR4_FAIL);
+        return;
+    }
+
+    memcpy(&hdr, buffer, sizeof(AranetHistoryHeader));
+
+    // Values of other parameter or index, eg. late command. Request once more.
+    if (hdr.param != history.param || hdr.start != history.start) {
+        if (history.retried) {
+            Serial.println("History chunk does not match request");
+            finish(AR4_FAIL);
+            return;
+        }
+        history.retried = true;
+        requestChunk();
+        if (!inFlight) finish(AR4_FAIL);
+        return;
+    }
+    history.retried = false;
+
+    chunk.param = history.param;
+    chunk.start = history.start;
+    chunk.width = Aranet4::getHistoryParamWidth(history.param);
+    chunk.values = buffer + sizeof(AranetHistoryHeader);
+    chunk.count = hdr.count;
+
+    uint16_t fits = (len - sizeof(AranetHistoryHeader)) / chunk.width;
+    if (chunk.count > fits) chunk.count = fits;
+    if (chunk.count > history.end - history.start) chunk.count = history.end - history.start;
+
+    if (chunk.count == 0) {
+        // nothing more stored
+        paramDone();
+        return;
+    }
+
+    history.start += chunk.count;
+    history.recvd += chunk.count;
+
+    if (history.start < history.end) {
+        requestChunk();
+        if (!inFlight) {
+            finish(AR4_FAIL);
+            return;
+        }
+    }
+
+    if (history.callbacks != nullptr && !history.callbacks->onHistoryChunk(&chunk)) {
+        if (history.recvd < op.result) op.result = history.recvd;
+        history.aborted = true;
+        // Requested chunk is dropped, operation ends when write is done
+        if (!inFlight) finish(AR4_ERR_ABORTED);
+        return;
+    }
+
+    if (history.start >= history.end) paramDone();
+}
+
+void AranetAsync::paramDone() {
+    if (!nextParam()) finish(AR4_OK);
+    else if (!inFlight) finish(AR4_FAIL);
+}
+
+// Requests first chunk of next parameter. Returns false if all parameters
+// are done, inFlight is false if request could not be sent.
+bool AranetAsync::nextParam() {
+    if (history.param > 0 && history.recvd < op.result) op.result = history.recvd;
+
+    if (history.first >= history.end) {
+        op.result = 0;
+        return false;
+    }
+
+    for (uint8_t param = history.param + 1; param < AR4_PARAM_MAX; param++) {
+        if (!(history.params & (1 << (param - 1)))) continue;
+
+        history.param = param;
+        history.start = history.first;
+        history.recvd = 0;
+        requestChunk();
+        return true;
+    }
+
+    if (history.param == 0) op.result = 0;
+    return false;
+}
+
+// Leaves inFlight false if command could not be sent
+void AranetAsync::requestChunk() {
+    uint8_t cmd[4];
+    cmd[0] = 0x61;                      // command
+    cmd[1] = history.param;             // parameter
+    memcpy(cmd + 2, &history.start, 2); // start addr
+
+    step = STEP_HISTORY_CMD;
+    inFlight = ble_gattc_write_flat(connHandle, hCmd, cmd, sizeof(cmd), onWrite, this) == 0;
+}
+
+int AranetAsync::onGapEvent(struct ble_gap_event* event, void* arg) {
+    AranetAsync* dev = (AranetAsync*) arg;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_CONNECT:
+        dev->post(EVENT_CONNECTED, event->connect.status, event->connect.conn_handle);
+        break;
+    case BLE_GAP_EVENT_DISCONNECT:
+        dev->post(EVENT_DISCONNECTED, event->disconnect.reason, event->disconnect.conn.conn_handle);
+        break;
+    case BLE_GAP_EVENT_ENC_CHANGE:
+        dev->post(EVENT_ENCRYPTED, event->enc_change.status, event->enc_change.conn_handle);
+        break;
+    case BLE_GAP_EVENT_PASSKEY_ACTION:
+        if (event->passkey.params.action == BLE_SM_IOACT_INPUT && dev->callbacks != nullptr) {
+            struct ble_sm_io io;
+            io.action = BLE_SM_IOACT_INPUT;
+            io.passkey = ((NimBLEClientCallbacks*) dev->callbacks)->onPassKeyRequest();
+            ble_sm_inject_io(event->passkey.conn_handle, &io);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+int AranetAsync::onMtu(uint16_t conn, const struct ble_gatt_error* error, uint16_t mtu, void* arg) {
+    ((AranetAsync*) arg)->post(EVENT_MTU, error->status, conn);
+    return 0;
+}
+
+int AranetAsync::onChr(uint16_t conn, const struct ble_gatt_error* error, const struct ble_gatt_chr* chr, void* arg) {
+    AranetAsync* dev = (AranetAsync*) arg;
+
+    if (error->status != 0) {
+        dev->post(EVENT_DISCOVERED, error->status == BLE_HS_EDONE ? 0 : error->status, conn);
+        return 0;
+    }
+
+    const ble_uuid_t* uuid = &chr->uuid.u;
+    if (ble_uuid_cmp(uuid, &UUID_Generic_DeviceName.getNative()->u) == 0) dev->hName = chr->val_handle;
+    else if (ble_uuid_cmp(uuid, &UUID_Aranet4_CurrentReadingsDet.getNative()->u) == 0) dev->hCurrent = chr->val_handle;
+    else if (ble_uuid_cmp(uuid, &UUID_Aranet2_CurrentReadings.getNative()->u) == 0) dev->hCurrentA2 = chr->val_handle;
+    else if (ble_uuid_cmp(uuid, &UUID_Aranet4_Cmd.getNative()->u) == 0) dev->hCmd = chr->val_handle;
+    else if (ble_uuid_cmp(uuid, &UUID_Aranet4_History.getNative()->u) == 0) dev->hHistory = chr->val_handle;
+
+    return 0;
+}
+
+// Value fragments are copied in to device buffer, driver task reads it only
+// after event is queued
+int AranetAsync::onRead(uint16_t conn, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg) {
+    AranetAsync* dev = (AranetAsync*) arg;
+
+    if (error->status != 0) {
+        dev->post(EVENT_READ, error->status == BLE_HS_EDONE ? 0 : error->status, conn);
+        return 0;
+    }
+
+    // Keep space for string terminator
+    uint16_t n = OS_MBUF_PKTLEN(attr->om);
+    if (attr->offset + n > sizeof(dev->buffer) - 1) {
+        n = attr->offset < sizeof(dev->buffer) - 1 ? sizeof(dev->buffer) - 1 - attr->offset : 0;
+    }
+    if (n > 0) os_mbuf_copydata(attr->om, 0, n, dev->buffer + attr->offset);
+    uint32_t end = attr->offset + n;
+    dev->len = end < sizeof(dev->buffer) - 1 ? end : sizeof(dev->buffer) - 1;
+
+    return 0;
+}
+
+int AranetAsync::onWrite(uint16_t conn, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg) {
+    ((AranetAsync*) arg)->post(EVENT_WRITTEN, error->status, conn);
+    return 0;
+}
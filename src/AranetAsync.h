@@ -0,0 +1,194 @@
+/*
+ *  Name:       AranetAsync.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Non-blocking device access. Every call starts an operation and returns
+ *  at once with its handle. Operation then moves forward on NimBLE
+ *  completions (GAP events and GATT callbacks), which only queue an event.
+ *  AranetAsync::process(), called from one task, takes events of all
+ *  devices, decodes data and starts next GATT procedure. Single task can
+ *  keep several devices busy, eg. decode history of one device while
+ *  other is connecting. Device needs no task or stack of its own, only
+ *  this object.
+ *
+ *  wait() runs process() until operation is done, it is blocking form of
+ *  every operation. History is read with V2 protocol only.
+ *
+ *  Controller has only one connection attempt in progress at a time, so
+ *  connect() operations are queued and started one after another. Connect
+ *  timeout counts from start of own attempt.
+ */
+
+#ifndef __ARANET_ASYNC_H
+#define __ARANET_ASYNC_H
+
+#include "Aranet4.h"
+
+// Pending completions of all devices, two per device is enough
+#ifndef ARANET_ASYNC_QUEUE_SIZE
+#define ARANET_ASYNC_QUEUE_SIZE 32
+#endif
+
+// Receive buffer of one GATT value, per device. Holds one read response
+// (MTU - 1) and string terminator.
+#ifndef ARANET_ASYNC_BUFFER_SIZE
+#define ARANET_ASYNC_BUFFER_SIZE ARANET_MAX_MTU
+#endif
+
+// Default connect timeout, milliseconds
+#ifndef ARANET_ASYNC_CONNECT_TIMEOUT
+#define ARANET_ASYNC_CONNECT_TIMEOUT 30000
+#endif
+
+typedef enum {
+    ARANET_OP_NONE = 0,
+    ARANET_OP_CONNECT,
+    ARANET_OP_READ_CURRENT,
+    ARANET_OP_HISTORY,
+    ARANET_OP_DISCONNECT
+} AranetOpType;
+
+// Operation handle. Belongs to device and is reused by its next operation.
+typedef struct {
+    AranetOpType type;
+    bool         done;
+    ar4_err_t    status;
+    int          result;  // ARANET_OP_HISTORY: received values, smallest of all params
+} AranetOp;
+
+class AranetAsync;
+
+class AranetAsyncCallbacks {
+public:
+    virtual ~AranetAsyncCallbacks() {};
+
+    // Operation is done, successfully or not. Called from process(), next
+    // operation of device can be started here.
+    virtual void onOpDone(AranetAsync* device, AranetOp* op) {};
+};
+
+class AranetAsync {
+public:
+    AranetAsync(Aranet4Callbacks* callbacks, AranetAsyncCallbacks* asyncCallbacks = nullptr);
+    ~AranetAsync();
+
+    AranetOp*  connect(NimBLEAddress addr, bool secure = true, AranetType type = UNKNOWN);
+    AranetOp*  readCurrent(AranetData* data);
+    AranetOp*  readHistory(uint16_t start, uint16_t count, AranetHistoryCallbacks* callbacks, uint16_t params = AR4_PARAM_FLAGS);
+    AranetOp*  disconnect();
+
+    ar4_err_t  wait(AranetOp* op, uint32_t timeout = portMAX_DELAY);
+
+    bool          isBusy();
+    bool          isConnected();
+    AranetType    getType();
+    NimBLEAddress getAddress();
+    void          setConnectTimeout(uint32_t ms);
+
+    static int process(uint32_t timeout = 0);
+
+    void*      user = nullptr;  // free for application
+private:
+    enum Step : uint8_t {
+        STEP_IDLE,
+        STEP_CONNECT,
+        STEP_MTU,
+        STEP_SECURE,
+        STEP_DISCOVER,
+        STEP_READ_NAME,
+        STEP_READ_CURRENT,
+        STEP_HISTORY_CMD,
+        STEP_HISTORY_READ,
+        STEP_DISCONNECT,
+        STEP_FINISH       // EVENT_FINISH is queued
+    };
+
+    enum Event : uint8_t {
+        EVENT_CONNECTED,
+        EVENT_DISCONNECTED,
+        EVENT_MTU,
+        EVENT_ENCRYPTED,
+        EVENT_DISCOVERED,
+        EVENT_READ,
+        EVENT_WRITTEN,
+        EVENT_FINISH      // operation ended without GATT procedure, rc is status
+    };
+
+    typedef struct {
+        AranetAsync* device;
+        Event        event;
+        uint16_t     conn;
+        int          rc;
+    } AranetAsyncEvent;
+
+    static QueueHandle_t events;
+    static AranetAsync*  connecting;    // connection attempt in progress
+    static AranetAsync*  connectHead;   // waiting for connection attempt
+    static AranetAsync*  connectTail;
+
+    Aranet4Callbacks*     callbacks;
+    AranetAsyncCallbacks* asyncCallbacks;
+    AranetOp              op;
+    Step                  step = STEP_IDLE;
+    ar4_err_t             failStatus = AR4_OK;  // reported when link, closed after error, is down
+
+    NimBLEAddress address;
+    AranetType    type = UNKNOWN;
+    bool          secure = true;
+    uint32_t      connectTimeout = ARANET_ASYNC_CONNECT_TIMEOUT;
+    uint16_t      connHandle = 0;
+    bool          connected = false;
+    bool          inFlight = false;  // GATT procedure started, its event not handled yet
+    AranetAsync*  connectNext = nullptr;
+
+    // Handles from discovery, 0 if missing
+    uint16_t hName = 0;
+    uint16_t hCurrent = 0;     // Aranet4
+    uint16_t hCurrentA2 = 0;   // other types
+    uint16_t hCmd = 0;
+    uint16_t hHistory = 0;
+
+    uint8_t  buffer[ARANET_ASYNC_BUFFER_SIZE];
+    uint16_t len = 0;
+
+    AranetData* data = nullptr;
+
+    struct {
+        AranetHistoryCallbacks* callbacks;
+        uint16_t params;
+        uint8_t  param;
+        uint16_t first;
+        uint16_t start;
+        uint32_t end;
+        int      recvd;
+        bool     aborted;
+        bool     retried;   // chunk did not match request, command was written again
+    } history;
+
+    AranetOp* begin(AranetOpType type);
+    void      post(Event event, int rc, uint16_t conn = 0);
+    AranetOp* complete(ar4_err_t status);
+    void      finish(ar4_err_t status);
+    void      close(ar4_err_t status);
+    void      startConnect();
+    static void connectQueued();
+    void      handle(const AranetAsyncEvent& ev);
+    void      onProcedureDone(const AranetAsyncEvent& ev);
+    void      discover();
+    void      discovered();
+    void      historyChunk();
+    void      paramDone();
+    bool      nextParam();
+    void      requestChunk();
+    bool      read(uint16_t handle);
+
+    static int onGapEvent(struct ble_gap_event* event, void* arg);
+    static int onMtu(uint16_t conn, const struct ble_gatt_error* error, uint16_t mtu, void* arg);
+    static int onChr(uint16_t conn, const struct ble_gatt_error* error, const struct ble_gatt_chr* chr, void* arg);
+    static int onRead(uint16_t conn, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg);
+    static int onWrite(uint16_t conn, const struct ble_gatt_error* error, struct ble_gatt_attr* attr, void* arg);
+};
+
+#endif
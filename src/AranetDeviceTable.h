@@ -0,0 +1,174 @@
+/*
+ *  Name:       AranetDeviceTable.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Fixed size table of last advertised data per device, keyed by BLE address.
+ *  Storage is part of the object, nothing is allocated. When table is full,
+ *  device that was not seen for longest time is replaced. Data is kept as
+ *  AranetReading, use reading.toData() to get AranetData.
+ */
+
+#ifndef __ARANET_DEVICE_TABLE_H
+#define __ARANET_DEVICE_TABLE_H
+
+#include "Aranet4.h"
+#include "AranetReading.h"
+
+typedef struct {
+    uint8_t       addr[6];
+    bool          used;
+    uint32_t      seen;   // millis() of last advertisement
+    AranetReading reading;
+} AranetDeviceEntry;
+
+template<uint8_t N>
+class AranetDeviceTable {
+public:
+    AranetDeviceTable() {
+        clear();
+    }
+
+    /**
+     * @brief Remove all devices
+     */
+    void clear() {
+        for (uint8_t i = 0; i < N; i++) entries[i].used = false;
+        count = 0;
+    }
+
+    /**
+     * @brief Find device by address
+     * @param [in] addr Device address, NimBLEAddress::getNative() byte order
+     * @return Pointer to entry or nullptr if device is not in table
+     */
+    AranetDeviceEntry* find(const uint8_t* addr) {
+        uint8_t slot = home(addr);
+        for (uint8_t i = 0; i < N; i++) {
+            AranetDeviceEntry* e = &entries[slot];
+            if (!e->used) return nullptr;
+            if (memcmp(e->addr, addr, 6) == 0) return e;
+            slot = next(slot);
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Check if device advertises measurement that is not in table yet.
+     *        Only reads table, use update() to store the measurement.
+     * @param [in] addr Device address
+     * @param [in] counter Measurement counter from advertisement
+     * @return true if device is unknown or counter has changed
+     */
+    bool isChanged(const uint8_t* addr, uint8_t counter) {
+        AranetDeviceEntry* e = find(addr);
+        return e == nullptr || e->reading.getCounter() != counter;
+    }
+
+    /**
+     * @brief Store device measurement. Adds device if it is not in table.
+     * @param [in] addr Device address
+     * @param [in] data Decoded advertisement data
+     * @return true if device is new or measurement counter has changed
+     */
+    bool update(const uint8_t* addr, const AranetData& data) {
+        AranetDeviceEntry* e = find(addr);
+        bool changed = e == nullptr || e->reading.getCounter() != data.counter;
+
+        if (e == nullptr) e = insert(addr);
+
+        e->seen = millis();
+        e->reading.pack(data);
+        return changed;
+    }
+
+    /**
+     * @brief Remove device from table
+     * @param [in] addr Device address
+     * @return true if device was removed
+     */
+    bool remove(const uint8_t* addr) {
+        AranetDeviceEntry* e = find(addr);
+        if (e == nullptr) return false;
+        erase(e - entries);
+        return true;
+    }
+
+    uint8_t size() { return count; }
+    uint8_t capacity() { return N; }
+
+    /**
+     * @brief Get entry by slot, for iterating whole table
+     * @param [in] slot Slot index, 0 to capacity() - 1
+     * @return Pointer to entry or nullptr if slot is empty
+     */
+    AranetDeviceEntry* at(uint8_t slot) {
+        if (slot >= N || !entries[slot].used) return nullptr;
+        return &entries[slot];
+    }
+private:
+    AranetDeviceEntry entries[N];
+    uint8_t count;
+
+    static uint8_t home(const uint8_t* addr) {
+        // Lower address bytes are random for random static addresses
+        uint32_t h = addr[0] | (addr[1] << 8) | (addr[2] << 16);
+        h ^= (addr[3] << 5) ^ (addr[4] << 11) ^ (addr[5] << 17);
+        h *= 2654435761u;
+        return (h >> 16) % N;
+    }
+
+    static uint8_t next(uint8_t slot) {
+        return slot + 1 < N ? slot + 1 : 0;
+    }
+
+    AranetDeviceEntry* insert(const uint8_t* addr) {
+        if (count >= N) erase(oldest());
+
+        uint8_t slot = home(addr);
+        while (entries[slot].used) slot = next(slot);
+
+        AranetDeviceEntry* e = &entries[slot];
+        memcpy(e->addr, addr, 6);
+        e->used = true;
+        count++;
+        return e;
+    }
+
+    uint8_t oldest() {
+        uint32_t now = millis();
+        uint8_t slot = 0;
+        uint32_t age = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            if (entries[i].used && now - entries[i].seen >= age) {
+                age = now - entries[i].seen;
+                slot = i;
+            }
+        }
+        return slot;
+    }
+
+    // Linear probing removal: shift following entries back so lookups
+    // never stop at the freed slot
+    void erase(uint8_t slot) {
+        entries[slot].used = false;
+        count--;
+
+        uint8_t hole = slot;
+        uint8_t i = next(slot);
+        while (entries[i].used) {
+            uint8_t h = home(entries[i].addr);
+            // move entry if hole lies cyclically between its home slot and i
+            bool move = (hole <= i) ? (h <= hole || h > i) : (h <= hole && h > i);
+            if (move) {
+                entries[hole] = entries[i];
+                entries[i].used = false;
+                hole = i;
+            }
+            i = next(i);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ *  Name:       AranetFleet.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "AranetFleet.h"
+
+// Passes history to job callbacks, stops download when job deadline passes
+class AranetFleetDeadline : public AranetHistoryCallbacks {
+public:
+    AranetFleetDeadline(AranetHistoryCallbacks* target, unsigned long start, uint32_t timeout)
+        : target(target), start(start), timeout(timeout) {}
+
+    bool expired = false;
+    int  records = 0;
+
+    bool onHistoryRecords(uint16_t first, AranetDataCompact* data, uint16_t count) {
+        records += count;
+        if (target != nullptr && !target->onHistoryRecords(first, data, count)) return false;
+        if (millis() - start >= timeout) {
+            expired = true;
+            return false;
+        }
+        return true;
+    }
+private:
+    AranetHistoryCallbacks* target;
+    unsigned long start;
+    uint32_t timeout;
+};
+
+AranetFleet::AranetFleet(Aranet4Callbacks* callbacks, AranetFleetCallbacks* fleetCallbacks) {
+    this->callbacks = callbacks;
+    this->fleetCallbacks = fleetCallbacks;
+}
+
+AranetFleet::~AranetFleet() {
+    end();
+}
+
+/**
+ * @brief Create client pool and start worker tasks. Every worker keeps own
+ *        Aranet4 (and connection), so workers is also max concurrent
+ *        connections.
+ * @param [in] workers Number of workers, 1 .. ARANET_FLEET_MAX_WORKERS
+ * @return true if workers were started
+ */
+bool AranetFleet::begin(uint8_t workers) {
+    if (isRunning()) return true;
+
+    if (workers == 0) workers = 1;
+    if (workers > ARANET_FLEET_MAX_WORKERS) {
+        Serial.printf("WARNING: Fleet limited to %d workers.\n", ARANET_FLEET_MAX_WORKERS);
+        workers = ARANET_FLEET_MAX_WORKERS;
+    }
+
+    jobQueue = xQueueCreate(ARANET_FLEET_QUEUE_SIZE, sizeof(AranetFleetJob*));
+    // Every job that was sent can finish before run() collects it
+    doneQueue = xQueueCreate(ARANET_FLEET_QUEUE_SIZE + workers, sizeof(AranetFleetJob*));
+    stopped = xSemaphoreCreateCounting(workers, 0);
+    connectLock = xSemaphoreCreateMutex();
+
+    for (uint8_t i = 0; i < workers; i++) {
+        pool[i].fleet = this;
+        pool[i].ar4 = new Aranet4(callbacks);
+
+        if (xTaskCreate(workerTask, "aranet_fleet", ARANET_FLEET_TASK_STACK, &pool[i],
+                        ARANET_FLEET_TASK_PRIORITY, NULL) != pdPASS) {
+            Serial.println("ERROR: Failed to start fleet worker.");
+            delete pool[i].ar4;
+            break;
+        }
+        this->workers++;
+    }
+
+    if (this->workers == 0) {
+        end();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stop worker tasks and free client pool. Waits for jobs that are
+ *        already in progress.
+ */
+void AranetFleet::end() {
+    AranetFleetJob* stop = nullptr;
+
+    for (uint8_t i = 0; i < workers; i++) {
+        xQueueSend(jobQueue, &stop, portMAX_DELAY);
+    }
+
+    for (uint8_t i = 0; i < workers; i++) {
+        xSemaphoreTake(stopped, portMAX_DELAY);
+        delete pool[i].ar4;
+        pool[i].ar4 = nullptr;
+    }
+    workers = 0;
+
+    if (jobQueue != nullptr) vQueueDelete(jobQueue);
+    if (doneQueue != nullptr) vQueueDelete(doneQueue);
+    if (stopped != nullptr) vSemaphoreDelete(stopped);
+    if (connectLock != nullptr) vSemaphoreDelete(connectLock);
+    jobQueue = nullptr;
+    doneQueue = nullptr;
+    stopped = nullptr;
+    connectLock = nullptr;
+}
+
+/**
+ * @brief Check if worker tasks are running
+ */
+bool AranetFleet::isRunning() {
+    return workers > 0;
+}
+
+/**
+ * @brief Number of running workers
+ */
+uint8_t AranetFleet::getWorkerCount() {
+    return workers;
+}
+
+/**
+ * @brief Run jobs on worker pool and wait until all are done. Jobs start in
+ *        array order, as soon as worker is free. Results are written in to
+ *        jobs. Must not be called from multiple tasks at once.
+ * @param [in] jobs Jobs to run
+ * @param [in] count Number of jobs
+ * @return Number of jobs that finished with AR4_OK, -1 if not running
+ */
+int AranetFleet::run(AranetFleetJob* jobs, uint16_t count) {
+    if (!isRunning()) {
+        Serial.println("ERROR: Fleet is not running.");
+        return -1;
+    }
+
+    uint16_t sent = 0;
+    uint16_t done = 0;
+    int ok = 0;
+
+    while (done < count) {
+        // Queue as many as fit, rest is queued when jobs finish
+        while (sent < count) {
+            AranetFleetJob* job = &jobs[sent];
+            if (xQueueSend(jobQueue, &job, 0) != pdTRUE) break;
+            sent++;
+        }
+
+        AranetFleetJob* job;
+        if (xQueueReceive(doneQueue, &job, portMAX_DELAY) == pdTRUE) {
+            if (job->status == AR4_OK) ok++;
+            done++;
+        }
+    }
+
+    return ok;
+}
+
+void AranetFleet::workerTask(void* param) {
+    Worker* worker = (Worker*) param;
+    AranetFleet* fleet = worker->fleet;
+    AranetFleetJob* job;
+
+    for (;;) {
+        if (xQueueReceive(fleet->jobQueue, &job, portMAX_DELAY) != pdTRUE) continue;
+        if (job == nullptr) break;
+
+        fleet->process(worker->ar4, job);
+
+        if (fleet->fleetCallbacks != nullptr) {
+            fleet->fleetCallbacks->onJobDone(job);
+        }
+        xQueueSend(fleet->doneQueue, &job, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(fleet->stopped);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Establish link of job. Only one worker at a time waits for device
+ *        to answer, others wait for lock. Time spent waiting counts to job
+ *        deadline. Encryption runs after lock is released.
+ * @param [in] ar4 Worker client
+ * @param [in] job Job to connect
+ * @param [in] start Job start time, ms
+ * @return status code
+ */
+ar4_err_t AranetFleet::connect(Aranet4* ar4, AranetFleetJob* job, unsigned long start) {
+    uint32_t used = millis() - start;
+    if (used >= job->timeout) {
+        job->expired = true;
+        return AR4_ERR_TIMEOUT;
+    }
+
+    if (xSemaphoreTake(connectLock, (job->timeout - used) / portTICK_PERIOD_MS) != pdTRUE) {
+        job->expired = true;
+        return AR4_ERR_TIMEOUT;
+    }
+
+    // Unreachable device is only noticed by connect timeout, seconds
+    used = millis() - start;
+    uint32_t left = used < job->timeout ? job->timeout - used : 0;
+    if (left > ARANET_FLEET_CONNECT_TIMEOUT) left = ARANET_FLEET_CONNECT_TIMEOUT;
+    uint32_t seconds = (left + 999) / 1000;
+    if (seconds < 1) seconds = 1;
+    if (seconds > 255) seconds = 255;
+    ar4->setConnectTimeout(seconds);
+
+    ar4_err_t status = ar4->connect(job->address, false);
+    xSemaphoreGive(connectLock);
+
+    if (status == AR4_OK && job->secure) status = ar4->secureConnection();
+    return status;
+}
+
+/**
+ * @brief Run single job. Deadline is checked before every operation, connect
+ *        timeout and history download are limited to time that is left.
+ * @param [in] ar4 Worker client
+ * @param [in] job Job to run
+ */
+void AranetFleet::process(Aranet4* ar4, AranetFleetJob* job) {
+    unsigned long start = millis();
+
+    job->status = AR4_OK;
+    job->expired = false;
+    job->data = AranetData();
+    job->records = 0;
+
+    job->status = connect(ar4, job, start);
+
+    if (job->status == AR4_OK && (job->ops & ARANET_JOB_CURRENT)) {
+        if (millis() - start >= job->timeout) {
+            job->expired = true;
+        } else {
+            job->data = ar4->getCurrentReadings();
+            job->status = ar4->getStatus();
+        }
+    }
+
+    if (job->status == AR4_OK && (job->ops & ARANET_JOB_INFO) && job->info != nullptr) {
+        if (millis() - start >= job->timeout) job->expired = true;
+        else job->status = ar4->getDeviceInfo(job->info);
+    }
+
+    if (job->status == AR4_OK && (job->ops & ARANET_JOB_HISTORY) && job->cursor != nullptr) {
+        if (millis() - start >= job->timeout) {
+            job->expired = true;
+        } else {
+            AranetFleetDeadline deadline(job->history, start, job->timeout);
+            int recvd = ar4->syncHistory(job->cursor, job->now, &deadline, job->params);
+            // Cursor is moved past received records even if download was stopped
+            job->records = deadline.records;
+            if (deadline.expired) job->expired = true;
+            else if (recvd < 0) job->status = ar4->getStatus();
+        }
+    }
+
+    ar4->disconnect();
+
+    // Only skipped or stopped operations make job late, not disconnect time
+    job->elapsed = millis() - start;
+    if (job->status == AR4_OK && job->expired) job->status = AR4_ERR_TIMEOUT;
+}
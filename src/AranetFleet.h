@@ -0,0 +1,117 @@
+/*
+ *  Name:       AranetFleet.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Polls many devices from one gateway. Fixed pool of worker tasks, each
+ *  with own Aranet4 (and NimBLEClient), takes jobs from shared queue, so
+ *  up to pool size devices are connected at the same time. Every job has
+ *  own deadline.
+ *
+ *  Controller has only one connection attempt in progress at a time, so
+ *  link setup is serialized between workers. Encryption and reads run in
+ *  parallel. Out of range device holds link setup of every worker for
+ *  ARANET_FLEET_CONNECT_TIMEOUT, not only its own worker.
+ */
+
+#ifndef __ARANET_FLEET_H
+#define __ARANET_FLEET_H
+
+#include "Aranet4.h"
+
+// Worker tasks, also concurrent connections. Limited by controller.
+#ifndef ARANET_FLEET_MAX_WORKERS
+#define ARANET_FLEET_MAX_WORKERS CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#endif
+
+// Jobs waiting for worker
+#ifndef ARANET_FLEET_QUEUE_SIZE
+#define ARANET_FLEET_QUEUE_SIZE 32
+#endif
+
+#ifndef ARANET_FLEET_TASK_STACK
+#define ARANET_FLEET_TASK_STACK 6144
+#endif
+
+#ifndef ARANET_FLEET_TASK_PRIORITY
+#define ARANET_FLEET_TASK_PRIORITY 1
+#endif
+
+// Default job deadline, milliseconds
+#ifndef ARANET_FLEET_TIMEOUT
+#define ARANET_FLEET_TIMEOUT 5000
+#endif
+
+// Longest wait for device to answer connection request, milliseconds.
+// Rounded up to seconds. Should be longer than device advertising interval.
+#ifndef ARANET_FLEET_CONNECT_TIMEOUT
+#define ARANET_FLEET_CONNECT_TIMEOUT 3000
+#endif
+
+// Job operations
+#define ARANET_JOB_CURRENT  0x01  // getCurrentReadings() into data
+#define ARANET_JOB_HISTORY  0x02  // syncHistory() with cursor, records to history callbacks
+#define ARANET_JOB_INFO     0x04  // getDeviceInfo() into info
+
+typedef struct {
+    // Request, set by caller
+    NimBLEAddress           address;
+    uint8_t                 ops = ARANET_JOB_CURRENT;
+    bool                    secure = true;
+    uint32_t                timeout = ARANET_FLEET_TIMEOUT;  // ms from job start
+    AranetHistoryCursor*    cursor = nullptr;   // ARANET_JOB_HISTORY
+    AranetHistoryCallbacks* history = nullptr;  // ARANET_JOB_HISTORY, called from worker task
+    uint16_t                params = AR4_PARAM_FLAGS;
+    uint32_t                now = 0;            // unix time, for syncHistory()
+    AranetDeviceInfo*       info = nullptr;     // ARANET_JOB_INFO
+    void*                   user = nullptr;
+
+    // Result, set by worker
+    ar4_err_t               status = AR4_OK;
+    bool                    expired = false;    // deadline passed, operation skipped or history stopped
+    AranetData              data;
+    int                     records = 0;        // synced history records
+    uint32_t                elapsed = 0;        // ms
+} AranetFleetJob;
+
+class AranetFleetCallbacks {
+public:
+    virtual ~AranetFleetCallbacks() {};
+
+    // Job finished, successfully or not. Called from worker task.
+    virtual void onJobDone(AranetFleetJob* job) {};
+};
+
+class AranetFleet {
+public:
+    AranetFleet(Aranet4Callbacks* callbacks, AranetFleetCallbacks* fleetCallbacks = nullptr);
+    ~AranetFleet();
+
+    bool    begin(uint8_t workers = ARANET_FLEET_MAX_WORKERS);
+    void    end();
+    bool    isRunning();
+    uint8_t getWorkerCount();
+
+    int     run(AranetFleetJob* jobs, uint16_t count);
+private:
+    struct Worker {
+        AranetFleet* fleet;
+        Aranet4*     ar4;
+    };
+
+    Aranet4Callbacks*     callbacks;
+    AranetFleetCallbacks* fleetCallbacks;
+    Worker                pool[ARANET_FLEET_MAX_WORKERS];
+    uint8_t               workers = 0;
+    QueueHandle_t         jobQueue = nullptr;
+    QueueHandle_t         doneQueue = nullptr;
+    SemaphoreHandle_t     stopped = nullptr;
+    SemaphoreHandle_t     connectLock = nullptr;  // one connection attempt at a time
+
+    static void workerTask(void* param);
+    void        process(Aranet4* ar4, AranetFleetJob* job);
+    ar4_err_t   connect(Aranet4* ar4, AranetFleetJob* job, unsigned long start);
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ *  Name:       AranetHistoryColumns.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "AranetHistoryColumns.h"
+
+AranetHistoryColumns::AranetHistoryColumns() {
+    for (uint8_t param = 0; param < AR4_PARAM_MAX; param++) {
+        columns[param] = nullptr;
+        widths[param] = 0;
+    }
+}
+
+AranetHistoryColumns::~AranetHistoryColumns() {
+    end();
+}
+
+/**
+ * @brief Allocate columns. Values that are not received stay 0.
+ * @param [in] start Index of first record
+ * @param [in] count Records to store
+ * @param [in] params Parameters to store, one column each
+ * @return false if memory could not be allocated
+ */
+bool AranetHistoryColumns::begin(uint16_t start, uint16_t count, uint16_t params) {
+    end();
+
+    this->start = start < 1 ? 1 : start;
+    this->count = count;
+    this->params = params;
+
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        if (!(params & (1 << (param - 1)))) continue;
+
+        widths[param] = Aranet4::getHistoryParamWidth(param);
+        columns[param] = (uint8_t*) calloc(count ? count : 1, widths[param]);
+        if (columns[param] == nullptr) {
+            end();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Free all columns
+ */
+void AranetHistoryColumns::end() {
+    for (uint8_t param = 0; param < AR4_PARAM_MAX; param++) {
+        free(columns[param]);
+        columns[param] = nullptr;
+        widths[param] = 0;
+    }
+    count = 0;
+    params = 0;
+}
+
+uint8_t AranetHistoryColumns::getWidth(uint8_t param) {
+    return param < AR4_PARAM_MAX ? widths[param] : 0;
+}
+
+/**
+ * @brief Bytes allocated for values
+ */
+size_t AranetHistoryColumns::getMemoryUsage() {
+    size_t size = 0;
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        size += (size_t) widths[param] * count;
+    }
+    return size;
+}
+
+const uint8_t* AranetHistoryColumns::getColumn(uint8_t param) {
+    return param < AR4_PARAM_MAX ? columns[param] : nullptr;
+}
+
+const uint8_t* AranetHistoryColumns::typed(uint8_t param, uint8_t width) {
+    if (param >= AR4_PARAM_MAX || widths[param] != width) return nullptr;
+    return columns[param];
+}
+
+const uint8_t* AranetHistoryColumns::getU8(uint8_t param) {
+    return typed(param, 1);
+}
+
+const uint16_t* AranetHistoryColumns::getU16(uint8_t param) {
+    return (const uint16_t*) typed(param, 2);
+}
+
+const uint32_t* AranetHistoryColumns::getU32(uint8_t param) {
+    return (const uint32_t*) typed(param, 4);
+}
+
+const uint64_t* AranetHistoryColumns::getU64(uint8_t param) {
+    return (const uint64_t*) typed(param, 8);
+}
+
+uint64_t AranetHistoryColumns::get(uint8_t param, uint16_t i) {
+    uint64_t val = 0;
+    if (param >= AR4_PARAM_MAX || columns[param] == nullptr || i >= count) return 0;
+    memcpy(&val, columns[param] + (size_t) i * widths[param], widths[param]);
+    return val;
+}
+
+/**
+ * @brief Store received values. Wire format matches column format (little
+ *        endian, same width), so chunk is copied as is.
+ */
+bool AranetHistoryColumns::onHistoryChunk(AranetHistoryChunk* chunk) {
+    uint8_t param = chunk->param;
+    if (param >= AR4_PARAM_MAX || columns[param] == nullptr) return true;
+    if (chunk->start < start || chunk->start >= (uint32_t) start + count) return true;
+
+    uint16_t n = chunk->count;
+    uint16_t pos = chunk->start - start;
+    if (n > count - pos) n = count - pos;
+
+    uint8_t width = widths[param];
+    uint8_t* dst = columns[param] + (size_t) pos * width;
+
+    if (chunk->width == width) {
+        memcpy(dst, chunk->values, (size_t) n * width);
+    } else {
+        for (uint16_t i = 0; i < n; i++) {
+            uint64_t val = chunk->get(i);
+            memcpy(dst + (size_t) i * width, &val, width);
+        }
+    }
+    return true;
+}
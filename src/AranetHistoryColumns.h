@@ -0,0 +1,52 @@
+/*
+ *  Name:       AranetHistoryColumns.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  History stored by column: one packed array per parameter, each value
+ *  at its wire width (see Aranet4::getHistoryParamWidth()). Only requested
+ *  parameters use memory and nothing is truncated, eg. radon is 32 bit.
+ */
+
+#ifndef __ARANET_HISTORY_COLUMNS_H
+#define __ARANET_HISTORY_COLUMNS_H
+
+#include "Aranet4.h"
+
+class AranetHistoryColumns : public AranetHistoryCallbacks {
+public:
+    AranetHistoryColumns();
+    ~AranetHistoryColumns();
+
+    bool     begin(uint16_t start, uint16_t count, uint16_t params);
+    void     end();
+
+    uint16_t getStart() { return start; }
+    uint16_t getCount() { return count; }
+    uint16_t getParams() { return params; }
+    uint8_t  getWidth(uint8_t param);
+    size_t   getMemoryUsage();
+
+    // Raw column, getWidth(param) bytes per value. nullptr if param was not requested.
+    const uint8_t*  getColumn(uint8_t param);
+    // Typed column, nullptr if param was not requested or has other width
+    const uint8_t*  getU8(uint8_t param);
+    const uint16_t* getU16(uint8_t param);
+    const uint32_t* getU32(uint8_t param);
+    const uint64_t* getU64(uint8_t param);
+    // Single value of any width, i is 0 for record start
+    uint64_t get(uint8_t param, uint16_t i);
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk);
+private:
+    uint16_t start = 1;
+    uint16_t count = 0;
+    uint16_t params = 0;
+    uint8_t* columns[AR4_PARAM_MAX];
+    uint8_t  widths[AR4_PARAM_MAX];
+
+    const uint8_t* typed(uint8_t param, uint8_t width);
+};
+
+#endif
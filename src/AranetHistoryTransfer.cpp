@@ -0,0 +1,236 @@
+/*
+ *  Name:       AranetHistoryTransfer.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "AranetHistoryTransfer.h"
+
+/**
+ * @brief Prepare history download in to array. Nothing is requested until run().
+ * @param [in] ar4 Connected device
+ * @param [in] start Start index
+ * @param [in] count Data points to read
+ * @param [out] data Pointer to data array, whre results will be stored
+ * @param [in] params Parameters to fetch
+ */
+AranetHistoryTransfer::AranetHistoryTransfer(Aranet4* ar4, uint16_t start, uint16_t count, AranetDataCompact* data, uint16_t params) {
+    if (start < 1) start = 1;
+
+    this->ar4 = ar4;
+    this->data = data;
+    this->start = start;
+    this->end = (uint32_t) start + count;
+    this->params = params;
+
+    for (uint8_t param = 0; param < AR4_PARAM_MAX; param++) {
+        next[param] = start;
+        last[param] = end;
+        aheadCount[param] = 0;
+    }
+}
+
+/**
+ * @brief Set how many times transfer is retried
+ * @param [in] retries Failed requests in a row, without progress, before giving up
+ * @param [in] reconnects Reconnect attempts in a row, without progress, before giving up
+ */
+void AranetHistoryTransfer::setRetries(uint8_t retries, uint8_t reconnects) {
+    maxRetries = retries;
+    maxReconnects = reconnects;
+}
+
+bool AranetHistoryTransfer::isPending(uint8_t param) {
+    return (params & (1 << (param - 1))) && next[param] < last[param];
+}
+
+/**
+ * @brief Download everything that is not received yet. Can be called again
+ *        after failure, already received values are not requested again.
+ *        Connection stays at bulk parameters for whole run.
+ * @return Complete record count, from start
+ */
+int AranetHistoryTransfer::run() {
+    ar4->beginBulk();
+    int records = download();
+    ar4->endBulk();
+    return records;
+}
+
+int AranetHistoryTransfer::download() {
+    uint8_t failures = 0;      // failed requests in a row
+    uint8_t lost = 0;          // reconnects in a row
+    status = AR4_OK;
+
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        if (!isPending(param)) continue;
+
+        while (isPending(param)) {
+            if (!ar4->isConnected()) {
+                if (lost >= maxReconnects) {
+                    status = AR4_ERR_NOT_CONNECTED;
+                    return getRecords();
+                }
+                lost++;
+                reconnects++;
+                Serial.printf("History transfer: reconnecting at #%u\n", next[param]);
+                if (ar4->reconnect() != AR4_OK) continue;
+            }
+
+            // Values past first gap are already here, request only the gap
+            uint32_t before = next[param];
+            uint32_t limit = aheadCount[param] > 0 ? ahead[param][0].start : last[param];
+            ar4->getHistory(next[param], limit - next[param], this, 1 << (param - 1));
+            status = ar4->getStatus();
+
+            if (status == AR4_ERR_ABORTED) return getRecords();
+
+            // V1 values still missing after re-requests: try again from first gap
+            if (status == AR4_OK && ar4->getTransferStats().missing > 0) status = AR4_FAIL;
+
+            if (status == AR4_OK) {
+                // Device has nothing more for this parameter
+                if (next[param] < limit) {
+                    last[param] = next[param];
+                    aheadCount[param] = 0;
+                }
+                failures = 0;
+                lost = 0;
+                continue;
+            }
+
+            if (next[param] > before) {
+                failures = 0;
+                lost = 0;
+            } else if (++failures > maxRetries) {
+                Serial.printf("History transfer: giving up at #%u\n", next[param]);
+                return getRecords();
+            }
+            retries++;
+        }
+    }
+
+    status = AR4_OK;
+    return getRecords();
+}
+
+/**
+ * @brief Store received values and confirm progress
+ */
+bool AranetHistoryTransfer::onHistoryChunk(AranetHistoryChunk* chunk) {
+    uint8_t param = chunk->param;
+    if (chunk->start < start || chunk->start + chunk->count > end) return true;
+
+    AranetDataCompact* dst = data + (chunk->start - start);
+    for (uint16_t i = 0; i < chunk->count; i++) {
+        dst[i].set(param, chunk->get(i));
+    }
+
+    // Values without gap before them are confirmed, values past gap wait for it
+    if (chunk->start <= next[param] && chunk->start + chunk->count > next[param]) {
+        next[param] = chunk->start + chunk->count;
+        confirmAhead(param);
+    } else if (chunk->start > next[param]) {
+        addAhead(param, chunk->start, chunk->start + chunk->count);
+    }
+    return true;
+}
+
+/**
+ * @brief Remember values received past a gap. Touching ranges are merged.
+ *        When list is full, range furthest from next is dropped and will be
+ *        requested again.
+ * @param [in] param Parameter
+ * @param [in] first First received index
+ * @param [in] end One past last received index
+ */
+void AranetHistoryTransfer::addAhead(uint8_t param, uint32_t first, uint32_t end) {
+    AranetHistoryRange* ranges = ahead[param];
+    uint8_t count = aheadCount[param];
+    uint8_t pos = 0;
+
+    while (pos < count && (uint32_t) ranges[pos].end + 1 < first) pos++;
+
+    // Merge with every range it touches
+    uint8_t merged = pos;
+    while (merged < count && ranges[merged].start <= end) {
+        if (ranges[merged].start < first) first = ranges[merged].start;
+        if ((uint32_t) ranges[merged].end + 1 > end) end = ranges[merged].end + 1;
+        merged++;
+    }
+
+    if (merged > pos) {
+        memmove(ranges + pos + 1, ranges + merged, (count - merged) * sizeof(AranetHistoryRange));
+        count -= merged - pos - 1;
+    } else {
+        if (pos == ARANET_TRANSFER_RANGES) return;
+        if (count == ARANET_TRANSFER_RANGES) count--;
+        memmove(ranges + pos + 1, ranges + pos, (count - pos) * sizeof(AranetHistoryRange));
+        count++;
+    }
+
+    ranges[pos].start = first;
+    ranges[pos].end = end - 1;
+    aheadCount[param] = count;
+}
+
+/**
+ * @brief Confirm ranges received earlier, that are no longer behind a gap
+ * @param [in] param Parameter
+ */
+void AranetHistoryTransfer::confirmAhead(uint8_t param) {
+    AranetHistoryRange* ranges = ahead[param];
+    uint8_t done = 0;
+
+    while (done < aheadCount[param] && ranges[done].start <= next[param]) {
+        if ((uint32_t) ranges[done].end + 1 > next[param]) next[param] = ranges[done].end + 1;
+        done++;
+    }
+
+    if (done > 0) {
+        aheadCount[param] -= done;
+        memmove(ranges, ranges + done, aheadCount[param] * sizeof(AranetHistoryRange));
+    }
+}
+
+/**
+ * @brief Is every parameter received
+ */
+bool AranetHistoryTransfer::isComplete() {
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        if (isPending(param)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Confirmed values of single parameter
+ */
+uint16_t AranetHistoryTransfer::getReceived(uint8_t param) {
+    if (param == 0 || param >= AR4_PARAM_MAX) return 0;
+    return next[param] - start;
+}
+
+/**
+ * @brief Records that have all parameters, from start
+ */
+uint16_t AranetHistoryTransfer::getRecords() {
+    uint32_t complete = end;
+    for (uint8_t param = 1; param < AR4_PARAM_MAX; param++) {
+        if ((params & (1 << (param - 1))) && next[param] < complete) complete = next[param];
+    }
+    return complete - start;
+}
+
+uint16_t AranetHistoryTransfer::getRetryCount() {
+    return retries;
+}
+
+uint16_t AranetHistoryTransfer::getReconnectCount() {
+    return reconnects;
+}
+
+ar4_err_t AranetHistoryTransfer::getStatus() {
+    return status;
+}
@@ -0,0 +1,71 @@
+/*
+ *  Name:       AranetHistoryTransfer.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  History download that survives failed reads and lost connections.
+ *  Received values are confirmed per parameter, failed chunk is requested
+ *  again and after reconnect download continues from last good index.
+ *  V1 values received past a gap are kept and confirmed when gap is filled.
+ */
+
+#ifndef __ARANET_HISTORY_TRANSFER_H
+#define __ARANET_HISTORY_TRANSFER_H
+
+#include "Aranet4.h"
+
+// Failed requests in a row, without any progress, before giving up
+#ifndef ARANET_TRANSFER_RETRIES
+#define ARANET_TRANSFER_RETRIES 3
+#endif
+
+// Reconnect attempts in a row, without any progress, before giving up
+#ifndef ARANET_TRANSFER_RECONNECTS
+#define ARANET_TRANSFER_RECONNECTS 5
+#endif
+
+// Received ranges past a gap, per parameter. Confirmed once gap is filled.
+#ifndef ARANET_TRANSFER_RANGES
+#define ARANET_TRANSFER_RANGES 4
+#endif
+
+class AranetHistoryTransfer : public AranetHistoryCallbacks {
+public:
+    AranetHistoryTransfer(Aranet4* ar4, uint16_t start, uint16_t count, AranetDataCompact* data, uint16_t params = AR4_PARAM_FLAGS);
+
+    int       run();
+    bool      isComplete();
+    uint16_t  getReceived(uint8_t param);
+    uint16_t  getRecords();
+    uint16_t  getRetryCount();
+    uint16_t  getReconnectCount();
+    ar4_err_t getStatus();
+
+    void      setRetries(uint8_t retries, uint8_t reconnects);
+
+    bool onHistoryChunk(AranetHistoryChunk* chunk);
+private:
+    Aranet4*           ar4;
+    AranetDataCompact* data;
+    uint16_t           start;
+    uint32_t           end;                 // one past last requested index
+    uint16_t           params;
+    uint32_t           next[AR4_PARAM_MAX]; // first index not received yet, per parameter
+    uint32_t           last[AR4_PARAM_MAX]; // one past last index device has, per parameter
+    AranetHistoryRange ahead[AR4_PARAM_MAX][ARANET_TRANSFER_RANGES]; // received past next, sorted
+    uint8_t            aheadCount[AR4_PARAM_MAX];
+
+    uint8_t            maxRetries = ARANET_TRANSFER_RETRIES;
+    uint8_t            maxReconnects = ARANET_TRANSFER_RECONNECTS;
+    uint16_t           retries = 0;
+    uint16_t           reconnects = 0;
+    ar4_err_t          status = AR4_OK;
+
+    int  download();
+    bool isPending(uint8_t param);
+    void addAhead(uint8_t param, uint32_t first, uint32_t end);
+    void confirmAhead(uint8_t param);
+};
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *  Name:       AranetPollScheduler.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Poll schedule aligned to device measurements. Devices measure every
+ *  interval seconds and report seconds since last measurement (ago), in
+ *  both advertisement and GATT data, so next measurement time is known.
+ *  Every device is due shortly after its next measurement, instead of on
+ *  fixed timer that either fetches same value again or waits long after
+ *  new value was ready.
+ *
+ *  Min-heap of due times, with address index. update(), next() and
+ *  remove() are O(log n). Storage is part of the object, nothing is
+ *  allocated.
+ */
+
+#ifndef __ARANET_POLL_SCHEDULER_H
+#define __ARANET_POLL_SCHEDULER_H
+
+#include "Aranet4.h"
+
+// Delay after expected measurement, milliseconds. Covers 1 s resolution
+// of ago and device clock drift.
+#ifndef ARANET_POLL_MARGIN
+#define ARANET_POLL_MARGIN 2000
+#endif
+
+// Poll period of device that did not report its interval, milliseconds
+#ifndef ARANET_POLL_DEFAULT_PERIOD
+#define ARANET_POLL_DEFAULT_PERIOD 60000
+#endif
+
+typedef struct {
+    uint8_t  addr[6];   // NimBLEAddress::getNative() byte order
+    uint16_t interval;  // measurement interval, seconds, 0 if unknown
+    uint32_t due;       // millis() of next poll
+} AranetPollEntry;
+
+// Address index slots: power of 2, at least twice entry count, so index is
+// at most half full and probe chains stay short
+static constexpr uint32_t aranetPollIndexSlots(uint32_t n, uint32_t slots = 1) {
+    return slots >= 2 * n ? slots : aranetPollIndexSlots(n, slots * 2);
+}
+
+template<uint16_t N>
+class AranetPollScheduler {
+    static_assert(N > 0 && N <= 32768, "AranetPollScheduler size must be 1..32768");
+public:
+    AranetPollScheduler() {
+        clear();
+    }
+
+    /**
+     * @brief Remove all devices
+     */
+    void clear() {
+        for (uint32_t i = 0; i < SLOTS; i++) index[i] = NONE;
+        for (uint16_t i = 0; i < N; i++) freeList[i] = N - 1 - i;
+        count = 0;
+    }
+
+    /**
+     * @brief Set delay between expected measurement and poll
+     * @param [in] ms Delay in milliseconds
+     */
+    void setMargin(uint32_t ms) {
+        margin = ms;
+    }
+
+    /**
+     * @brief Find device by address
+     * @param [in] addr Device address, NimBLEAddress::getNative() byte order
+     * @return Pointer to entry or nullptr if device is not scheduled
+     */
+    AranetPollEntry* find(const uint8_t* addr) {
+        uint16_t slot = lookup(addr);
+        return slot == NONE ? nullptr : &entries[index[slot]];
+    }
+
+    /**
+     * @brief Schedule device after its next measurement. Call with data from
+     *        every poll or advertisement, device is added if it is new.
+     * @param [in] addr Device address
+     * @param [in] data Current readings, interval and ago are used
+     * @param [in] now Current millis()
+     * @return Pointer to entry or nullptr if scheduler is full
+     */
+    AranetPollEntry* update(const uint8_t* addr, const AranetData& data, uint32_t now = millis()) {
+        uint32_t wait = ARANET_POLL_DEFAULT_PERIOD;
+        if (data.interval > 0) {
+            // Measurement older than interval means polls were missed, next
+            // one is still on same phase
+            wait = (data.interval - data.ago % data.interval) * 1000UL + margin;
+        }
+
+        AranetPollEntry* e = schedule(addr, now + wait);
+        if (e != nullptr) e->interval = data.interval;
+        return e;
+    }
+
+    /**
+     * @brief Set poll time of device. Device is added if it is new.
+     * @param [in] addr Device address
+     * @param [in] due millis() of next poll
+     * @return Pointer to entry or nullptr if scheduler is full
+     */
+    AranetPollEntry* schedule(const uint8_t* addr, uint32_t due) {
+        uint16_t slot = lookup(addr);
+        uint16_t id;
+
+        if (slot != NONE) {
+            id = index[slot];
+        } else {
+            if (count >= N) return nullptr;
+            id = freeList[N - 1 - count];
+            memcpy(entries[id].addr, addr, 6);
+            entries[id].interval = 0;
+            insertIndex(addr, id);
+            heap[count] = id;
+            pos[id] = count;
+            count++;
+        }
+
+        entries[id].due = due;
+        restore(pos[id]);
+        return &entries[id];
+    }
+
+    /**
+     * @brief Move poll of device by delay from now, eg. after failed poll
+     * @param [in] e Entry returned by find() or next()
+     * @param [in] delay Delay in milliseconds
+     * @param [in] now Current millis()
+     */
+    void postpone(AranetPollEntry* e, uint32_t delay, uint32_t now = millis()) {
+        uint16_t id = e - entries;
+        e->due = now + delay;
+        restore(pos[id]);
+    }
+
+    /**
+     * @brief Remove device from schedule
+     * @param [in] addr Device address
+     * @return true if device was removed
+     */
+    bool remove(const uint8_t* addr) {
+        uint16_t slot = lookup(addr);
+        if (slot == NONE) return false;
+
+        uint16_t id = index[slot];
+        eraseIndex(slot);
+
+        uint16_t p = pos[id];
+        count--;
+        freeList[N - 1 - count] = id;
+        if (p < count) {
+            heap[p] = heap[count];
+            pos[heap[p]] = p;
+            restore(p);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Device with earliest poll time
+     * @return Pointer to entry or nullptr if no devices are scheduled
+     */
+    AranetPollEntry* peek() {
+        return count > 0 ? &entries[heap[0]] : nullptr;
+    }
+
+    /**
+     * @brief Get device that is due for poll. Device is moved to its next
+     *        expected measurement, so failed poll is retried then. Call
+     *        update() with polled data to keep schedule on measurement phase.
+     * @param [in] now Current millis()
+     * @return Pointer to entry or nullptr if no device is due yet
+     */
+    AranetPollEntry* next(uint32_t now = millis()) {
+        if (count == 0 || before(now, entries[heap[0]].due)) return nullptr;
+
+        uint16_t id = heap[0];
+        AranetPollEntry* e = &entries[id];
+        uint32_t period = e->interval > 0 ? e->interval * 1000UL : ARANET_POLL_DEFAULT_PERIOD;
+        e->due += period;
+        if (before(e->due, now)) e->due = now + period;  // many polls missed
+        siftDown(0);
+        return e;
+    }
+
+    /**
+     * @brief Time until next device is due, eg. for sleeping between polls
+     * @param [in] now Current millis()
+     * @return Milliseconds, 0 if device is already due, -1 if none scheduled
+     */
+    int32_t timeToNext(uint32_t now = millis()) {
+        if (count == 0) return -1;
+        int32_t t = (int32_t) (entries[heap[0]].due - now);
+        return t > 0 ? t : 0;
+    }
+
+    uint16_t size() { return count; }
+    uint16_t capacity() { return N; }
+private:
+    static const uint16_t NONE = 0xFFFF;
+    static const uint32_t SLOTS = aranetPollIndexSlots(N);
+
+    AranetPollEntry entries[N];
+    uint16_t heap[N];      // entry ids, heap order by due
+    uint16_t pos[N];       // heap position of entry id
+    uint16_t index[SLOTS]; // open addressing address index, entry ids
+    uint16_t freeList[N];  // unused entry ids, last N - count are free
+    uint16_t count;
+    uint32_t margin = ARANET_POLL_MARGIN;
+
+    // millis() wraps, compare by difference
+    static bool before(uint32_t a, uint32_t b) {
+        return (int32_t) (a - b) < 0;
+    }
+
+    bool less(uint16_t a, uint16_t b) {
+        return before(entries[heap[a]].due, entries[heap[b]].due);
+    }
+
+    void swap(uint16_t a, uint16_t b) {
+        uint16_t t = heap[a];
+        heap[a] = heap[b];
+        heap[b] = t;
+        pos[heap[a]] = a;
+        pos[heap[b]] = b;
+    }
+
+    void siftUp(uint16_t p) {
+        while (p > 0) {
+            uint16_t parent = (p - 1) / 2;
+            if (!less(p, parent)) break;
+            swap(p, parent);
+            p = parent;
+        }
+    }
+
+    void siftDown(uint16_t p) {
+        for (;;) {
+            uint16_t l = 2 * p + 1;
+            if (l >= count) break;
+            uint16_t c = (l + 1 < count && less(l + 1, l)) ? l + 1 : l;
+            if (!less(c, p)) break;
+            swap(p, c);
+            p = c;
+        }
+    }
+
+    // Due time of entry at heap position p has changed
+    void restore(uint16_t p) {
+        if (p > 0 && less(p, (p - 1) / 2)) siftUp(p);
+        else siftDown(p);
+    }
+
+    static uint16_t home(const uint8_t* addr) {
+        // Lower address bytes are random for random static addresses
+        uint32_t h = addr[0] | (addr[1] << 8) | (addr[2] << 16);
+        h ^= (addr[3] << 5) ^ (addr[4] << 11) ^ (addr[5] << 17);
+        h *= 2654435761u;
+        return (h >> 16) & (SLOTS - 1);
+    }
+
+    static uint16_t nextSlot(uint16_t slot) {
+        return (slot + 1) & (SLOTS - 1);
+    }
+
+    uint16_t lookup(const uint8_t* addr) {
+        uint16_t slot = home(addr);
+        for (uint32_t i = 0; i < SLOTS; i++) {
+            if (index[slot] == NONE) return NONE;
+            if (memcmp(entries[index[slot]].addr, addr, 6) == 0) return slot;
+            slot = nextSlot(slot);
+        }
+        return NONE;
+    }
+
+    void insertIndex(const uint8_t* addr, uint16_t id) {
+        uint16_t slot = home(addr);
+        while (index[slot] != NONE) slot = nextSlot(slot);
+        index[slot] = id;
+    }
+
+    // Linear probing removal, same as AranetDeviceTable
+    void eraseIndex(uint16_t slot) {
+        index[slot] = NONE;
+
+        uint16_t hole = slot;
+        uint16_t i = nextSlot(slot);
+        while (index[i] != NONE) {
+            uint16_t h = home(entries[index[i]].addr);
+            bool move = (hole <= i) ? (h <= hole || h > i) : (h <= hole && h > i);
+            if (move) {
+                index[hole] = index[i];
+                index[i] = NONE;
+                hole = i;
+            }
+            i = nextSlot(i);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ *  Name:       AranetReading.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ *
+ *  Compact readings, sized to device type. AranetData has fields of every
+ *  device type, these keep only fields that device type can report.
+ *  Conversion to and from AranetData is lossless.
+ *
+ *  AranetReading4 .. AranetReadingRadon - one device type, for arrays and
+ *                   windows of single device.
+ *  AranetReading  - tagged union of all types, for tables of mixed devices.
+ *                   Can be serialized with only size() bytes used.
+ */
+
+#ifndef __ARANET_READING_H
+#define __ARANET_READING_H
+
+#include "Aranet4.h"
+
+#pragma pack(push, 1)
+// Fields common to all device types
+struct AranetReadingCommon {
+    uint8_t  battery;
+    uint8_t  status;
+    uint8_t  counter;
+    uint16_t interval;
+    uint16_t ago;
+
+    void pack(const AranetData& d) {
+        battery = d.battery;
+        status = d.status;
+        counter = d.counter;
+        interval = d.interval;
+        ago = d.ago;
+    }
+
+    void unpack(AranetData& d) const {
+        d.battery = battery;
+        d.status = status;
+        d.counter = counter;
+        d.interval = interval;
+        d.ago = ago;
+    }
+};
+
+struct AranetReading4 {
+    static const AranetType type = ARANET4;
+
+    AranetReadingCommon common;
+    uint16_t co2;
+    uint16_t temperature;
+    uint16_t pressure;
+    uint16_t humidity;
+
+    void pack(const AranetData& d) {
+        common.pack(d);
+        co2 = d.co2;
+        temperature = d.temperature;
+        pressure = d.pressure;
+        humidity = d.humidity;
+    }
+
+    void unpack(AranetData& d) const {
+        d.type = type;
+        common.unpack(d);
+        d.co2 = co2;
+        d.temperature = temperature;
+        d.pressure = pressure;
+        d.humidity = humidity;
+    }
+};
+
+struct AranetReading2 {
+    static const AranetType type = ARANET2;
+
+    AranetReadingCommon common;
+    uint16_t temperature;
+    uint16_t humidity;
+
+    void pack(const AranetData& d) {
+        common.pack(d);
+        temperature = d.temperature;
+        humidity = d.humidity;
+    }
+
+    void unpack(AranetData& d) const {
+        d.type = type;
+        common.unpack(d);
+        d.temperature = temperature;
+        d.humidity = humidity;
+    }
+};
+
+struct AranetReadingRadiation {
+    static const AranetType type = ARANET_RADIATION;
+
+    AranetReadingCommon common;
+    uint32_t pulses;
+    uint32_t rate;
+    uint64_t total;
+    uint64_t duration;
+
+    void pack(const AranetData& d) {
+        common.pack(d);
+        pulses = d.radiation_pulses;
+        rate = d.radiation_rate;
+        total = d.radiation_total;
+        duration = d.radiation_duration;
+    }
+
+    void unpack(AranetData& d) const {
+        d.type = type;
+        common.unpack(d);
+        d.radiation_pulses = pulses;
+        d.radiation_rate = rate;
+        d.radiation_total = total;
+        d.radiation_duration = duration;
+    }
+};
+
+struct AranetReadingRadon {
+    static const AranetType type = ARANET_RADON;
+
+    AranetReadingCommon common;
+    uint32_t radon_concentration;
+    uint16_t temperature;
+    uint16_t pressure;
+    uint16_t humidity;
+
+    void pack(const AranetData& d) {
+        common.pack(d);
+        radon_concentration = d.radon_concentration;
+        temperature = d.temperature;
+        pressure = d.pressure;
+        humidity = d.humidity;
+    }
+
+    void unpack(AranetData& d) const {
+        d.type = type;
+        common.unpack(d);
+        d.radon_concentration = radon_concentration;
+        d.temperature = temperature;
+        d.pressure = pressure;
+        d.humidity = humidity;
+    }
+};
+
+// Reading of any device type. Size is set by largest type (Radiation),
+// use write()/read() to store only bytes used by actual type.
+struct AranetReading {
+    uint8_t type;
+    union {
+        AranetReadingCommon    common;
+        AranetReading4         aranet4;
+        AranetReading2         aranet2;
+        AranetReadingRadiation aranetr;
+        AranetReadingRadon     aranetrn;
+    };
+
+    /**
+     * @brief Store fields of data.type. Other fields are not stored.
+     * @param [in] d Data to store
+     */
+    void pack(const AranetData& d) {
+        type = d.type;
+        switch (d.type) {
+        case ARANET4:          aranet4.pack(d); break;
+        case ARANET2:          aranet2.pack(d); break;
+        case ARANET_RADIATION: aranetr.pack(d); break;
+        case ARANET_RADON:     aranetrn.pack(d); break;
+        default:               common.pack(d); break;
+        }
+    }
+
+    /**
+     * @brief Restore AranetData. Fields not used by type are zero.
+     * @param [out] d Restored data
+     */
+    void unpack(AranetData& d) const {
+        d = AranetData();
+        switch (type) {
+        case ARANET4:          aranet4.unpack(d); break;
+        case ARANET2:          aranet2.unpack(d); break;
+        case ARANET_RADIATION: aranetr.unpack(d); break;
+        case ARANET_RADON:     aranetrn.unpack(d); break;
+        default:
+            d.type = (AranetType) type;
+            common.unpack(d);
+            break;
+        }
+    }
+
+    AranetData toData() const {
+        AranetData d;
+        unpack(d);
+        return d;
+    }
+
+    uint8_t  getCounter() const { return common.counter; }
+    uint8_t  size() const { return sizeOf((AranetType) type); }
+
+    /**
+     * @brief Bytes used by reading of given type, including type tag
+     */
+    static uint8_t sizeOf(AranetType type) {
+        switch (type) {
+        case ARANET4:          return 1 + sizeof(AranetReading4);
+        case ARANET2:          return 1 + sizeof(AranetReading2);
+        case ARANET_RADIATION: return 1 + sizeof(AranetReadingRadiation);
+        case ARANET_RADON:     return 1 + sizeof(AranetReadingRadon);
+        default:               return 1 + sizeof(AranetReadingCommon);
+        }
+    }
+
+    /**
+     * @brief Serialize reading, size() bytes
+     * @param [out] buf Output buffer
+     * @param [in] len Buffer size
+     * @return Bytes written, 0 if buffer is too small
+     */
+    uint8_t write(uint8_t* buf, size_t len) const {
+        uint8_t n = size();
+        if (len < n) return 0;
+        memcpy(buf, this, n);
+        return n;
+    }
+
+    /**
+     * @brief Deserialize reading stored by write()
+     * @param [in] buf Input buffer
+     * @param [in] len Bytes available
+     * @return Bytes read, 0 if buffer is too short
+     */
+    uint8_t read(const uint8_t* buf, size_t len) {
+        if (len < 1) return 0;
+        uint8_t n = sizeOf((AranetType) buf[0]);
+        if (len < n) return 0;
+        memset(this, 0, sizeof(*this));
+        memcpy(this, buf, n);
+        return n;
+    }
+};
+#pragma pack(pop)
+
+// Last N readings of one device, oldest is overwritten. R is one of typed
+// readings (AranetReading4 ...) or AranetReading for unknown type.
+template<typename R, uint16_t N>
+class AranetReadingWindow {
+public:
+    AranetReadingWindow() {
+        clear();
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    void push(const AranetData& d) {
+        items[head].pack(d);
+        head = head + 1 < N ? head + 1 : 0;
+        if (count < N) count++;
+    }
+
+    uint16_t size() const { return count; }
+    uint16_t capacity() const { return N; }
+
+    /**
+     * @brief Get reading by age
+     * @param [in] i Index, 0 is oldest, size() - 1 is latest
+     */
+    const R& at(uint16_t i) const {
+        uint16_t first = count < N ? 0 : head;
+        uint16_t slot = first + i;
+        if (slot >= N) slot -= N;
+        return items[slot];
+    }
+
+    const R& latest() const {
+        return at(count - 1);
+    }
+private:
+    R        items[N];
+    uint16_t head;
+    uint16_t count;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ *  Name:       AranetScanner.cpp
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#include "AranetScanner.h"
+
+AranetScanner* AranetScanner::instance = nullptr;
+
+AranetScanner::AranetScanner(AranetScannerCallbacks* callbacks) {
+    this->callbacks = callbacks;
+}
+
+AranetScanner::~AranetScanner() {
+    end();
+}
+
+/**
+ * @brief Start continuous passive scan. Every Aranet advertisement is decoded
+ *        and passed to callbacks as soon as it is received. Scan results are
+ *        not stored, so it can run indefinitely.
+ * @param [in] interval Scan interval in milliseconds
+ * @param [in] window Scan window in milliseconds
+ * @return true if scan was started
+ */
+bool AranetScanner::begin(uint16_t interval, uint16_t window) {
+    if (instance != nullptr && instance != this) {
+        Serial.println("ERROR: Another AranetScanner is already running.");
+        return false;
+    }
+
+    pScan = NimBLEDevice::getScan();
+    pScan->setAdvertisedDeviceCallbacks(this, true);
+    pScan->setActiveScan(false);  // all data is in advertisement, no need for scan response
+    pScan->setInterval(interval);
+    pScan->setWindow(window);
+    pScan->setDuplicateFilter(false);
+    pScan->setMaxResults(0);      // do not store results
+
+    // Scan is not running yet, table can be cleared from this task
+    if (clearDevices) {
+        devices.clear();
+        clearDevices = false;
+    }
+
+    instance = this;
+    running = true;
+
+    if (!pScan->start(0, onScanEnd, false)) {
+        Serial.println("ERROR: Failed to start scan.");
+        running = false;
+        instance = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stop scanning
+ */
+void AranetScanner::end() {
+    if (instance != this) return;
+
+    running = false;
+    if (pScan != nullptr) {
+        pScan->stop();
+        pScan->setAdvertisedDeviceCallbacks(nullptr);
+    }
+    instance = nullptr;
+}
+
+/**
+ * @brief Check if scanner is running
+ * @return true if scanning
+ */
+bool AranetScanner::isRunning() {
+    return running;
+}
+
+/**
+ * @brief Only pass advertisements with new measurement to callbacks. Devices
+ *        repeat same measurement until next one is taken, so most
+ *        advertisements are skipped without decoding. Enabled by default.
+ *        Devices with integrations disabled are not filtered.
+ * @param [in] enabled Enable change filter
+ */
+void AranetScanner::setChangeFilter(bool enabled) {
+    changeFilter = enabled;
+    // Table is used by NimBLE host task, it clears it on next advertisement
+    if (!enabled) clearDevices = true;
+}
+
+/**
+ * @brief Get number of advertisements received since begin
+ * @return advertisement count
+ */
+uint32_t AranetScanner::getAdvertisementCount() {
+    return advertisements;
+}
+
+/**
+ * @brief Get number of Aranet advertisements skipped by change filter
+ * @return advertisement count
+ */
+uint32_t AranetScanner::getUnchangedCount() {
+    return unchangedAdvertisements;
+}
+
+/**
+ * @brief Get number of Aranet advertisements passed to callbacks
+ * @return advertisement count
+ */
+uint32_t AranetScanner::getAranetCount() {
+    return aranetAdvertisements;
+}
+
+/**
+ * @brief NimBLE advertisement callback. Non-Aranet devices are rejected by
+ *        manufacturer id and repeated measurements by counter, both before
+ *        anything is decoded.
+ * @param [in] adv Advertised bluetooth device
+ */
+void AranetScanner::onResult(NimBLEAdvertisedDevice* adv) {
+    advertisements++;
+
+    if (clearDevices) {
+        devices.clear();
+        clearDevices = false;
+    }
+
+    uint8_t mlen = 0;
+    const uint8_t* mdata = AranetManufacturerData::findManufacturerData(adv->getPayload(), adv->getPayloadLength(), &mlen);
+    if (mdata == nullptr) return;
+
+    NimBLEAddress address = adv->getAddress();
+    const uint8_t* addr = address.getNative();
+    uint8_t counter;
+    bool counted = changeFilter && AranetManufacturerData::peekCounter(mdata, mlen, &counter);
+
+    if (counted) {
+        AranetDeviceEntry* e = devices.find(addr);
+        if (e != nullptr && e->reading.getCounter() == counter) {
+            e->seen = millis();
+            unchangedAdvertisements++;
+            return;
+        }
+    }
+
+    AranetManufacturerData mfdata;
+    if (!mfdata.fromManufacturerData(mdata, mlen)) return;
+    if (counted) devices.update(addr, mfdata.data);
+
+    aranetAdvertisements++;
+    if (callbacks != nullptr) callbacks->onAranetData(adv, &mfdata);
+}
+
+/**
+ * @brief Scan complete callback. Scan is started without duration, so this
+ *        only happens when it was interrupted. Restart if still running.
+ */
+void AranetScanner::onScanEnd(NimBLEScanResults results) {
+    AranetScanner* scanner = instance;
+    if (scanner == nullptr || !scanner->running) return;
+
+    scanner->pScan->start(0, onScanEnd, false);
+}
@@ -0,0 +1,64 @@
+/*
+ *  Name:       AranetScanner.h
+ *  Created:    2026-10-16
+ *  Author:     Anrijs Jargans <anrijs@anrijs.lv>
+ *  Url:        https://github.com/Anrijs/Aranet4-ESP32
+ */
+
+#ifndef __ARANET_SCANNER_H
+#define __ARANET_SCANNER_H
+
+#include "Aranet4.h"
+#include "AranetDeviceTable.h"
+
+// Devices tracked by change filter, least recently seen is dropped when full
+#ifndef ARANET_SCANNER_MAX_DEVICES
+#define ARANET_SCANNER_MAX_DEVICES 32
+#endif
+
+class AranetScannerCallbacks {
+public:
+    virtual ~AranetScannerCallbacks() {};
+
+    /**
+     * Called for every advertisement from Aranet device, or only when device
+     * reports new measurement if change filter is enabled. Runs in NimBLE host
+     * task context, keep it short and do not connect from here.
+     * adv and mfdata are only valid during the call.
+     */
+    virtual void onAranetData(NimBLEAdvertisedDevice* adv, AranetManufacturerData* mfdata) = 0;
+};
+
+class AranetScanner : public NimBLEAdvertisedDeviceCallbacks {
+public:
+    AranetScanner(AranetScannerCallbacks* callbacks);
+    ~AranetScanner();
+
+    bool begin(uint16_t interval = 100, uint16_t window = 100);
+    void end();
+    bool isRunning();
+    void setChangeFilter(bool enabled);
+
+    uint32_t getAdvertisementCount();
+    uint32_t getAranetCount();
+    uint32_t getUnchangedCount();
+
+    void onResult(NimBLEAdvertisedDevice* adv);
+private:
+    AranetScannerCallbacks* callbacks;
+    NimBLEScan* pScan = nullptr;
+    volatile bool running = false;
+    volatile bool changeFilter = true;
+    volatile bool clearDevices = false;  // table is cleared by host task, in onResult()
+    AranetDeviceTable<ARANET_SCANNER_MAX_DEVICES> devices;
+
+    volatile uint32_t advertisements = 0;
+    volatile uint32_t aranetAdvertisements = 0;
+    volatile uint32_t unchangedAdvertisements = 0;
+
+    // NimBLE scan complete callback has no context, scan is singleton anyway
+    static AranetScanner* instance;
+    static void onScanEnd(NimBLEScanResults results);
+};
+
+#endif